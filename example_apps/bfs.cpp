@@ -0,0 +1,268 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Direction-optimizing breadth-first search (Beamer et al.). Each iteration
+ * expands one BFS level, either
+ *  - top-down: the frontier vertices are scheduled and visit their
+ *    out-edges (the sliding shard view), claiming unvisited targets, or
+ *  - bottom-up: the unvisited vertices are scheduled and probe their
+ *    in-edges (the memory shard view) for a parent in the frontier,
+ *    stopping at the first one found.
+ * Top-down switches to bottom-up when the out-edges of the frontier exceed
+ * 1/alpha of the in-edges of the unvisited vertices, and back when the
+ * frontier shrinks below 1/beta of the vertices.
+ *
+ * Several sources (option "sources", comma separated) give a multi-source
+ * BFS: each vertex gets the level and parent from the nearest source.
+ * Levels and parents are written to the file given with option "output".
+ */
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "graphchi_basic_includes.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef vid_t VertexDataType;
+typedef bool EdgeDataType;  // not relevant
+
+const vid_t NO_PARENT = 0xffffffffu;
+const int UNVISITED = -1;
+
+enum bfs_direction { TOP_DOWN, BOTTOM_UP };
+
+struct BFSProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    std::vector<vid_t> sources;
+    double alpha, beta;
+
+    std::vector<int> level;
+    std::vector<vid_t> parent;
+    std::vector<char> frontier;      // Vertices of the current level
+    std::vector<char> next_frontier;
+    std::vector<int> outdeg, indeg;
+
+    int curlevel;
+    bfs_direction direction;
+    size_t nvisited;
+    std::vector<size_t> levelsizes;
+    std::vector<bfs_direction> directions;
+
+    BFSProgram(std::vector<vid_t> sources, double alpha, double beta) :
+        sources(sources), alpha(alpha), beta(beta), curlevel(0), direction(TOP_DOWN), nvisited(0) {}
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        if (gcontext.iteration == 0) {
+            outdeg[v] = vertex.num_outedges();
+            indeg[v] = vertex.num_inedges();
+        }
+
+        if (direction == TOP_DOWN) {
+            if (!frontier[v]) return;
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                vid_t dst = vertex.outedge(i)->vertex_id();
+                if (parent[dst] == NO_PARENT && __sync_bool_compare_and_swap(&parent[dst], NO_PARENT, v)) {
+                    level[dst] = curlevel + 1;
+                    next_frontier[dst] = 1;
+                }
+            }
+        } else {
+            if (parent[v] != NO_PARENT) return;
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                vid_t src = vertex.inedge(i)->vertex_id();
+                if (frontier[src]) {
+                    parent[v] = src;
+                    level[v] = curlevel + 1;
+                    next_frontier[v] = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * Called before an iteration starts. Chooses the direction for
+     * the level and schedules the vertices accordingly.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        size_t n = gcontext.nvertices;
+        if (iteration == 0) {
+            level.assign(n, UNVISITED);
+            parent.assign(n, NO_PARENT);
+            frontier.assign(n, 0);
+            next_frontier.assign(n, 0);
+            outdeg.assign(n, 0);
+            indeg.assign(n, 0);
+            for(size_t k=0; k < sources.size(); k++) {
+                if (sources[k] >= n) {
+                    logstream(LOG_FATAL) << "Source " << sources[k] << " out of range, graph has " << n << " vertices." << std::endl;
+                }
+                level[sources[k]] = 0;
+                parent[sources[k]] = sources[k];
+                frontier[sources[k]] = 1;
+            }
+            curlevel = 0;
+            direction = TOP_DOWN;  // All vertices are run on the first iteration anyway
+            nvisited = 0;
+            for(size_t v=0; v < n; v++) nvisited += frontier[v];
+            levelsizes.push_back(nvisited);
+        } else {
+            frontier.swap(next_frontier);
+            std::fill(next_frontier.begin(), next_frontier.end(), (char)0);
+            curlevel++;
+
+            size_t nf = 0, mf = 0, mu = 0;
+            for(size_t v=0; v < n; v++) {
+                if (frontier[v]) {
+                    nf++;
+                    mf += outdeg[v];
+                } else if (parent[v] == NO_PARENT) {
+                    mu += indeg[v];
+                }
+            }
+            if (nf == 0) return;  // No tasks, engine will stop
+            nvisited += nf;
+            levelsizes.push_back(nf);
+
+            if (direction == TOP_DOWN && mf > mu / alpha) {
+                direction = BOTTOM_UP;
+            } else if (direction == BOTTOM_UP && nf < n / beta && nf < levelsizes[levelsizes.size() - 2]) {
+                direction = TOP_DOWN;
+            }
+
+            for(size_t v=0; v < n; v++) {
+                if (direction == TOP_DOWN ? frontier[v] : parent[v] == NO_PARENT) {
+                    gcontext.scheduler->add_task((vid_t) v);
+                }
+            }
+        }
+        directions.push_back(direction);
+        logstream(LOG_INFO) << "Level " << curlevel << ": frontier " << levelsizes.back()
+                            << (direction == TOP_DOWN ? ", top-down" : ", bottom-up") << std::endl;
+    }
+
+    void write_output(std::string outfile) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        for(size_t v=0; v < level.size(); v++) {
+            if (level[v] != UNVISITED) fprintf(f, "%u %d %u\n", (unsigned) v, level[v], parent[v]);
+        }
+        fclose(f);
+    }
+
+    void report() {
+        for(size_t l=0; l < levelsizes.size(); l++) {
+            std::cout << "Level " << l << ": " << levelsizes[l] << " vertices ("
+                      << (directions[l] == TOP_DOWN ? "top-down" : "bottom-up") << ")" << std::endl;
+        }
+        std::cout << "Reached " << nvisited << " of " << level.size() << " vertices, depth "
+                  << (levelsizes.size() - 1) << std::endl;
+    }
+
+    /**
+     * Called after an iteration has finished.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+};
+
+static std::vector<vid_t> parse_sources(std::string s) {
+    std::vector<vid_t> sources;
+    std::stringstream ss(s);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        if (tok.size() > 0) sources.push_back((vid_t) atol(tok.c_str()));
+    }
+    return sources;
+}
+
+int main(int argc, const char **argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("bfs");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    std::vector<vid_t> sources = parse_sources(get_option_string("sources", "0"));
+    double alpha = get_option_float("alpha", 14.0f);   // Top-down -> bottom-up threshold
+    double beta = get_option_float("beta", 24.0f);     // Bottom-up -> top-down threshold
+    std::string outfile = get_option_string("output", "");
+
+    if (sources.empty()) {
+        logstream(LOG_FATAL) << "Need at least one source." << std::endl;
+        return 1;
+    }
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
+    /* Run */
+    BFSProgram program(sources, alpha, beta);
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    engine.set_disable_vertexdata_storage();
+    /* Top-down claims targets with compare-and-swap; bottom-up writes only its own vertex */
+    engine.set_enable_deterministic_parallelism(false);
+    engine.run(program, get_option_int("niters", 100000));
+
+    program.report();
+    if (outfile.size() > 0) program.write_output(outfile);
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
@@ -23,120 +23,185 @@
  *
  * @section DESCRIPTION
  *
- * Template for GraphChi applications. To create a new application, duplicate
- * this template.
+ * Speculative parallel greedy graph coloring (Gebremedhin & Manne). All
+ * scheduled vertices of an interval are colored in parallel, each with the
+ * smallest color not used by its neighbors (edge directions are ignored),
+ * without deterministic serialization. Two neighbors colored at the same
+ * time may pick the same color; every vertex that took a color reschedules
+ * itself, and on the next pass it keeps its color unless a neighbor with a
+ * smaller id has the same one, in which case it picks a new color. Only
+ * conflicting vertices are recolored, and the run stops when a pass has no
+ * conflicts.
+ *
+ * Colors are kept in memory and written as vertex values; option "output"
+ * writes "vertex color" lines.
  */
 
 #include <string>
-#include <climits>
+#include <vector>
+#include <omp.h>
+
 #include "graphchi_basic_includes.hpp"
+#include "util/dense_bitset.hpp"
 
 using namespace graphchi;
 
-const unsigned INF = UINT32_MAX;
-int         iterationcount = 0;
-bool        scheduler = false;
+const vid_t UNCOLORED = 0xffffffffu;
 
 /**
  * Type definitions. Remember to create suitable graph shards using the
  * Sharder-program.
  */
-typedef uint VertexDataType;
-typedef uint EdgeDataType;
+typedef vid_t VertexDataType;
+typedef bool EdgeDataType;  // not relevant
+
+struct ColoringProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    std::vector<vid_t> color;
+    std::vector<dense_bitset *> forbidden;   // Per-thread forbidden colors
+    size_t nconflicts;
+    std::vector<size_t> conflicts;           // Per pass
+
+    ColoringProgram() : nconflicts(0) {}
+
+    ~ColoringProgram() {
+        for(size_t i=0; i < forbidden.size(); i++) delete forbidden[i];
+    }
 
-/**
- * Scoloring
- */
-struct ColoringProgram : public GraphChiProgram<VertexDataType, EdgeDataType>
-{
-    bool converged;
     /**
-     *  Vertex update function.
+     * Smallest color not used by the neighbors. Only colors up to the
+     * degree can be forbidden, so the bitset needs degree + 1 bits.
      */
-    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext)
-    {
-
-        if (gcontext.iteration == 0)
-        {
-            /* On first iteration, initialize vertex (and its edges). This is usually required, because
-               on each run, GraphChi will modify the data files. To start from scratch, it is easiest
-               do initialize the program in code. Alternatively, you can keep a copy of initial data files. */
-            vertex.set_data(0);
-            if (scheduler)  gcontext.scheduler->add_task(vertex.id());
+    vid_t first_fit(graphchi_vertex<VertexDataType, EdgeDataType> &vertex) {
+        dense_bitset &f = *forbidden[omp_get_thread_num() % forbidden.size()];
+        vid_t maxcolor = (vid_t) vertex.num_edges();
+        if (f.size() < (size_t) maxcolor + 1) {
+            f.resize(2 * ((size_t) maxcolor + 1));
+            f.clear();
+        }
+        for(int i=0; i < vertex.num_edges(); i++) {
+            vid_t c = color[vertex.edge(i)->vertex_id()];
+            if (c <= maxcolor) f.set_bit(c);
         }
-        else
-        {
-            /* Do computation */
-            /* Loop over out-edges (example) */
-            vid_t curlabel = vertex.get_data();
-            for (int i = 0; i < vertex.num_outedges(); i++)
-            {
-                if(vertex.edge(i)->vertexid < vertex.id()) continue;
-                vid_t nblabel = vertex.edge(i)->get_data();
-                if(nblabel == curlabel) 
-                {
-                    vertex.set_data(curlabel + 1);
-                    if (scheduler) gcontext.scheduler->add_task(vertex.edge(i)->vertex_id(), true);
-                    converged = false;
-                }
+        vid_t c = 0;
+        while (f.get(c)) c++;
+        f.clear_bits(0, maxcolor);
+        return c;
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        if (gcontext.iteration > 0) {
+            /* Check the color taken on the previous pass */
+            vid_t c = color[v];
+            bool conflict = false;
+            for(int i=0; i < vertex.num_edges() && !conflict; i++) {
+                vid_t nb = vertex.edge(i)->vertex_id();
+                conflict = (nb < v && color[nb] == c);
             }
+            if (!conflict) return;
+            __sync_add_and_fetch(&nconflicts, 1);
         }
+        color[v] = first_fit(vertex);
+        vertex.set_data(color[v]);
+        gcontext.scheduler->add_task(v);
     }
 
     /**
      * Called before an iteration starts.
      */
-    void before_iteration(int iteration, graphchi_context &gcontext)
-    {
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            color.assign(gcontext.nvertices, UNCOLORED);
+            for(size_t i=0; i < forbidden.size(); i++) delete forbidden[i];
+            forbidden.clear();
+            for(int i=0; i < std::max(gcontext.execthreads, omp_get_max_threads()); i++) {
+                forbidden.push_back(new dense_bitset(64));
+            }
+        }
+        nconflicts = 0;
     }
 
     /**
      * Called after an iteration has finished.
      */
-    void after_iteration(int iteration, graphchi_context &gcontext)
-    {
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration > 0) {
+            conflicts.push_back(nconflicts);
+            logstream(LOG_INFO) << "Pass " << iteration << ": " << nconflicts << " conflicts" << std::endl;
+        }
     }
 
     /**
      * Called before an execution interval is started.
      */
-    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext)
-    {
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
     }
 
     /**
      * Called after an execution interval has finished.
      */
-    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext)
-    {
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    vid_t num_colors() {
+        vid_t maxc = 0;
+        for(size_t v=0; v < color.size(); v++) {
+            if (color[v] != UNCOLORED) maxc = std::max(maxc, color[v] + 1);
+        }
+        return maxc;
+    }
+
+    void write_output(std::string outfile) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        for(size_t v=0; v < color.size(); v++) {
+            fprintf(f, "%u %u\n", (unsigned) v, color[v]);
+        }
+        fclose(f);
     }
 };
 
-int main(int argc, const char **argv)
-{
+int main(int argc, const char **argv) {
     /* GraphChi initialization will read the command line
        arguments and the configuration file. */
     graphchi_init(argc, argv);
-    printf("INF number: %llu size: %d", INF, sizeof(INF));
+
     /* Metrics object for keeping track of performance counters
        and other information. Currently required. */
     metrics m("coloring");
-    global_logger().set_log_level(LOG_DEBUG);
 
     /* Basic arguments for application */
     std::string filename = get_option_string("file"); // Base filename
-    int niters = get_option_int("niters", 20);         // Number of iterations
-    bool scheduler = get_option_int("scheduler", 0);  // Whether to use selective scheduling
+    int niters = get_option_int("niters", 1000);      // Upper bound for the number of passes
+    std::string outfile = get_option_string("output", "");
 
     /* Detect the number of shards or preprocess an input to create them */
-    int nshards = convert_if_notexists<EdgeDataType>(filename,
-                                                     get_option_string("nshards", "auto"));
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
 
     /* Run */
     ColoringProgram program;
-    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Conflicts are resolved on the next pass instead of serializing neighbors */
+    engine.set_enable_deterministic_parallelism(false);
     engine.run(program, niters);
 
+    std::cout << "Colors: " << program.num_colors() << ", passes: " << (program.conflicts.size() + 1);
+    size_t total = 0;
+    for(size_t i=0; i < program.conflicts.size(); i++) total += program.conflicts[i];
+    std::cout << ", conflicts: " << total << std::endl;
+    if (outfile.size() > 0) program.write_output(outfile);
+
     /* Report execution metrics */
     metrics_report(m);
     return 0;
@@ -31,24 +31,30 @@
  * @section REMARKS
  *
  * The algorithm is very similar to the connected components algorithm, but instead
- * of vertex choosing the minimum label of its neighbor, it chooses the most frequent one.
+ * of vertex choosing the minimum label of its neighbor, it chooses the most frequent one
+ * (ties go to the larger label).
  *
- * However, because the operation (most frequent label) is not commutative,
- * we need to store both vertices labels in an edge. See comment below, above the
- * struct "bidirectional_label".
+ * Because the operation (most frequent label) is not commutative, neighbors
+ * must not overwrite each other's values. The labels are therefore kept in an
+ * in-memory array (4 bytes per vertex) instead of on the edges, and the graph
+ * is processed as pure adjacency. The final labels are also written as vertex
+ * values for the label analysis. Neighbor labels are counted with a
+ * per-thread label_counter (sort for small degrees, hashing for large ones).
  *
  * Note, that this algorithm is not very sophisticated and is prone to local minimas.
- * If you want to use this seriously, try with different initial labeling. 
- * Also, a more sophisticated algorithm called LPAm should be doable on GraphChi.
+ * If you want to use this seriously, try with different initial labeling,
+ * or see the Louvain method in louvain.cpp.
  *
  * @author Aapo Kyrola
  */
 
 #include <cmath>
-#include <map>
 #include <string>
+#include <vector>
+#include <omp.h>
 
 #include "graphchi_basic_includes.hpp"
+#include "util/label_counter.hpp"
 #include "util/labelanalysis.hpp"
 
 using namespace graphchi;
@@ -56,41 +62,8 @@ using namespace graphchi;
 #define GRAPHCHI_DISABLE_COMPRESSION
 
 
-/**
- * Unlike in connected components, we need
- * to ensure that neighbors do not overwrite each
- * others values. This is achieved by keeping two values
- * in an edge. In this struct, smaller_one is the id of the
- * vertex that has smaller id, and larger_one the others.
- * This complexity is due to us ignoring the direction of an edge.
- */
-struct bidirectional_label {
-    vid_t smaller_one;
-    vid_t larger_one;
-};
-
-vid_t & neighbor_label(bidirectional_label & bidir, vid_t myid, vid_t nbid) {
-    if (myid < nbid) {
-        return bidir.larger_one;
-    } else {
-        return bidir.smaller_one;
-    }
-}
-
-vid_t & my_label(bidirectional_label & bidir, vid_t myid, vid_t nbid) {
-    if (myid < nbid) {
-        return bidir.smaller_one;
-    } else {
-        return bidir.larger_one;
-    }
-}
-
- 
 typedef vid_t VertexDataType;       // vid_t is the vertex id type
-typedef bidirectional_label EdgeDataType;  // Note, 8-byte edge data
-
-void parse(bidirectional_label &x, const char * s) { } // Do nothing
-
+typedef bool EdgeDataType;          // Not used: labels are kept in memory
 
 
 /**
@@ -99,103 +72,86 @@ void parse(bidirectional_label &x, const char * s) { } // Do nothing
  */
 struct CommunityDetectionProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
+    std::vector<vid_t> labels;
+    std::vector<label_counter<int> *> counters;   // Per thread
+    size_t nchanged;
+    
+    CommunityDetectionProgram() : nchanged(0) {}
+    
+    ~CommunityDetectionProgram() {
+        for(size_t i=0; i < counters.size(); i++) delete counters[i];
+    }
+    
     /**
      *  Vertex update function.
      */
     void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
         /* This program requires selective scheduling. */
         assert(gcontext.scheduler != NULL);
-        vid_t newlabel;
         if (gcontext.iteration == 0) {
-            /* On first iteration, choose label vertex id */
-            vid_t firstlabel = vertex.id();
-            vertex.set_data(firstlabel);
-            
-            newlabel = firstlabel;
-            
-            /* Scheduler myself for next iteration */
-            gcontext.scheduler->add_task(vertex.id());
-            
-        } else {
-            if (vertex.num_edges() == 0) return; // trivial
-            
-            /* The basic idea is to find the label that is most popular among
-               this vertex's neighbors. This label will be chosen as the new label
-               of this vertex. */
-            // This part could be optimized: STL map is quite slow.
-            std::map<vid_t, int> counts;
-            int maxcount=0;
-            vid_t maxlabel=0;
-            /* Iterate over all the edges */
-            for(int i=0; i < vertex.num_edges(); i++) {
-                /* Extract neighbor's current label. The edge contains the labels of
-                   both vertices it connects, so we need to use the right one. 
-                   (See comment for bidirectional_label above) */
-                bidirectional_label edgelabel = vertex.edge(i)->get_data();
-                vid_t nblabel = neighbor_label(edgelabel, vertex.id(), vertex.edge(i)->vertex_id());
-                
-                /* Check if this label (nblabel) has been encountered before ... */
-                std::map<vid_t, int>::iterator existing = counts.find(nblabel);
-                int newcount = 0;
-                if(existing == counts.end()) {
-                    /* ... if not, we add this label with count of one to the map */
-                    counts.insert(std::pair<vid_t,int>(nblabel, 1));
-                    newcount = 1;
-                } else {
-                    /* ... if yes, we increment the counter for this label by 1 */
-                    existing->second++;
-                    newcount = existing->second;
-                }
-                
-                /* Finally, we keep track of the most frequent label */
-                if (newcount > maxcount || (maxcount == newcount && nblabel > maxlabel)) {
-                    maxlabel = nblabel;
-                    maxcount = newcount;
-                }
-            }
-            newlabel = maxlabel;
+            /* Initial label is the vertex id (the in-memory labels were
+               initialized before the iteration, so propagation starts right away) */
+            vertex.set_data(vertex.id());
+        }
+        if (vertex.num_edges() == 0) return; // trivial
+        
+        /* The basic idea is to find the label that is most popular among
+           this vertex's neighbors. This label will be chosen as the new label
+           of this vertex. */
+        label_counter<int> &counter = *counters[omp_get_thread_num()];
+        counter.reset(vertex.num_edges());
+        for(int i=0; i < vertex.num_edges(); i++) {
+            counter.add(labels[vertex.edge(i)->vertex_id()], 1);
         }
-        /**
-         * Write my label to my neighbors.
-         */
-        if (newlabel != vertex.get_data() || gcontext.iteration == 0) {
+        vid_t newlabel = labels[vertex.id()];
+        int maxcount = 0;
+        if (!counter.most_frequent(newlabel, maxcount)) return;
+        
+        /* On change, the neighbors need to reconsider their labels. */
+        if (newlabel != labels[vertex.id()]) {
+            labels[vertex.id()] = newlabel;
             vertex.set_data(newlabel);
+            __sync_add_and_fetch(&nchanged, 1);
             for(int i=0; i<vertex.num_edges(); i++) {
-                bidirectional_label labels_on_edge = vertex.edge(i)->get_data();
-                my_label(labels_on_edge, vertex.id(), vertex.edge(i)->vertex_id()) = newlabel;
-                vertex.edge(i)->set_data(labels_on_edge);
-                
-                // On first iteration, everyone schedules themselves.
-                if (gcontext.iteration > 0)
-                    gcontext.scheduler->add_task(vertex.edge(i)->vertex_id());                
+                gcontext.scheduler->add_task(vertex.edge(i)->vertex_id());
             }
         }
-        
     }
     
     
     /**
      * Called before an iteration starts.
      */
-    void before_iteration(int iteration, graphchi_context &info) {
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            labels.resize(gcontext.nvertices);
+            for(vid_t v=0; v < gcontext.nvertices; v++) labels[v] = v;
+            for(size_t i=0; i < counters.size(); i++) delete counters[i];
+            counters.clear();
+            for(int i=0; i < std::max(gcontext.execthreads, omp_get_max_threads()); i++) {
+                counters.push_back(new label_counter<int>());
+            }
+        }
+        nchanged = 0;
     }
     
     /**
      * Called after an iteration has finished.
      */
-    void after_iteration(int iteration, graphchi_context &ginfo) {
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        logstream(LOG_INFO) << "Iteration " << iteration << ": " << nchanged << " labels changed" << std::endl;
     }
     
     /**
      * Called before an execution interval is started.
      */
-    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {        
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {        
     }
     
     /**
      * Called after an execution interval has finished.
      */
-    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {        
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {        
     }
     
 };
@@ -215,12 +171,18 @@ int main(int argc, const char ** argv) {
     bool scheduler       = true;    // Always run with scheduler
         
     /* Process input file - if not already preprocessed */
-    int nshards             = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+    int nshards             = convert_if_notexists_novalues<EdgeDataType>(filename, get_option_string("nshards", "auto"));
 
     if (get_option_int("onlyresult", 0) == 0) {
         /* Run */
         CommunityDetectionProgram program;
         graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m); 
+        engine.set_only_adjacency(true);
+        engine.set_modifies_inedges(false);
+        engine.set_modifies_outedges(false);
+        /* Labels are read from the in-memory array, so neighbors do not need
+           to be serialized */
+        engine.set_enable_deterministic_parallelism(false);
         engine.run(program, niters);
     }
     
@@ -235,4 +197,3 @@ int main(int argc, const char ** argv) {
     metrics_report(m);
     return 0;
 }
-
@@ -0,0 +1,241 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Approximate neighborhood function with HyperLogLog counters (HyperANF,
+ * Boldi, Rosa & Vigna). After t iterations the counter of vertex v
+ * estimates the number of vertices that reach v in at most t steps: it is
+ * the register-wise maximum of its own counter and the counters of its
+ * in-neighbors after t - 1 iterations. The sum of the estimates is the
+ * neighborhood function N(t), the number of pairs within distance t.
+ *
+ * Counters of 2^log2m byte registers (option "log2m", default 6) are kept in
+ * two arrays, the previous and the next iteration, memory mapped from files
+ * next to the graph if they do not fit in half of the memory budget (see
+ * api/pull_spmv.hpp). A vertex runs only if one of its in-neighbors changed
+ * in the previous iteration, and the run stops when no counter changes. The
+ * vertex value is the estimated size of the ball around the vertex.
+ *
+ * Reports N(t) for each distance t (also to the file given with option
+ * "output", as "t N(t)" lines), the average distance and the effective
+ * diameter (interpolated distance within which "quantile", by default 90%,
+ * of the reachable pairs are).
+ */
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <omp.h>
+
+#include "graphchi_basic_includes.hpp"
+#include "api/pull_spmv.hpp"
+#include "util/dense_bitset.hpp"
+#include "util/hyperloglog.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef float VertexDataType;   // Estimated ball size
+typedef bool EdgeDataType;      // not relevant
+
+struct HyperANFProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    int m;                      // Registers per counter
+    int log2m;
+    uint64_t seed;
+    uint8_t * cur;              // Counters after the previous iteration
+    uint8_t * next;             // Counters of this iteration (equal to cur for unchanged vertices)
+    dense_bitset changed;
+    std::vector<double> partial;        // Per execution thread, change of the sum of estimates
+    std::vector<double> nf;             // Neighborhood function N(t)
+
+    HyperANFProgram(int log2m, uint64_t seed, uint8_t * cur, uint8_t * next) :
+        m(1 << log2m), log2m(log2m), seed(seed), cur(cur), next(next) {
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        double before;
+        uint8_t * counter;
+        if (gcontext.iteration == 0) {
+            before = 0.0;
+            counter = cur + (size_t)v * m;
+            hll_add(counter, log2m, v, seed);
+        } else {
+            before = vertex.get_data();
+            counter = next + (size_t)v * m;
+            bool grew = false;
+            for(int i=0; i < vertex.num_inedges(); i++) {
+                grew |= hll_union(counter, cur + (size_t)vertex.inedge(i)->vertex_id() * m, m);
+            }
+            if (!grew) return;
+            changed.set_bit(v);
+        }
+        float est = (float) hll_estimate(counter, m);
+        vertex.set_data(est);
+        partial[omp_get_thread_num() * 8] += est - before;
+
+        /* Out-neighbors union this counter on the next iteration */
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            gcontext.scheduler->add_task(vertex.outedge(i)->vertex_id());
+        }
+    }
+
+    /**
+     * Called before an iteration starts.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            changed.resize(gcontext.nvertices);
+            nf.clear();
+        }
+        changed.clear();
+        partial.assign(gcontext.execthreads * 8, 0.0);  // Padded to separate cache lines
+    }
+
+    /**
+     * Called after an iteration has finished. Copies the changed counters
+     * so that both arrays agree again.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        size_t n = gcontext.nvertices;
+        if (iteration == 0) {
+            memcpy(next, cur, n * m);
+        } else {
+            size_t nchanged = 0;
+            for(size_t v=0; v < n; v++) {
+                if (changed.get((uint32_t) v)) {
+                    memcpy(cur + v * m, next + v * m, m);
+                    nchanged++;
+                }
+            }
+            logstream(LOG_INFO) << "Iteration " << iteration << ": " << nchanged << " counters changed" << std::endl;
+        }
+        double delta = 0;
+        for(size_t i=0; i < partial.size(); i++) delta += partial[i];
+        nf.push_back((nf.empty() ? 0.0 : nf.back()) + delta);
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+};
+
+/**
+ * Interpolated distance d such that N(d) = quantile * N(last).
+ */
+static double effective_diameter(const std::vector<double> &nf, double quantile) {
+    double target = quantile * nf.back();
+    for(size_t t=0; t < nf.size(); t++) {
+        if (nf[t] >= target) {
+            if (t == 0) return 0.0;
+            return (t - 1) + (target - nf[t - 1]) / (nf[t] - nf[t - 1]);
+        }
+    }
+    return (double) (nf.size() - 1);
+}
+
+int main(int argc, const char **argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("hyperanf");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    int log2m = get_option_int("log2m", 6);
+    uint64_t seed = (uint64_t) get_option_int("seed", 1);
+    double quantile = get_option_float("quantile", 0.9f);
+    std::string outfile = get_option_string("output", "");
+
+    if (log2m < 4 || log2m > 16) {
+        logstream(LOG_FATAL) << "Option log2m must be between 4 and 16." << std::endl;
+        return 1;
+    }
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Updates read only the previous counters and write their own */
+    engine.set_enable_deterministic_parallelism(false);
+
+    size_t n = engine.num_vertices();
+    size_t bytes = 2 * n * ((size_t)1 << log2m);
+    bool use_mmap = bytes > (size_t) engine.get_membudget_mb() * 1024L * 1024L / 2;
+    if (use_mmap) {
+        logstream(LOG_INFO) << "Memory mapping the counter arrays (" << (bytes / 1024 / 1024) << " MB)." << std::endl;
+    }
+    spmv_array<uint8_t> a, b;
+    uint8_t * cur = a.allocate(n << log2m, use_mmap ? filename + ".hll.0" : "");
+    uint8_t * next = b.allocate(n << log2m, use_mmap ? filename + ".hll.1" : "");
+
+    /* Run */
+    HyperANFProgram program(log2m, seed, cur, next);
+    engine.run(program, get_option_int("niters", 100000));
+
+    /* The last iteration changed no counter */
+    std::vector<double> &nf = program.nf;
+    while (nf.size() > 1 && nf[nf.size() - 1] == nf[nf.size() - 2]) nf.pop_back();
+
+    FILE * f = NULL;
+    if (outfile.size() > 0) {
+        f = fopen(outfile.c_str(), "w");
+        if (f == NULL) logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+    }
+    double avgdist = 0;
+    for(size_t t=0; t < nf.size(); t++) {
+        std::cout << "N(" << t << ") = " << nf[t] << std::endl;
+        if (f != NULL) fprintf(f, "%u %.8g\n", (unsigned) t, nf[t]);
+        if (t > 0) avgdist += t * (nf[t] - nf[t - 1]);
+    }
+    if (f != NULL) fclose(f);
+    if (nf.size() > 1 && nf.back() > nf[0]) avgdist /= (nf.back() - nf[0]);
+    std::cout << "Average distance: " << avgdist << ", effective diameter (" << quantile << "): "
+              << effective_diameter(nf, quantile) << std::endl;
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
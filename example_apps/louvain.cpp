@@ -0,0 +1,416 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Louvain community detection (Blondel et al. 2008): modularity is optimized
+ * by moving single vertices to the neighboring community with the largest
+ * modularity gain, and when the moves have converged, each community is
+ * contracted into one vertex and the procedure is repeated on the smaller
+ * graph. Edge directions are ignored.
+ *
+ * The community of each vertex, the community totals and the weighted degrees
+ * are kept in memory; the edges stay in the shards. Moves are speculative
+ * (like in label propagation): vertices of an interval are processed in
+ * parallel, and the neighbors of a vertex that moved are rescheduled. To
+ * avoid two singleton vertices swapping their communities, a singleton can
+ * join another singleton only if its id is smaller. A level ends when a pass
+ * moves fewer than tolerance * n vertices.
+ *
+ * The contracted graph of each level is written as shards (with name
+ * file_louvain<level>) by the contraction pass, which also sums the parallel
+ * edges of each vertex. Edges inside a community become a self-weight of
+ * the new vertex, which is kept in memory because shards do not store
+ * self-edges. Level graphs are deleted after the next level has been built.
+ *
+ * Options: "weighted" (1 to read edge weights, otherwise every edge has weight 1),
+ * "maxlevels", "niters" (max passes per level), "tolerance" and "output"
+ * (writes "vertex community" lines for the original vertices).
+ */
+
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <omp.h>
+
+#include "graphchi_basic_includes.hpp"
+#include "util/atomic.hpp"
+#include "util/label_counter.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef vid_t VertexDataType;   // Not stored
+typedef float EdgeDataType;     // Edge weight
+
+enum LouvainPhase { DEGREES = 0, MOVE = 1, CONTRACT = 2 };
+
+struct LouvainProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    LouvainPhase phase;
+    bool weighted;              // Whether edge values are used (always on contracted levels)
+    double tolerance;
+    double m2;                  // Twice the total edge weight
+
+    /* Current level */
+    vid_t n;
+    std::vector<vid_t> comm;
+    std::vector<double> k;          // Weighted degree, including selfweight
+    std::vector<double> selfweight; // Twice the weight inside the vertex
+    std::vector<double> tot;        // Sum of k of the community
+    std::vector<vid_t> size;        // Number of vertices in the community
+    size_t nmoves, level_moves;
+    int passes;
+
+    /* Contraction */
+    std::vector<vid_t> newid;
+    vid_t ncommunities;
+    std::vector<double> next_selfweight;
+    sharded_graph_output<VertexDataType, EdgeDataType> * out;
+
+    /* Community of each original vertex */
+    std::vector<vid_t> assignment;
+
+    std::vector<label_counter<double> *> counters;   // Per thread
+
+    LouvainProgram(bool weighted, double tolerance) : phase(DEGREES), weighted(weighted), tolerance(tolerance),
+        m2(0), n(0), nmoves(0), level_moves(0), passes(0), ncommunities(0), out(NULL) {
+    }
+
+    ~LouvainProgram() {
+        for(size_t i=0; i < counters.size(); i++) delete counters[i];
+    }
+
+    /**
+     * Starts from singleton communities of the original graph.
+     */
+    void init(vid_t nvertices) {
+        n = nvertices;
+        k.assign(n, 0.0);
+        selfweight.assign(n, 0.0);
+        assignment.resize(n);
+        for(vid_t v=0; v < n; v++) assignment[v] = v;
+        phase = DEGREES;
+    }
+
+    inline double weight(graphchi_edge<EdgeDataType> * e) {
+        return weighted ? (double) e->get_data() : 1.0;
+    }
+
+    inline label_counter<double> &counter() {
+        return *counters[omp_get_thread_num()];
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        switch (phase) {
+            case DEGREES: {
+                double kv = selfweight[v];
+                for(int i=0; i < vertex.num_edges(); i++) kv += weight(vertex.edge(i));
+                k[v] = kv;
+                gcontext.scheduler->add_task(v);
+                break;
+            }
+            case MOVE:
+                move(vertex, gcontext);
+                break;
+            case CONTRACT:
+                contract(vertex);
+                break;
+        }
+    }
+
+    /**
+     * Moves the vertex to the neighboring community with the largest gain
+     * k_v,c - tot_c * k_v / m2 (the gain of staying is computed without v).
+     */
+    void move(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        if (vertex.num_edges() == 0) return;
+        label_counter<double> &cnt = counter();
+        cnt.reset(vertex.num_edges());
+        for(int i=0; i < vertex.num_edges(); i++) {
+            vid_t nb = vertex.edge(i)->vertex_id();
+            if (nb != v) cnt.add(comm[nb], weight(vertex.edge(i)));
+        }
+        std::vector<label_counter<double>::entry_t> &nbcomms = cnt.result();
+
+        vid_t own = comm[v];
+        double kv = k[v];
+        double scale = kv / m2;
+        double bestgain = -(tot[own] - kv) * scale;
+        for(size_t j=0; j < nbcomms.size(); j++) {
+            if (nbcomms[j].first == own) bestgain += nbcomms[j].second;
+        }
+        vid_t best = own;
+        bool singleton = (size[own] == 1);
+        for(size_t j=0; j < nbcomms.size(); j++) {
+            vid_t c = nbcomms[j].first;
+            if (c == own) continue;
+            if (singleton && size[c] == 1 && c > own) continue;
+            double gain = nbcomms[j].second - tot[c] * scale;
+            if (gain > bestgain) {
+                bestgain = gain;
+                best = c;
+            }
+        }
+        if (best == own) return;
+
+        atomic_add(tot[own], -kv);
+        atomic_add(tot[best], kv);
+        __sync_sub_and_fetch(&size[own], 1);
+        __sync_add_and_fetch(&size[best], 1);
+        comm[v] = best;
+        __sync_add_and_fetch(&nmoves, 1);
+        for(int i=0; i < vertex.num_edges(); i++) {
+            gcontext.scheduler->add_task(vertex.edge(i)->vertex_id());
+        }
+    }
+
+    /**
+     * Writes the out-edges of the vertex to the contracted graph, summing
+     * the weights to each community. Each edge is an out-edge of exactly one
+     * vertex, so it is counted once.
+     */
+    void contract(graphchi_vertex<VertexDataType, EdgeDataType> &vertex) {
+        vid_t v = vertex.id();
+        vid_t cv = newid[comm[v]];
+        double inside = selfweight[v];
+        label_counter<double> &cnt = counter();
+        cnt.reset(vertex.num_outedges());
+        for(int i=0; i < vertex.num_outedges(); i++) {
+            vid_t cn = newid[comm[vertex.outedge(i)->vertex_id()]];
+            double w = weight(vertex.outedge(i));
+            if (cn == cv) {
+                inside += 2 * w;
+            } else {
+                cnt.add(cn, w);
+            }
+        }
+        if (inside != 0) atomic_add(next_selfweight[cv], inside);
+        std::vector<label_counter<double>::entry_t> &nbcomms = cnt.result();
+        for(size_t j=0; j < nbcomms.size(); j++) {
+            out->output_edgeval(cv, nbcomms[j].first, (EdgeDataType) nbcomms[j].second);
+        }
+    }
+
+    /**
+     * Called before an iteration starts.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            for(size_t i=0; i < counters.size(); i++) delete counters[i];
+            counters.clear();
+            for(int i=0; i < std::max(gcontext.execthreads, omp_get_max_threads()); i++) {
+                counters.push_back(new label_counter<double>());
+            }
+        }
+        if (phase == MOVE && iteration == 0) {
+            comm.resize(n);
+            size.assign(n, 1);
+            tot = k;
+            for(vid_t v=0; v < n; v++) comm[v] = v;
+            level_moves = 0;
+            passes = 0;
+        }
+        nmoves = 0;
+    }
+
+    /**
+     * Called after an iteration has finished.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        if (phase == DEGREES) {
+            m2 = 0;
+            for(vid_t v=0; v < n; v++) m2 += k[v];
+            logstream(LOG_INFO) << "Total weight: " << (m2 / 2) << std::endl;
+            phase = MOVE;
+            before_iteration(0, gcontext);
+            if (m2 == 0) gcontext.scheduler->remove_tasks(0, gcontext.nvertices - 1);
+        } else if (phase == MOVE) {
+            passes++;
+            level_moves += nmoves;
+            logstream(LOG_INFO) << "Pass " << passes << ": " << nmoves << " moves" << std::endl;
+            if ((double) nmoves < tolerance * n) {
+                /* Converged; the engine stops after an empty pass */
+                gcontext.scheduler->remove_tasks(0, gcontext.nvertices - 1);
+            }
+        }
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Numbers the non-empty communities consecutively, and prepares the
+     * contraction pass.
+     */
+    void prepare_contraction(sharded_graph_output<VertexDataType, EdgeDataType> * output) {
+        newid.assign(n, 0);
+        std::vector<char> used(n, 0);
+        for(vid_t v=0; v < n; v++) used[comm[v]] = 1;
+        ncommunities = 0;
+        for(vid_t c=0; c < n; c++) {
+            if (used[c]) newid[c] = ncommunities++;
+        }
+        next_selfweight.assign(ncommunities, 0.0);
+        out = output;
+        phase = CONTRACT;
+    }
+
+    /**
+     * Makes the communities the vertices of the next level.
+     */
+    void next_level() {
+        std::vector<double> nextk(ncommunities, 0.0);
+        for(vid_t c=0; c < n; c++) {
+            if (size[c] > 0) nextk[newid[c]] = tot[c];
+        }
+        for(size_t i=0; i < assignment.size(); i++) {
+            assignment[i] = newid[comm[assignment[i]]];
+        }
+        k.swap(nextk);
+        selfweight.swap(next_selfweight);
+        n = ncommunities;
+        out = NULL;
+        weighted = true;
+        phase = MOVE;
+    }
+
+    /**
+     * Modularity of the partition where each vertex of the current level
+     * is its own community.
+     */
+    double modularity() {
+        if (m2 == 0) return 0.0;
+        double q = 0;
+        for(vid_t v=0; v < n; v++) {
+            q += selfweight[v] / m2 - (k[v] / m2) * (k[v] / m2);
+        }
+        return q;
+    }
+
+    void write_output(std::string outfile) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        for(size_t v=0; v < assignment.size(); v++) {
+            fprintf(f, "%u %u\n", (unsigned) v, assignment[v]);
+        }
+        fclose(f);
+    }
+};
+
+int main(int argc, const char ** argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("louvain");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    int niters           = get_option_int("niters", 100);   // Max passes per level
+    int maxlevels        = get_option_int("maxlevels", 20);
+    bool weighted        = get_option_int("weighted", 0) != 0;
+    double tolerance     = get_option_float("tolerance", 0.0001f);
+    std::string outfile  = get_option_string("output", "");
+
+    /* Process input file - if not already preprocessed */
+    int nshards = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+
+    LouvainProgram program(weighted, tolerance);
+    std::string levelname = filename;
+    int level;
+    for(level=0; level < maxlevels; level++) {
+        graphchi_engine<VertexDataType, EdgeDataType> engine(levelname, nshards, true, m);
+        engine.set_disable_vertexdata_storage();
+        engine.set_modifies_inedges(false);
+        engine.set_modifies_outedges(false);
+        /* Moves are speculative, so neighbors do not need to be serialized */
+        engine.set_enable_deterministic_parallelism(false);
+        if (!program.weighted) engine.set_only_adjacency(true);
+
+        /* Local moving */
+        if (level == 0) {
+            program.init((vid_t) engine.num_vertices());
+            engine.run(program, niters + 1);  // One extra pass for the degrees
+        } else {
+            engine.run(program, niters);
+        }
+        logstream(LOG_INFO) << "Level " << level << ": " << program.level_moves << " moves in "
+            << program.passes << " passes" << std::endl;
+        if (program.level_moves == 0) {
+            if (level > 0) delete_shards<EdgeDataType>(levelname, nshards);
+            break;
+        }
+
+        /* Contraction */
+        std::stringstream ss;
+        ss << filename << "_louvain" << (level + 1);
+        std::string nextname = ss.str();
+        sharded_graph_output<VertexDataType, EdgeDataType> shardedout(nextname);
+        program.prepare_contraction(&shardedout);
+        engine.run(program, 1);
+        program.next_level();
+        std::cout << "Level " << level << ": " << program.n << " communities, modularity "
+            << program.modularity() << std::endl;
+
+        if (level > 0) delete_shards<EdgeDataType>(levelname, nshards);
+        if (shardedout.num_edges() == 0) {
+            level++;
+            break;
+        }
+        nshards = (int) shardedout.finish_sharding();
+        levelname = nextname;
+        if (level == maxlevels - 1) delete_shards<EdgeDataType>(levelname, nshards);
+    }
+
+    std::cout << "Communities: " << program.n << ", levels: " << level
+        << ", modularity: " << program.modularity() << std::endl;
+    if (outfile.size() > 0) program.write_output(outfile);
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
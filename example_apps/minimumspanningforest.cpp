@@ -27,13 +27,22 @@
  *
  * This application demonstrates how graph contraction algorithms can be implemented efficiently
  * with GraphChi.
+ *
+ * Each round contracts the graph and shards the contracted edges directly (binary) for the
+ * next round. When the contracted edges fit in "inmem_maxmem_mb" megabytes, they are
+ * read into memory in one pass and the forest is finished with a parallel in-memory
+ * Boruvka over a concurrent union-find.
  */
 
 #define GRAPHCHI_DISABLE_COMPRESSION
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 #include "graphchi_basic_includes.hpp"
+#include "util/atomic.hpp"
+#include "util/concurrent_union_find.hpp"
 
 using namespace graphchi;
 
@@ -368,6 +377,106 @@ struct ContractionStep : public GraphChiProgram<VertexDataType, EdgeDataType> {
  
 
 
+/**
+ * Edge of the contracted graph, read into memory for the final phase.
+ */
+struct msf_edge {
+    vid_t a, b;
+    int weight;
+    vid_t orig_src, orig_dst;
+    msf_edge() {}
+    msf_edge(vid_t a, vid_t b, int weight, vid_t orig_src, vid_t orig_dst) :
+        a(a), b(b), weight(weight), orig_src(orig_src), orig_dst(orig_dst) {}
+};
+
+/**
+ * Reads the edges of the contracted graph into memory (one pass over in-edges).
+ */
+struct InMemoryLoad : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    
+    std::vector<msf_edge> edges;
+    
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        if (vertex.num_inedges() == 0) return;
+        std::vector<msf_edge> local;
+        local.reserve(vertex.num_inedges());
+        for(int i=0; i < vertex.num_inedges(); i++) {
+            graphchi_edge<EdgeDataType> * e = vertex.inedge(i);
+            EdgeDataType edata = e->get_data();
+            local.push_back(msf_edge(e->vertex_id(), vertex.id(), edata.weight, edata.orig_src, edata.orig_dst));
+        }
+        lock.lock();
+        edges.insert(edges.end(), local.begin(), local.end());
+        lock.unlock();
+    }
+};
+
+/**
+ * Orders edges by weight, ties broken by position, so that the
+ * minimum edges of the components never form a cycle.
+ */
+static inline uint64_t msf_edge_key(int weight, size_t idx) {
+    return ((uint64_t) ((uint32_t) weight ^ 0x80000000u) << 32) | (uint64_t) idx;
+}
+
+/**
+ * Parallel Boruvka on the in-memory contracted graph. Each step every component picks
+ * its minimum edge (atomic_min on the edge keys), the picked edges are added to the
+ * forest and joined in the union-find, and the edges inside components are dropped.
+ */
+static void inmemory_boruvka(std::vector<msf_edge> &edges, size_t nvertices,
+                             basic_text_output<VertexDataType, EdgeDataType> &mstout) {
+    concurrent_union_find components(nvertices);
+    std::vector<uint64_t> minedge(nvertices);
+    std::vector<bool> picked;
+    const uint64_t NONE = 0xffffffffffffffffULL;
+    int step = 0;
+    
+    while (!edges.empty()) {
+        assert(edges.size() < 0xffffffffu);
+        std::fill(minedge.begin(), minedge.end(), NONE);
+#pragma omp parallel for
+        for(long i=0; i < (long) edges.size(); i++) {
+            vid_t ra = components.find(edges[i].a);
+            vid_t rb = components.find(edges[i].b);
+            if (ra == rb) continue;
+            uint64_t key = msf_edge_key(edges[i].weight, i);
+            atomic_min(minedge[ra], key);
+            atomic_min(minedge[rb], key);
+        }
+        
+        /* Both endpoints may pick the same edge */
+        picked.assign(edges.size(), false);
+        size_t npicked = 0;
+        for(size_t v=0; v < nvertices; v++) {
+            if (minedge[v] == NONE) continue;
+            size_t i = (size_t) (minedge[v] & 0xffffffffu);
+            if (picked[i]) continue;
+            picked[i] = true;
+            npicked++;
+            msf_edge &e = edges[i];
+            if (e.weight >= 0) {
+                mstout.output_edge(e.orig_src, e.orig_dst, e.weight);
+                totalMST += e.weight;
+            }
+        }
+        
+#pragma omp parallel for
+        for(long i=0; i < (long) edges.size(); i++) {
+            if (picked[i]) components.unite(edges[i].a, edges[i].b);
+        }
+        
+        /* Drop edges inside components */
+        size_t keep = 0;
+        for(size_t i=0; i < edges.size(); i++) {
+            if (components.find(edges[i].a) != components.find(edges[i].b)) edges[keep++] = edges[i];
+        }
+        edges.resize(keep);
+        logstream(LOG_INFO) << "In-memory Boruvka step " << step++ << ": " << npicked << " forest edges, "
+                            << keep << " edges left" << std::endl;
+    }
+}
+
 int main(int argc, const char ** argv) {
     /* GraphChi initialization will read the command line
      arguments and the configuration file. */
@@ -381,6 +490,8 @@ int main(int argc, const char ** argv) {
     /* Basic arguments for application */
     std::string filename = get_option_string("file");  // Base filename
     bool scheduler       = false; // Whether to use selective scheduling
+    size_t inmem_maxbytes = (size_t) (get_option_float("inmem_maxmem_mb", 512.0f) * 1024 * 1024);
+    size_t contracted_edges = 0;
     
     /* Detect the number of shards or preprocess an input to create them */
     int nshards          = get_option_int("nshards", 0);
@@ -443,8 +554,27 @@ int main(int argc, const char ** argv) {
                 break;
             }
             
+            contracted_edges = shardedout.num_edges();
             nshards = (int)shardedout.finish_sharding();
             filename = contractedname;
+        } else if (contracted_edges * sizeof(msf_edge) <= inmem_maxbytes) {
+            /* Finish in memory */
+            InMemoryLoad load;
+            graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
+            engine.set_disable_vertexdata_storage();
+            engine.set_modifies_inedges(false);
+            engine.set_modifies_outedges(false);
+            engine.set_disable_outedges(true);
+            engine.run(load, 1);
+            logstream(LOG_INFO) << "Finishing in memory: " << load.edges.size() << " edges" << std::endl;
+            
+            basic_text_output<VertexDataType, EdgeDataType> mstout(filename + ".mst", "\t");
+            inmemory_boruvka(load.edges, engine.num_vertices(), mstout);
+            
+            delete_shards<EdgeDataType>(filename, (int) engine.get_intervals().size());
+            std::cout << "Total MST now: " << totalMST << std::endl;
+            logstream(LOG_INFO) << "MSF ready!" << std::endl;
+            break;
         } else {
             BoruvskaStarContractionStep<EdgeDataType> boruvska_starcontraction;
             graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
@@ -486,6 +616,7 @@ int main(int argc, const char ** argv) {
                 break;
             }
             
+            contracted_edges = shardedout.num_edges();
             nshards = (int)shardedout.finish_sharding();
             filename = contractedname;
         }
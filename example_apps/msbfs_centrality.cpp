@@ -0,0 +1,467 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Closeness and betweenness centrality estimated from sampled sources with
+ * bit-parallel multi-source BFS (Then et al., "The More the Merrier").
+ * Up to 64 * W sources (W = 1, 2 or 4 words, i.e. 64, 128 or 256 sources)
+ * are traversed together: every vertex has W words of visited ("seen"),
+ * frontier and next-frontier bits, one bit per source, and each pass over
+ * the shards advances all of them by one level. A vertex pulls the
+ * frontier words of its in-neighbors (also out-neighbors with option
+ * "undirected"), masks them with its unseen bits and schedules its
+ * out-neighbors when it found new sources.
+ *
+ * For each vertex v and sampled source s at distance d(s, v), the run
+ * accumulates the sum of distances, the number of sources reached and the
+ * sum of 1 / d(s, v), giving the estimates (Eppstein & Wang)
+ *   closeness(v) = reached / distance sum   (inverse mean distance),
+ *   harmonic(v)  = (n - 1) / k * sum 1 / d(s, v),
+ * where k is the number of sources. Distances are measured from the
+ * sources, i.e. along in-edges of v (symmetric on undirected graphs).
+ *
+ * With option "betweenness", a source-sampled Brandes estimate
+ * (Brandes & Pich) is computed too. The forward passes also count
+ * shortest paths per (vertex, source), and the same number of backward
+ * passes accumulate dependencies from the deepest level up; this needs
+ * 14 bytes per vertex and source in memory.
+ *
+ * Sources are listed with option "sources" (comma separated) or sampled
+ * uniformly: option "nsources" (default 64) with "seed". More sources than
+ * fit into one batch are processed in several runs.
+ * "vertex closeness harmonic [betweenness]" lines are written to the file
+ * given with option "output".
+ */
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <stdint.h>
+
+#include "graphchi_basic_includes.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef vid_t VertexDataType;  // not stored
+typedef bool EdgeDataType;     // not relevant
+
+const uint16_t NOT_REACHED = 0xffff;
+
+/**
+ * Per-vertex estimates accumulated over all batches.
+ */
+struct centrality_accumulators {
+    std::vector<double> distsum;
+    std::vector<double> harmonic;
+    std::vector<double> betweenness;
+    std::vector<uint32_t> reached;
+
+    void resize(size_t n, bool with_betweenness) {
+        distsum.assign(n, 0.0);
+        harmonic.assign(n, 0.0);
+        reached.assign(n, 0);
+        if (with_betweenness) betweenness.assign(n, 0.0);
+    }
+};
+
+template <int W>
+struct MSBFSProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    centrality_accumulators &acc;
+    bool undirected;
+    bool with_betweenness;
+
+    std::vector<vid_t> sources;        // Sources of the batch, bit i = sources[i]
+    std::vector<uint64_t> seen;         // n * W words
+    std::vector<uint64_t> frontier;
+    std::vector<uint64_t> next;
+
+    /* Betweenness: indexed by v * 64 * W + source bit */
+    std::vector<double> sigma;          // Number of shortest paths
+    std::vector<float> delta;           // Dependency
+    std::vector<uint16_t> dist;
+    std::vector<uint16_t> minlevel, maxlevel;   // Range of dist[v * 64 * W ...], for skipping
+
+    bool forward;
+    int curlevel;
+    int depth;
+    size_t nnew;                        // Newly reached (vertex, source) pairs of the pass
+    size_t nscheduled;                  // Successors scheduled by the pass
+    size_t nreached;                    // Reached (vertex, source) pairs of the batch
+
+    MSBFSProgram(centrality_accumulators &acc, bool undirected, bool with_betweenness) :
+        acc(acc), undirected(undirected), with_betweenness(with_betweenness),
+        forward(true), curlevel(0), depth(0), nnew(0), nscheduled(0), nreached(0) {}
+
+    static size_t nbits() { return 64 * W; }
+
+    void set_batch(const std::vector<vid_t> &batch) {
+        assert(batch.size() <= nbits());
+        sources = batch;
+    }
+
+    inline bool has_bits(const uint64_t * words) const {
+        uint64_t x = 0;
+        for(int w=0; w < W; w++) x |= words[w];
+        return x != 0;
+    }
+
+    inline void visit_forward(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, vid_t v, graphchi_context &gcontext) {
+        const uint64_t * vseen = &seen[(size_t)v * W];
+        uint64_t fresh[W];
+        for(int w=0; w < W; w++) fresh[w] = 0;
+
+        int nedges = undirected ? vertex.num_edges() : vertex.num_inedges();
+        for(int i=0; i < nedges; i++) {
+            vid_t u = undirected ? vertex.edge(i)->vertex_id() : vertex.inedge(i)->vertex_id();
+            const uint64_t * uf = &frontier[(size_t)u * W];
+            for(int w=0; w < W; w++) fresh[w] |= uf[w] & ~vseen[w];
+        }
+        if (!has_bits(fresh)) return;
+
+        int level = curlevel + 1;
+        uint64_t * vnext = &next[(size_t)v * W];
+        uint64_t * vseenw = &seen[(size_t)v * W];
+        int cnt = 0;
+        for(int w=0; w < W; w++) {
+            vnext[w] = fresh[w];
+            vseenw[w] |= fresh[w];
+            cnt += __builtin_popcountll(fresh[w]);
+        }
+        acc.distsum[v] += (double) level * cnt;
+        acc.harmonic[v] += (double) cnt / level;
+        acc.reached[v] += cnt;
+        __sync_fetch_and_add(&nnew, (size_t) cnt);
+
+        if (with_betweenness) {
+            /* Shortest paths come from the neighbors that were in the frontier
+               of the same source */
+            size_t vb = (size_t)v * nbits();
+            for(int i=0; i < nedges; i++) {
+                vid_t u = undirected ? vertex.edge(i)->vertex_id() : vertex.inedge(i)->vertex_id();
+                const uint64_t * uf = &frontier[(size_t)u * W];
+                size_t ub = (size_t)u * nbits();
+                for(int w=0; w < W; w++) {
+                    uint64_t m = uf[w] & fresh[w];
+                    while (m) {
+                        int s = 64 * w + __builtin_ctzll(m);
+                        sigma[vb + s] += sigma[ub + s];
+                        m &= m - 1;
+                    }
+                }
+            }
+            for(int w=0; w < W; w++) {
+                uint64_t m = fresh[w];
+                while (m) {
+                    dist[vb + 64 * w + __builtin_ctzll(m)] = (uint16_t) level;
+                    m &= m - 1;
+                }
+            }
+            if (minlevel[v] == NOT_REACHED) minlevel[v] = (uint16_t) level;
+            maxlevel[v] = (uint16_t) level;
+        }
+
+        /* Successors may find new sources on the next level */
+        int nout = undirected ? vertex.num_edges() : vertex.num_outedges();
+        for(int i=0; i < nout; i++) {
+            vid_t dst = undirected ? vertex.edge(i)->vertex_id() : vertex.outedge(i)->vertex_id();
+            gcontext.scheduler->add_task(dst);
+        }
+        if (nout > 0) __sync_fetch_and_add(&nscheduled, (size_t) nout);
+    }
+
+    /**
+     * Dependency of v on the sources for which v is on level curlevel,
+     * delta(v) = sum over successors w of sigma(v) / sigma(w) * (1 + delta(w)).
+     */
+    inline void visit_backward(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, vid_t v) {
+        if (minlevel[v] > curlevel || maxlevel[v] < curlevel) return;
+        size_t vb = (size_t)v * nbits();
+        int ns = (int) sources.size();
+        int nout = undirected ? vertex.num_edges() : vertex.num_outedges();
+        for(int i=0; i < nout; i++) {
+            vid_t wv = undirected ? vertex.edge(i)->vertex_id() : vertex.outedge(i)->vertex_id();
+            if (minlevel[wv] > curlevel + 1 || maxlevel[wv] < curlevel + 1) continue;
+            size_t wb = (size_t)wv * nbits();
+            for(int s=0; s < ns; s++) {
+                if (dist[vb + s] == curlevel && dist[wb + s] == curlevel + 1) {
+                    delta[vb + s] += (float) (sigma[vb + s] / sigma[wb + s] * (1.0 + delta[wb + s]));
+                }
+            }
+        }
+        double b = 0;
+        for(int s=0; s < ns; s++) {
+            if (dist[vb + s] == curlevel) b += delta[vb + s];
+        }
+        acc.betweenness[v] += b;
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        if (forward) {
+            visit_forward(vertex, vertex.id(), gcontext);
+        } else {
+            visit_backward(vertex, vertex.id());
+        }
+    }
+
+    /**
+     * Called before an iteration starts. The forward phase ends with the
+     * first pass that reaches nothing new or schedules no successors (the
+     * deepest level is a sink); the engine then stops unless the backward
+     * passes are needed. They are scheduled here, one level per pass, and
+     * the engine stops after level 1.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        size_t n = gcontext.nvertices;
+        if (iteration == 0) {
+            seen.assign(n * W, 0);
+            frontier.assign(n * W, 0);
+            next.assign(n * W, 0);
+            if (with_betweenness) {
+                sigma.assign(n * nbits(), 0.0);
+                delta.assign(n * nbits(), 0.0f);
+                dist.assign(n * nbits(), NOT_REACHED);
+                minlevel.assign(n, NOT_REACHED);
+                maxlevel.assign(n, 0);
+            }
+            for(size_t i=0; i < sources.size(); i++) {
+                vid_t s = sources[i];
+                assert(s < n);
+                seen[(size_t)s * W + i / 64] |= 1ull << (i % 64);
+                frontier[(size_t)s * W + i / 64] |= 1ull << (i % 64);
+                if (with_betweenness) {
+                    sigma[(size_t)s * nbits() + i] = 1.0;
+                    dist[(size_t)s * nbits() + i] = 0;
+                    minlevel[s] = 0;
+                }
+            }
+            forward = true;
+            curlevel = 0;
+            depth = 0;
+            nnew = 0;
+            nscheduled = 0;
+            nreached = 0;
+            /* Iteration 0 runs all vertices */
+        } else if (forward) {
+            /* The previous pass reached level curlevel + 1 if nnew > 0 */
+            bool more = nnew > 0 && nscheduled > 0;
+            if (nnew > 0) depth = curlevel + 1;
+            nreached += nnew;
+            nnew = 0;
+            nscheduled = 0;
+            if (more) {
+                frontier.swap(next);
+                std::fill(next.begin(), next.end(), 0ull);
+                curlevel++;
+            } else {
+                /* Nothing is scheduled: start the backward passes in this call,
+                   otherwise the engine stops */
+                if (!with_betweenness || depth < 2) return;
+                forward = false;
+                curlevel = depth - 1;
+                schedule_level(gcontext, curlevel);
+            }
+        } else {
+            curlevel--;
+            if (curlevel < 1) return;
+            schedule_level(gcontext, curlevel);
+        }
+        logstream(LOG_INFO) << (forward ? "Forward" : "Backward") << " level " << curlevel << std::endl;
+    }
+
+    void schedule_level(graphchi_context &gcontext, int level) {
+        for(size_t v=0; v < minlevel.size(); v++) {
+            if (minlevel[v] <= level && maxlevel[v] >= level) gcontext.scheduler->add_task((vid_t) v);
+        }
+    }
+
+    /**
+     * Called after an iteration has finished.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+};
+
+static std::vector<vid_t> parse_sources(std::string s) {
+    std::vector<vid_t> sources;
+    std::stringstream ss(s);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        if (tok.size() > 0) sources.push_back((vid_t) atol(tok.c_str()));
+    }
+    return sources;
+}
+
+/**
+ * Samples k distinct vertices uniformly (Floyd's algorithm).
+ */
+static std::vector<vid_t> sample_sources(size_t n, size_t k, unsigned int seed) {
+    k = std::min(k, n);
+    srand(seed);
+    std::vector<vid_t> chosen;
+    std::vector<char> taken(n, 0);
+    for(size_t j=n - k; j < n; j++) {
+        size_t t = (size_t) ((double)rand() / ((double)RAND_MAX + 1.0) * (j + 1));
+        if (taken[t]) t = j;
+        taken[t] = 1;
+        chosen.push_back((vid_t) t);
+    }
+    std::sort(chosen.begin(), chosen.end());
+    return chosen;
+}
+
+template <int W>
+void run_batches(graphchi_engine<VertexDataType, EdgeDataType> &engine, std::vector<vid_t> &sources,
+                 centrality_accumulators &acc, bool undirected, bool with_betweenness, int niters) {
+    MSBFSProgram<W> program(acc, undirected, with_betweenness);
+    size_t B = MSBFSProgram<W>::nbits();
+    for(size_t first=0; first < sources.size(); first += B) {
+        size_t last = std::min(sources.size(), first + B);
+        logstream(LOG_INFO) << "Batch of sources " << first << " - " << (last - 1) << std::endl;
+        program.set_batch(std::vector<vid_t>(sources.begin() + first, sources.begin() + last));
+        engine.run(program, niters);
+        logstream(LOG_INFO) << "Batch depth " << program.depth << ", reached " << program.nreached
+                            << " (vertex, source) pairs" << std::endl;
+    }
+}
+
+int main(int argc, const char **argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("msbfs-centrality");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    std::string outfile = get_option_string("output", "");
+    bool undirected = get_option_int("undirected", 0) != 0;
+    bool with_betweenness = get_option_int("betweenness", 0) != 0;
+    int niters = get_option_int("niters", 100000);
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    engine.set_disable_vertexdata_storage();
+    /* Each update writes only the bits and accumulators of its own vertex */
+    engine.set_enable_deterministic_parallelism(false);
+
+    size_t n = engine.num_vertices();
+    std::vector<vid_t> sources = parse_sources(get_option_string("sources", ""));
+    if (sources.empty()) {
+        sources = sample_sources(n, (size_t) get_option_int("nsources", 64), (unsigned int) get_option_int("seed", 1));
+    }
+    if (sources.empty()) {
+        logstream(LOG_FATAL) << "Need at least one source." << std::endl;
+        return 1;
+    }
+    for(size_t i=0; i < sources.size(); i++) {
+        if (sources[i] >= n) {
+            logstream(LOG_FATAL) << "Source " << sources[i] << " is not a vertex." << std::endl;
+            return 1;
+        }
+    }
+
+    /* Words of bits per vertex: enough for all sources, at most four (256 sources) */
+    int words = (int) std::min((size_t)4, (sources.size() + 63) / 64);
+    if (words == 3) words = 4;
+    words = get_option_int("words", words);
+    size_t k = sources.size();
+    logstream(LOG_INFO) << k << " sources, " << (64 * words) << " per batch" << std::endl;
+    if (with_betweenness) {
+        logstream(LOG_INFO) << "Betweenness needs " << (n * 64 * words * 14 / 1024 / 1024) << " MB" << std::endl;
+    }
+
+    centrality_accumulators acc;
+    acc.resize(n, with_betweenness);
+    switch (words) {
+        case 1: run_batches<1>(engine, sources, acc, undirected, with_betweenness, niters); break;
+        case 2: run_batches<2>(engine, sources, acc, undirected, with_betweenness, niters); break;
+        case 4: run_batches<4>(engine, sources, acc, undirected, with_betweenness, niters); break;
+        default:
+            logstream(LOG_FATAL) << "Option words must be 1, 2 or 4." << std::endl;
+            return 1;
+    }
+
+    /* Estimates */
+    double harmonic_scale = n > 1 ? (double)(n - 1) / k : 0.0;
+    double betweenness_scale = (double) n / k;
+    vid_t best = 0;
+    double bestcloseness = 0;
+    for(size_t v=0; v < n; v++) {
+        double c = acc.distsum[v] > 0 ? acc.reached[v] / acc.distsum[v] : 0.0;
+        if (c > bestcloseness) {
+            bestcloseness = c;
+            best = (vid_t) v;
+        }
+    }
+    if (outfile.size() > 0) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+        } else {
+            for(size_t v=0; v < n; v++) {
+                double c = acc.distsum[v] > 0 ? acc.reached[v] / acc.distsum[v] : 0.0;
+                if (with_betweenness) {
+                    fprintf(f, "%u %.8g %.8g %.8g\n", (unsigned) v, c, acc.harmonic[v] * harmonic_scale,
+                            acc.betweenness[v] * betweenness_scale);
+                } else {
+                    fprintf(f, "%u %.8g %.8g\n", (unsigned) v, c, acc.harmonic[v] * harmonic_scale);
+                }
+            }
+            fclose(f);
+        }
+    }
+    std::cout << "Sources: " << k << ", highest closeness: vertex " << best << " (" << bestcloseness << ")" << std::endl;
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
@@ -22,9 +22,14 @@
  *
  * @section DESCRIPTION
  *
- * Simple pagerank implementation. Uses the basic vertex-based API for
- * demonstration purposes. A faster implementation uses the functional API,
- * "pagerank_functional".
+ * Simple pagerank implementation. By default (mode "pull"), ranks are pulled
+ * from an in-memory (or memory mapped) array using only the adjacency of the
+ * graph, see api/pull_spmv.hpp. Option "gaussseidel" uses the newest ranks
+ * within an iteration, and a positive "tolerance" stops the run when the
+ * total change of the ranks is below it.
+ *
+ * Mode "edges" uses the basic vertex-based API for demonstration purposes:
+ * ranks are sent through edge data.
  */
 
 #include <string>
@@ -35,6 +40,7 @@
 
 
 #include "graphchi_basic_includes.hpp"
+#include "api/pull_spmv.hpp"
 #include "util/toplist.hpp"
 
 using namespace graphchi;
@@ -115,34 +121,21 @@ struct PagerankProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 };
 
 /**
-  * Faster version of pagerank which holds vertices in memory. Used only if the number
-  * of vertices is small enough.
+  * Faster version of pagerank for the pull-mode SpMV: the rank divided by the
+  * out-degree is read from memory, so edge data is not needed.
   */
-struct PagerankProgramInmem : public GraphChiProgram<VertexDataType, EdgeDataType> {
-    
-    std::vector<EdgeDataType> pr;
-    PagerankProgramInmem(int nvertices) :   pr(nvertices, RANDOMRESETPROB) {}
+struct pagerank_spmv_kernel {
+    inline float initial(vid_t v) {
+        return 1.0f;
+    }
     
-    void update(graphchi_vertex<VertexDataType, EdgeDataType> &v, graphchi_context &ginfo) {
-        if (ginfo.iteration > 0) {
-            float sum=0;
-            for(int i=0; i < v.num_inedges(); i++) {
-              sum += pr[v.inedge(i)->vertexid];
-            }
-            if (v.outc > 0) {
-                pr[v.id()] = (RANDOMRESETPROB + (1 - RANDOMRESETPROB) * sum) / v.outc;
-            } else {
-                pr[v.id()] = (RANDOMRESETPROB + (1 - RANDOMRESETPROB) * sum);
-            }
-        } else if (ginfo.iteration == 0) {
-            if (v.outc > 0) pr[v.id()] = 1.0f / v.outc;
-        }
-        if (ginfo.iteration == ginfo.num_iterations - 1) {
-            /* On last iteration, multiply pr by degree and store the result */
-            v.set_data(v.outc > 0 ? pr[v.id()] * v.outc : pr[v.id()]);
-        }
+    inline float scatter(float x, int outdegree) {
+        return outdegree > 0 ? x / outdegree : x;
     }
     
+    inline float apply(float sum) {
+        return RANDOMRESETPROB + (1 - RANDOMRESETPROB) * sum;
+    }
 };
 
 int main(int argc, const char ** argv) {
@@ -152,9 +145,12 @@ int main(int argc, const char ** argv) {
 
     /* Parameters */
     std::string filename    = get_option_string("file"); // Base filename
-    int niters              = get_option_int("niters", 4);
+    double tolerance        = get_option_float("tolerance", 0.0f);
+    int niters              = get_option_int("niters", tolerance > 0 ? 100 : 4);
     bool scheduler          = false;                    // Non-dynamic version of pagerank.
     int ntop                = get_option_int("top", 20);
+    std::string mode        = get_option_string("mode", "pull");
+    bool gauss_seidel       = get_option_int("gaussseidel", 0) != 0;
     
     /* Process input file - if not already preprocessed */
     int nshards             = convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
@@ -163,17 +159,14 @@ int main(int argc, const char ** argv) {
     graphchi_engine<float, float> engine(filename, nshards, scheduler, m); 
     engine.set_modifies_inedges(false); // Improves I/O performance.
     
-    bool inmemmode = engine.num_vertices() * sizeof(EdgeDataType) < (size_t)engine.get_membudget_mb() * 1024L * 1024L;
-    if (inmemmode) {
-        logstream(LOG_INFO) << "Running Pagerank by holding vertices in-memory mode!" << std::endl;
-        engine.set_modifies_outedges(false);
-        engine.set_disable_outedges(true);
-        engine.set_only_adjacency(true);
-        PagerankProgramInmem program(engine.num_vertices());
-        engine.run(program, niters);
-    } else {
+    if (mode == "pull") {
+        logstream(LOG_INFO) << "Running Pagerank in pull mode (" << (gauss_seidel ? "Gauss-Seidel" : "Jacobi") << ")" << std::endl;
+        run_pull_spmv(engine, filename, pagerank_spmv_kernel(), niters, gauss_seidel, tolerance);
+    } else if (mode == "edges") {
         PagerankProgram program;
         engine.run(program, niters);
+    } else {
+        logstream(LOG_FATAL) << "Unknown mode " << mode << ", needs to be either 'pull' or 'edges'." << std::endl;
     }
     
     /* Output top ranked vertices */
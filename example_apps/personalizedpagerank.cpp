@@ -0,0 +1,372 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Batched multi-source personalized PageRank with push-style residual
+ * propagation (Andersen, Chung & Lang). Each vertex carries, for every seed
+ * set of the batch, an estimate p and a residual r. Pushing a vertex moves
+ * alpha * r to its estimate and spreads the rest evenly over its out-edges
+ * (dangling vertices return it to the seed set). A vertex is pushed only
+ * while r >= epsilon * outdegree for some seed set, so on termination the
+ * L1 error of each estimate is below epsilon * |E|.
+ *
+ * Vertices whose residual crosses the threshold are put to a bucket_frontier
+ * by -log2(r / outdegree); each iteration (one pass over the shards) pops
+ * the "priority_window" lowest buckets, so the largest residuals of all
+ * seed sets of the batch are pushed first and share the same pass.
+ *
+ * Seed sets are read from the file given with option "seeds" (one set per
+ * line, vertex ids separated by spaces or commas), or from option
+ * "sources" (comma separated, one seed per set). The estimates and
+ * residuals are kept in memory as dense blocks of n * B floats; B seed sets
+ * are processed per run, with B limited by option "ppr_maxmem_mb". The
+ * "top" highest scores of each seed set are written as
+ * "seed-set vertex score" lines to the file given with option "output".
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "graphchi_basic_includes.hpp"
+#include "engine/bucket_frontier.hpp"
+#include "util/atomic.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef float VertexDataType;
+typedef bool EdgeDataType;  // not relevant
+
+typedef std::pair<float, vid_t> scored_vertex;
+
+static inline float atomic_take(float &x) {
+    float old;
+    do {
+        old = x;
+    } while (!atomic_compare_and_swap(x, old, 0.0f));
+    return old;
+}
+
+/**
+ * Push-based PPR for a batch of B seed sets. p[v * B + k] and r[v * B + k]
+ * are the estimate and residual of vertex v for seed set k of the batch.
+ */
+struct PPRProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    float alpha;
+    float epsilon;
+    size_t window;
+
+    std::vector<std::vector<vid_t> > batch;   // Seed sets of the current batch
+    int B;
+
+    std::vector<float> p;
+    std::vector<float> r;
+    std::vector<int> outdeg;
+    std::vector<bool> in_current;
+    std::vector<vid_t> current;
+
+    bucket_frontier frontier;
+    size_t npushes;
+
+    PPRProgram(float alpha, float epsilon, size_t window) : alpha(alpha), epsilon(epsilon), window(window), B(0), npushes(0) {}
+
+    void set_batch(const std::vector<std::vector<vid_t> > &seedsets) {
+        batch = seedsets;
+        B = (int) batch.size();
+    }
+
+    inline float threshold(vid_t v) {
+        return epsilon * std::max(outdeg[v], 1);
+    }
+
+    inline size_t bucket_of(float residual, vid_t v) {
+        double ratio = residual / std::max(outdeg[v], 1);
+        return (size_t) std::max(0.0, std::floor(-std::log(ratio) / std::log(2.0)));
+    }
+
+    /**
+     * Adds to a residual, and puts the vertex to the frontier if that
+     * lifted it over the push threshold. Thread-safe.
+     */
+    inline void add_residual(vid_t v, int k, float amount) {
+        float old = atomic_add(r[(size_t)v * B + k], amount);
+        float thr = threshold(v);
+        if (old < thr && old + amount >= thr) {
+            frontier.push(v, bucket_of(old + amount, v));
+        }
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        int deg = vertex.num_outedges();
+        if (gcontext.iteration == 0) {
+            outdeg[v] = deg;
+        }
+        if (!in_current[v]) return;
+
+        float thr = epsilon * std::max(deg, 1);
+        size_t pushes = 0;
+        for(int k=0; k < B; k++) {
+            size_t idx = (size_t)v * B + k;
+            if (r[idx] < thr) continue;
+            float res = atomic_take(r[idx]);
+            p[idx] += alpha * res;   // Only this update writes p of v
+            float rest = (1.0f - alpha) * res;
+            if (deg == 0) {
+                std::vector<vid_t> &seeds = batch[k];
+                for(size_t j=0; j < seeds.size(); j++) {
+                    add_residual(seeds[j], k, rest / seeds.size());
+                }
+            } else {
+                float share = rest / deg;
+                for(int i=0; i < deg; i++) {
+                    add_residual(vertex.outedge(i)->vertex_id(), k, share);
+                }
+            }
+            pushes++;
+        }
+        if (pushes > 0) __sync_add_and_fetch(&npushes, pushes);
+    }
+
+    /**
+     * Called before an iteration starts. Pops the highest-priority
+     * buckets and schedules the vertices that are still over the threshold.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        size_t n = gcontext.nvertices;
+        if (iteration == 0) {
+            /* A batch stopped by the niters limit may leave vertices behind */
+            frontier.clear();
+            current.clear();
+            p.assign(n * B, 0.0f);
+            r.assign(n * B, 0.0f);
+            in_current.assign(n, false);
+            if (outdeg.size() != n) outdeg.assign(n, 0);
+            for(int k=0; k < B; k++) {
+                for(size_t j=0; j < batch[k].size(); j++) {
+                    vid_t s = batch[k][j];
+                    if (s >= n) {
+                        logstream(LOG_FATAL) << "Seed " << s << " out of range, graph has " << n << " vertices." << std::endl;
+                    }
+                    assert(s < n);
+                    r[(size_t)s * B + k] += 1.0f / batch[k].size();
+                    frontier.push(s, 0);
+                }
+            }
+        } else {
+            for(size_t i=0; i < current.size(); i++) in_current[current[i]] = false;
+        }
+
+        /* Pop until some vertex is over its threshold, or the frontier is empty */
+        std::vector<vid_t> popped;
+        long minbucket = -1;
+        current.clear();
+        while (current.empty() && !frontier.empty()) {
+            minbucket = frontier.next_buckets(popped, window);
+            for(size_t i=0; i < popped.size(); i++) {
+                vid_t v = popped[i];
+                if (iteration == 0) {   // Degrees are not known yet, all vertices are run anyway
+                    current.push_back(v);
+                    continue;
+                }
+                float rmax = 0;
+                for(int k=0; k < B; k++) rmax = std::max(rmax, r[(size_t)v * B + k]);
+                if (rmax < threshold(v)) continue;   // Stale entry
+                size_t b = bucket_of(rmax, v);
+                if (b >= (size_t) minbucket + window) {
+                    frontier.push(v, b);   // Was pushed before its degree was known
+                    continue;
+                }
+                current.push_back(v);
+                gcontext.scheduler->add_task(v);
+            }
+        }
+        for(size_t i=0; i < current.size(); i++) in_current[current[i]] = true;
+
+        if (!current.empty()) {
+            logstream(LOG_INFO) << "Buckets " << minbucket << "-" << (minbucket + window - 1) << ": "
+                                << current.size() << " vertices" << std::endl;
+        }
+    }
+
+    /**
+     * Returns the "top" highest estimates of seed set k, and its
+     * remaining residual mass (an upper bound for the L1 error).
+     */
+    std::vector<scored_vertex> top_scores(int k, size_t top, double &residual) {
+        size_t n = p.size() / B;
+        std::vector<scored_vertex> scores;
+        residual = 0;
+        for(size_t v=0; v < n; v++) {
+            float pv = p[v * B + k];
+            residual += r[v * B + k];
+            if (pv > 0) scores.push_back(scored_vertex(pv, (vid_t) v));
+        }
+        size_t t = std::min(top, scores.size());
+        std::partial_sort(scores.begin(), scores.begin() + t, scores.end(), std::greater<scored_vertex>());
+        scores.resize(t);
+        return scores;
+    }
+
+    /**
+     * Called after an iteration has finished.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+};
+
+static std::vector<vid_t> parse_vertices(std::string s) {
+    std::vector<vid_t> vertices;
+    std::replace(s.begin(), s.end(), ',', ' ');
+    std::stringstream ss(s);
+    long v;
+    while (ss >> v) vertices.push_back((vid_t) v);
+    return vertices;
+}
+
+static std::vector<std::vector<vid_t> > read_seedsets(std::string seedfile, std::string sources) {
+    std::vector<std::vector<vid_t> > seedsets;
+    if (seedfile.size() > 0) {
+        std::ifstream f(seedfile.c_str());
+        if (!f.good()) {
+            logstream(LOG_FATAL) << "Could not open seed file " << seedfile << std::endl;
+            return seedsets;
+        }
+        std::string line;
+        while (std::getline(f, line)) {
+            if (line.size() == 0 || line[0] == '#') continue;
+            std::vector<vid_t> seeds = parse_vertices(line);
+            if (!seeds.empty()) seedsets.push_back(seeds);
+        }
+    } else {
+        std::vector<vid_t> seeds = parse_vertices(sources);
+        for(size_t i=0; i < seeds.size(); i++) seedsets.push_back(std::vector<vid_t>(1, seeds[i]));
+    }
+    return seedsets;
+}
+
+int main(int argc, const char **argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("personalized-pagerank");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    int niters = get_option_int("niters", 1000000);    // Upper bound for the number of passes per batch
+    float alpha = get_option_float("alpha", 0.15f);     // Reset probability
+    float epsilon = get_option_float("epsilon", 1e-7f); // Push threshold per out-edge
+    size_t window = (size_t) get_option_int("priority_window", 4);
+    size_t top = (size_t) get_option_int("top", 20);
+    size_t maxmem_mb = (size_t) get_option_int("ppr_maxmem_mb", 1024);
+    std::string outfile = get_option_string("output", "");
+    std::vector<std::vector<vid_t> > seedsets = read_seedsets(get_option_string("seeds", ""),
+                                                              get_option_string("sources", "0"));
+
+    if (seedsets.empty() || epsilon <= 0 || alpha <= 0 || alpha >= 1 || window == 0) {
+        logstream(LOG_FATAL) << "Need at least one seed, positive epsilon and priority_window, and 0 < alpha < 1." << std::endl;
+        return 1;
+    }
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    engine.set_disable_vertexdata_storage();
+    /* Residuals are updated atomically; estimates only by their own vertex */
+    engine.set_enable_deterministic_parallelism(false);
+
+    /* Batch size: estimates and residuals of B seed sets must fit in memory */
+    size_t n = engine.num_vertices();
+    size_t B = std::max((size_t)1, (maxmem_mb * 1024 * 1024) / (2 * sizeof(float) * std::max(n, (size_t)1)));
+    int batchsize = get_option_int("batchsize", (int) std::min(B, seedsets.size()));
+    if (batchsize < 1) {
+        logstream(LOG_FATAL) << "Option batchsize must be at least 1, was " << batchsize << "." << std::endl;
+        return 1;
+    }
+    B = (size_t) batchsize;
+    logstream(LOG_INFO) << seedsets.size() << " seed sets, " << B << " per batch" << std::endl;
+
+    FILE * f = NULL;
+    if (outfile.size() > 0) {
+        f = fopen(outfile.c_str(), "w");
+        if (f == NULL) logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+    }
+
+    PPRProgram program(alpha, epsilon, window);
+    double maxresidual = 0;
+    for(size_t first=0; first < seedsets.size(); first += B) {
+        size_t last = std::min(seedsets.size(), first + B);
+        program.set_batch(std::vector<std::vector<vid_t> >(seedsets.begin() + first, seedsets.begin() + last));
+        engine.run(program, niters);
+
+        for(size_t k=first; k < last; k++) {
+            double residual;
+            std::vector<scored_vertex> scores = program.top_scores((int) (k - first), top, residual);
+            maxresidual = std::max(maxresidual, residual);
+            if (f == NULL) continue;
+            for(size_t i=0; i < scores.size(); i++) {
+                fprintf(f, "%u %u %.8g\n", (unsigned) k, scores[i].second, scores[i].first);
+            }
+        }
+    }
+    if (f != NULL) fclose(f);
+
+    std::cout << "Seed sets: " << seedsets.size() << ", pushes: " << program.npushes
+              << ", max residual mass: " << maxresidual << std::endl;
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
@@ -25,23 +25,28 @@
  * @section DESCRIPTION
  *
  * Random walk simulation. From a set of source vertices, a set of 
- * random walks is started. Random walks walk via edges, and we use the
- * dynamic chivectors to support multiple walks in one edge. Each
- * vertex keeps track of the walks that pass by it, thus in the end
- * we have estimate of the "pagerank" of each vertex.
+ * random walks is started. Each vertex keeps track of the walks that pass
+ * by it, thus in the end we have estimate of the "pagerank" of each vertex.
  *
- * Note, this version does not support 'resets' of random walks.
- * TODO: from each vertex, start new random walks with some probability,
- * and also terminate a walk with some probablity.
+ * The walks are not stored in the edges, but in the in-memory walk manager
+ * (engine/walk_manager.hpp), one 64-bit word per walk, bucketed by vertex.
+ * When an interval is loaded, all its walks advance one hop together. On
+ * each hop, a walk terminates with probability "termination" (and always
+ * after "maxhops" hops), and jumps back to its source with probability
+ * "reset"; walks at vertices without out-edges also jump back to the source.
+ * With termination probability alpha, the end points of the walks of a
+ * source sample its personalized PageRank; they are written to "output"
+ * as lines "source vertex count".
  *
+ * The edges carry no data, so the graph is only read.
  */
 
-#define DYNAMICEDATA 1
-
 #include <string>
+#include <vector>
+#include <algorithm>
 
 #include "graphchi_basic_includes.hpp"
-#include "api/dynamicdata/chivector.hpp"
+#include "engine/walk_manager.hpp"
 #include "util/toplist.hpp"
 
 using namespace graphchi;
@@ -51,17 +56,37 @@ using namespace graphchi;
  * Sharder-program.
  */
 typedef unsigned int VertexDataType;
-typedef chivector<vid_t>  EdgeDataType;
+typedef bool EdgeDataType;  // not relevant
+
+/* Lock-free per-vertex random numbers */
+static inline uint64_t next_random(uint64_t &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+static inline double random_unit(uint64_t &state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
 
- 
 struct RandomWalkProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
     
-    int walks_per_source() {
-        return 100;
-    }
+    std::vector<vid_t> sources;
+    int walks_per_source;
+    double termination;
+    double reset;
+    uint32_t maxhops;
+    bool record_endpoints;
     
-    bool is_source(vid_t v) {
-        return (v % 50 == 0);
+    walk_manager * walks;
+    std::vector<uint64_t> endpoints;  // (source index << 32) | vertex
+    spinlock endpoint_lock;
+    
+    RandomWalkProgram() : walks(NULL) {}
+    
+    ~RandomWalkProgram() {
+        delete walks;
     }
     
     /**
@@ -69,44 +94,40 @@ struct RandomWalkProgram : public GraphChiProgram<VertexDataType, EdgeDataType>
      */
     void update(graphchi_vertex<VertexDataType, EdgeDataType > &vertex, graphchi_context &gcontext) {
         if (gcontext.iteration == 0) {
+            vertex.set_data(0);
+        }
+        size_t nwalks;
+        walk_t * vwalks = walks->walks_at(vertex.id(), nwalks);
+        if (nwalks == 0) return;
+        
+        uint64_t rnd = ((uint64_t) vertex.id() << 20) ^ (uint64_t) (gcontext.iteration + 1) * 0x9E3779B97F4A7C15ULL;
+        std::vector<uint64_t> ended;
+        for(size_t i=0; i < nwalks; i++) {
+            uint32_t source = walk_source(vwalks[i]);
+            uint32_t hop = walk_hop(vwalks[i]) + 1;
             
-            if (is_source(vertex.id())) {
-                for(int i=0; i < walks_per_source(); i++) {
-                    /* Get random out edge's vector */
-                    graphchi_edge<EdgeDataType> * outedge = vertex.random_outedge();
-                    if (outedge != NULL) {
-                        chivector<vid_t> * evector = outedge->get_vector();
-                        /* Add a random walk particle, represented by the vertex-id of the source (this vertex) */
-                        evector->add(vertex.id());
-                        gcontext.scheduler->add_task(outedge->vertex_id()); // Schedule destination
-                    }
-                }
+            if (hop >= maxhops || random_unit(rnd) < termination) {
+                walks->end_walk();
+                if (record_endpoints) ended.push_back(((uint64_t) source << 32) | vertex.id());
+                continue;
             }
-            vertex.set_data(0);
-        } else {
-            /* Check inbound edges for walks and advance them. */
-            int num_walks = 0;
-            for(int i=0; i < vertex.num_inedges(); i++) {
-                graphchi_edge<EdgeDataType> * edge = vertex.inedge(i);
-                chivector<vid_t> * invector = edge->get_vector();
-                for(int j=0; j < invector->size(); j++) {
-                    /* Get one walk */
-                    vid_t walk = invector->get(j);
-                    /* Move to a random out-edge */
-                    graphchi_edge<EdgeDataType> * outedge = vertex.random_outedge();
-                    if (outedge != NULL) {
-                        chivector<vid_t> * outvector = outedge->get_vector();
-                        /* Add a random walk particle, represented by the vertex-id of the source (this vertex) */
-                        outvector->add(walk);
-                        gcontext.scheduler->add_task(outedge->vertex_id()); // Schedule destination
-                    }
-                    num_walks ++;
-                }
-                /* Remove all walks from the inbound vector */
-                invector->clear();
+            vid_t next;
+            if (vertex.num_outedges() == 0 || (reset > 0 && random_unit(rnd) < reset)) {
+                next = sources[source];
+            } else {
+                next = vertex.outedge((int) (next_random(rnd) % vertex.num_outedges()))->vertex_id();
             }
-            /* Keep track of the walks passed by via this vertex */
-            vertex.set_data(vertex.get_data() + num_walks);
+            walks->move_walk(source, hop, next);
+            gcontext.scheduler->add_task(next, true);  // Also this iteration, if its interval is still ahead
+        }
+        
+        /* Keep track of the walks passed by via this vertex */
+        vertex.set_data(vertex.get_data() + (unsigned int) nwalks);
+        
+        if (!ended.empty()) {
+            endpoint_lock.lock();
+            endpoints.insert(endpoints.end(), ended.begin(), ended.end());
+            endpoint_lock.unlock();
         }
     }
     
@@ -114,24 +135,59 @@ struct RandomWalkProgram : public GraphChiProgram<VertexDataType, EdgeDataType>
      * Called before an iteration starts.
      */
     void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            delete walks;  // left by a previous run
+            walks = new walk_manager(gcontext.nvertices);
+            for(size_t s=0; s < sources.size(); s++) {
+                for(int i=0; i < walks_per_source; i++) {
+                    walks->start_walk((uint32_t) s, sources[s]);
+                }
+            }
+        }
+        logstream(LOG_INFO) << "Active walks: " << walks->num_active() << std::endl;
     }
     
     /**
      * Called after an iteration has finished.
      */
     void after_iteration(int iteration, graphchi_context &gcontext) {
+        if (walks->num_active() == 0) {
+            logstream(LOG_INFO) << "All walks finished." << std::endl;
+            gcontext.set_last_iteration(iteration);
+        }
     }
     
     /**
      * Called before an execution interval is started.
      */
     void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+        walks->begin_interval(window_st, window_en);
     }
     
     /**
      * Called after an execution interval has finished.
      */
     void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+        walks->end_interval(gcontext.scheduler);
+    }
+    
+    /**
+     * Writes "source vertex count" for the end points of the walks.
+     */
+    void write_endpoints(std::string outfile) {
+        std::sort(endpoints.begin(), endpoints.end());
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        for(size_t i=0; i < endpoints.size(); ) {
+            size_t j = i;
+            while (j < endpoints.size() && endpoints[j] == endpoints[i]) j++;
+            fprintf(f, "%u %u %lu\n", sources[endpoints[i] >> 32], (unsigned) (endpoints[i] & 0xffffffffu), (unsigned long) (j - i));
+            i = j;
+        }
+        fclose(f);
     }
     
 };
@@ -149,21 +205,35 @@ int main(int argc, const char ** argv) {
     
     /* Basic arguments for application */
     std::string filename = get_option_string("file");  // Base filename
-    int niters           = get_option_int("niters", 4); // Number of iterations
+    int niters           = get_option_int("niters", 1000); // Max number of iterations
     bool scheduler       = true;                       // Whether to use selective scheduling
+    int source_every     = get_option_int("source_every", 50); // Every n'th vertex is a source
+    std::string outfile  = get_option_string("output", "");
     
     /* Detect the number of shards or preprocess an input to create them */
-    bool preexisting_shards;
-    int nshards          = convert_if_notexists<vid_t>(filename, get_option_string("nshards", "auto"), preexisting_shards);
+    int nshards          = convert_if_notexists_novalues<EdgeDataType>(filename, get_option_string("nshards", "auto"));
     
     /* Run */
     RandomWalkProgram program;
+    program.walks_per_source = get_option_int("walks_per_source", 100);
+    program.termination = get_option_float("termination", 0.15f);
+    program.reset = get_option_float("reset", 0.0f);
+    program.maxhops = (uint32_t) std::min(get_option_int("maxhops", 100), (1 << WALK_HOP_BITS) - 1);
+    program.record_endpoints = outfile.size() > 0;
+    
     graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
-    if (preexisting_shards) {
-        engine.reinitialize_edge_data(0);
+    for(vid_t v=0; v < engine.num_vertices(); v += source_every) {
+        program.sources.push_back(v);
     }
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Walks are moved through the thread-safe walk manager, not the edges */
+    engine.set_enable_deterministic_parallelism(false);
     engine.run(program, niters);
     
+    if (program.record_endpoints) program.write_endpoints(outfile);
+    
     /* List top 20 */
     int ntop = 20;
     std::vector< vertex_value<VertexDataType> > top = get_top_vertices<VertexDataType>(filename, ntop);
@@ -7,310 +7,424 @@
  * @section LICENSE
  *
  * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
- * 
+ *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
  * You may obtain a copy of the License at
- * 
+ *
  * http://www.apache.org/licenses/LICENSE-2.0
- * 
+ *
  * Unless required by applicable law or agreed to in writing, software
  * distributed under the License is distributed on an "AS IS" BASIS,
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
  * limitations under the License.
- 
+
  *
  * @section DESCRIPTION
  *
- * Application for computing the connected components of a graph.
- * The algorithm is simple: on first iteration each vertex sends its
- * id to neighboring vertices. On subsequent iterations, each vertex chooses
- * the smallest id of its neighbors and broadcasts its (new) label to
- * its neighbors. The algorithm terminates when no vertex changes label.
+ * Graph simulation and dual simulation of a small labeled pattern graph
+ * against a (large, out-of-core) labeled data graph.
+ *
+ * Data vertex v simulates pattern vertex u if the labels match and for each
+ * pattern edge u->u', v has an out-neighbor simulating u'. Dual simulation
+ * (mode=dual) requires the same for the in-edges: for each pattern edge
+ * u''->u, v must have an in-neighbor simulating u''.
  *
- * @section REMARKS
+ * The candidate set of each data vertex is a bitmask over the pattern
+ * vertices, initialized from a label -> pattern vertices index. Instead of
+ * rescanning the neighbors, each vertex keeps support counters: out[u'] is
+ * the number of its out-neighbors that are (still) candidates of u' (in[u'']
+ * likewise for in-neighbors). The counters are computed once on the first
+ * pass. When a vertex loses candidates, it publishes the removed bits for the
+ * next iteration and schedules only its neighbors that can be affected.
+ * Those decrement their counters by the removed bits and drop pattern
+ * vertices whose support reached zero. The algorithm finishes when no
+ * candidates are removed.
  *
- * This application is interesting demonstration of the asyncronous capabilities
- * of GraphChi, improving the convergence considerably. Consider
- * a chain graph 0->1->2->...->n. First, vertex 0 will write its value to its edges,
- * which will be observed by vertex 1 immediatelly, changing its label to 0. Nexgt,
- * vertex 2 changes its value to 0, and so on. This all happens in one iteration.
- * A subtle issue is that as any pair of vertices a<->b share an edge, they will
- * overwrite each others value. However, because they will be never run in parallel
- * (due to deterministic parallellism of graphchi), this does not compromise correctness.
+ * Labels and the initial, current and removed candidate masks are kept in
+ * memory (20 bytes per vertex), the counters are the vertex values on disk.
  *
- * @author Aapo Kyrola
+ * Input: data vertex labels from file "labels" ("vertex label" per line;
+ * without it, labels are pseudo-random in [0, nlabels)). The pattern is read
+ * from file "pattern" with lines "v id label" and "e src dst"; without it an
+ * n-clique (option "clique", default 3) with labels i % nlabels is used.
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <cmath>
+#include <map>
 #include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
 
 #include "graphchi_basic_includes.hpp"
-#include "util/labelanalysis.hpp"
-#include "util/bitmap.hpp"
 
 using namespace graphchi;
 
-int         iterationcount = 0;
-bool        scheduler = false;
+/* Maximum number of pattern vertices (the size of the vertex values depends on it) */
+#ifndef SIM_MAX_PATTERN
+#define SIM_MAX_PATTERN 8
+#endif
+
+typedef uint32_t patternmask_t;
 
 /**
- * Type definitions. Remember to create suitable graph shards using the
- * Sharder-program. 
+ * Support counters of a data vertex, per pattern vertex.
  */
-typedef vid_t VertexDataType;       // vid_t is the vertex id type
-typedef vid_t EdgeDataType;
-
-struct Vertex {
-    unsigned vid_;
-    size_t indegree_ = 0;
-    size_t outdegree_ = 0;
-    unsigned label_;
-    unsigned *out_edges_ = nullptr;
+struct sim_counters {
+    uint32_t out[SIM_MAX_PATTERN];
+    uint32_t in[SIM_MAX_PATTERN];
 };
 
-struct ImmutableCSR {
-    size_t num_vertexes_ = 0;
-    size_t num_edges_ = 0;
-    Vertex ** vertexes_ = nullptr;
-};
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef sim_counters VertexDataType;
+typedef bool EdgeDataType;  // not relevant
 
-void ShowImmutableCSR(ImmutableCSR & graph){
-    printf("num_vertexes_: %d, num_edges: %d\n", graph.num_vertexes_, graph.num_edges_);
-    printf(" out: ");
-    for(size_t i =0; i < graph.num_vertexes_; i++){        
-        printf("%d, ", graph.vertexes_[i]->vid_);
+/**
+ * Pattern graph with the edges as bitmasks.
+ */
+struct sim_pattern {
+    int n;
+    std::vector<unsigned> labels;
+    std::vector<patternmask_t> children;
+    std::vector<patternmask_t> parents;
+    std::map<unsigned, patternmask_t> label_index;   // label -> pattern vertices with it
+
+    sim_pattern() : n(0) {}
+
+    void add_vertex(int id, unsigned label) {
+        if (id >= n) {
+            n = id + 1;
+            labels.resize(n, 0);
+            children.resize(n, 0);
+            parents.resize(n, 0);
+        }
+        labels[id] = label;
+    }
+
+    void add_edge(int src, int dst) {
+        assert(src < n && dst < n);
+        children[src] |= patternmask_t(1) << dst;
+        parents[dst] |= patternmask_t(1) << src;
+    }
+
+    void build_index() {
+        label_index.clear();
+        for(int u=0; u < n; u++) label_index[labels[u]] |= patternmask_t(1) << u;
+    }
+
+    patternmask_t candidates(unsigned label) {
+        std::map<unsigned, patternmask_t>::iterator it = label_index.find(label);
+        return it == label_index.end() ? 0 : it->second;
     }
-    printf("  \n  ");
-}
 
-struct MatchSet {
-      Bitmap* indicator_ = nullptr;
-      Bitmap** sim_sets_ = nullptr;
-      size_t x_ = 0;
-      size_t y_ = 0;
-            
-      MatchSet(const size_t x, const size_t y, const bool init = false) {
-          x_ = x;
-          y_ = y;
-          indicator_ = new Bitmap(x);
-          indicator_->clear();
-          sim_sets_ = (Bitmap**)malloc(sizeof(Bitmap*) * x);
-          
-          if (!init)
-              for (size_t i = 0; i < x; i++) sim_sets_[i] = nullptr;
-          else {
-              for (size_t i = 0; i < x; i++) {
-                  sim_sets_[i] = new Bitmap(y);
-                  sim_sets_[i]->clear();
-              }
-          }
-      }
-
-      ~MatchSet() {
-          if (indicator_ != nullptr) delete indicator_;
-          if (sim_sets_ != nullptr) {
-              for (size_t i = 0; i < x_; i++)
-                  if (sim_sets_[i] == nullptr) delete sim_sets_[i];
-              free(sim_sets_);
-          }
-      }
+    /** Union of the children (or parents) of the pattern vertices in mask */
+    patternmask_t union_of(const std::vector<patternmask_t> &adj, patternmask_t mask) {
+        patternmask_t r = 0;
+        for(int u=0; u < n; u++) {
+            if (mask & (patternmask_t(1) << u)) r |= adj[u];
+        }
+        return r;
+    }
 };
 
-ImmutableCSR* InitPatternNClique(size_t n) {
-    ImmutableCSR * graph = new ImmutableCSR;
-    graph->num_vertexes_ = n;
-    graph->num_edges_ = n * (n - 1);
-    graph->vertexes_ = (Vertex **)malloc(sizeof(Vertex*) * graph->num_vertexes_);
-    for(size_t i = 0; i < graph->num_vertexes_; i++) {
-       Vertex *vertex = new Vertex;
-       vertex->vid_ = i;
-       vertex->label_ = rand() % 5;
-       vertex->indegree_ = n-1;
-       vertex->outdegree_ = n-1;
-       vertex->out_edges_ = (unsigned *)malloc(sizeof(unsigned) * (n - 1));
-       for(size_t j = 0; j < graph->num_vertexes_; j++){
-           if(i == j) continue;
-           printf("vid: %d, add edge %d", i, j);
-           vertex->out_edges_[j] = i;
-       }
-       printf("\n");
-       graph->vertexes_[i] = vertex;
+sim_pattern load_pattern(std::string filename) {
+    sim_pattern p;
+    std::ifstream f(filename.c_str());
+    if (!f.good()) {
+        logstream(LOG_FATAL) << "Could not open pattern file: " << filename << std::endl;
+    }
+    assert(f.good());
+    std::string line;
+    int lineno = 0;
+    std::vector<std::pair<int, int> > edges;
+    std::vector<int> edgelines;
+    while (std::getline(f, line)) {
+        lineno++;
+        std::stringstream ss(line);
+        std::string kind;
+        ss >> kind;
+        if (kind == "v") {
+            int id; unsigned label;
+            ss >> id >> label;
+            if (ss.fail() || id < 0 || id >= SIM_MAX_PATTERN) {
+                logstream(LOG_FATAL) << filename << ":" << lineno << ": pattern vertex id must be 0.." << (SIM_MAX_PATTERN - 1)
+                                     << ". Recompile with larger SIM_MAX_PATTERN for larger patterns." << std::endl;
+            }
+            p.add_vertex(id, label);
+        } else if (kind == "e") {
+            int src, dst;
+            ss >> src >> dst;
+            if (ss.fail()) {
+                logstream(LOG_FATAL) << filename << ":" << lineno << ": expected \"e src dst\"." << std::endl;
+            }
+            edges.push_back(std::pair<int, int>(src, dst));
+            edgelines.push_back(lineno);
+        }
+    }
+    /* Edges may precede the vertices, so they are checked once all vertices are known */
+    for(size_t i=0; i < edges.size(); i++) {
+        int src = edges[i].first, dst = edges[i].second;
+        if (src < 0 || src >= p.n || dst < 0 || dst >= p.n) {
+            logstream(LOG_FATAL) << filename << ":" << edgelines[i] << ": edge " << src << " -> " << dst
+                                 << " is not between pattern vertices 0.." << (p.n - 1) << std::endl;
+        }
+        p.add_edge(src, dst);
+    }
+    return p;
+}
+
+sim_pattern clique_pattern(int n, int nlabels) {
+    if (n < 1 || n > SIM_MAX_PATTERN || nlabels < 1) {
+        logstream(LOG_FATAL) << "Clique must have 1.." << SIM_MAX_PATTERN << " vertices and at least one label, has "
+                             << n << " vertices and " << nlabels << " labels." << std::endl;
     }
-    return graph;
+    sim_pattern p;
+    for(int i=0; i < n; i++) p.add_vertex(i, i % nlabels);
+    for(int i=0; i < n; i++) {
+        for(int j=0; j < n; j++) {
+            if (i != j) p.add_edge(i, j);
+        }
+    }
+    return p;
 }
 
+static inline int popcount(patternmask_t x) {
+    return __builtin_popcount(x);
+}
 
 /**
- * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type> 
+ * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type>
  * class. The main logic is usually in the update function.
  */
-struct SimPragram : public GraphChiProgram<VertexDataType, EdgeDataType> {
-    
-    bool converged;
+struct SimProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 
-    ImmutableCSR * pattern_;
-    MatchSet * match_set_;
-    /**
-     *  Vertex update function.
-     *  On first iteration ,each vertex chooses a label = the vertex id.
-     *  On subsequent iterations, each vertex chooses the minimum of the neighbor's
-     *  label (and itself). 
-     */
+    sim_pattern pattern;
+    bool dual;
 
-    bool kernel_check_childs(graphchi_vertex<VertexDataType, EdgeDataType> & u, unsigned pattern_vid){
-        
-        size_t count = 0;
-        for(int i=0; i < u.num_edges(); i++) {
-            vid_t nbr_u_label = u.edge(i)->get_data();
-            auto nbr_u_id = u.edge(i)->vertex_id();
-
-            for(size_t j = 0; j < pattern_->vertexes_[pattern_vid]->outdegree_; j++)
-            {
-                auto nbr_v_id= pattern_->vertexes_[j]->vid_;
-                auto nbr_v_label= pattern_->vertexes_[j]->label_;
-
-                if(nbr_u_label == nbr_v_label)
-                {
-                    if(match_set_->indicator_->get_bit(nbr_v_id) == 0) continue;
-                    count++;
-                }
-            
+    std::vector<unsigned> labels;
+    std::vector<patternmask_t> initial;       // Label-based candidates
+    std::vector<patternmask_t> candidates;
+    std::vector<patternmask_t> removed_cur;   // Removed on the previous iteration
+    std::vector<patternmask_t> removed_next;
+    size_t nremovals;
+
+    SimProgram(sim_pattern pattern, bool dual) : pattern(pattern), dual(dual), nremovals(0) {}
+
+    inline void schedule_neighbors(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        /* In-neighbors count this vertex in their out-counters, and vice versa */
+        for(int i=0; i < vertex.num_inedges(); i++) {
+            vid_t nb = vertex.inedge(i)->vertex_id();
+            if (candidates[nb] != 0) gcontext.scheduler->add_task(nb);
+        }
+        if (dual) {
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                vid_t nb = vertex.outedge(i)->vertex_id();
+                if (candidates[nb] != 0) gcontext.scheduler->add_task(nb);
             }
-        
-            return count== pattern_->vertexes_[pattern_vid]->outdegree_;
-    
         }
     }
 
-    bool CheckU(graphchi_vertex<VertexDataType, EdgeDataType> & u, unsigned pattern_vid) {
-        auto uid = u.vertexid;
-        return kernel_check_childs(u, pattern_vid);
-    }
-
+    /**
+     *  Vertex update function.
+     */
     void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
-        
-        if (scheduler) gcontext.scheduler->remove_tasks(vertex.id(), vertex.id());
-        
+        vid_t v = vertex.id();
+        patternmask_t mask = candidates[v];
+        if (mask == 0) return;
+
+        /* Counted pattern vertices: fixed by the initial candidates, so that
+           decrements always match the increments of the first pass. */
+        patternmask_t outrel = pattern.union_of(pattern.children, initial[v]);
+        patternmask_t inrel = (dual ? pattern.union_of(pattern.parents, initial[v]) : 0);
+
+        sim_counters c = vertex.get_data();
         if (gcontext.iteration == 0) {
-            vertex.set_data(rand() % 5);
-            if (scheduler)  gcontext.scheduler->add_task(rand() % 5);
-        }
-        
-        if (gcontext.iteration == 1) {
-            if (match_set_->indicator_->get_bit(vertex.vertexid)) ;
-            else {
-                for(size_t pattern_i = 0; pattern_i < pattern_->num_vertexes_; pattern_i++) {
-                    if(vertex.get_data() == pattern_->vertexes_[pattern_i]->label_) {
-                        match_set_->indicator_->set_bit(vertex.vertexid);
-                        match_set_->sim_sets_[vertex.vertexid]->set_bit(pattern_i);
-                        //printf("%d match %d, label: %d\n ", vertex.vertexid, pattern_i, pattern_->vertexes_[pattern_i]->label_);
-                    }
-                }
+            memset(&c, 0, sizeof(sim_counters));
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                patternmask_t bits = initial[vertex.outedge(i)->vertex_id()] & outrel;
+                while (bits) { c.out[__builtin_ctz(bits)]++; bits &= bits - 1; }
+            }
+            for(int i=0; inrel != 0 && i < vertex.num_inedges(); i++) {
+                patternmask_t bits = initial[vertex.inedge(i)->vertex_id()] & inrel;
+                while (bits) { c.in[__builtin_ctz(bits)]++; bits &= bits - 1; }
+            }
+        } else {
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                patternmask_t bits = removed_cur[vertex.outedge(i)->vertex_id()] & outrel;
+                while (bits) { c.out[__builtin_ctz(bits)]--; bits &= bits - 1; }
+            }
+            for(int i=0; inrel != 0 && i < vertex.num_inedges(); i++) {
+                patternmask_t bits = removed_cur[vertex.inedge(i)->vertex_id()] & inrel;
+                while (bits) { c.in[__builtin_ctz(bits)]--; bits &= bits - 1; }
             }
         }
-        /* Check childs */
-        if (gcontext.iteration > 1 ) {
-            for(size_t i = 0; i< pattern_->num_vertexes_; i++)
-            {
-                auto pattern_vid = pattern_->vertexes_[i]->vid_;
-                if(match_set_->sim_sets_[i]->get_bit(pattern_vid))
-                {
-                    if(!CheckU(vertex, (unsigned)pattern_vid))
-                    {
-                        match_set_->sim_sets_[i]->rm_bit(pattern_vid);
-                        for(int j=0; j < vertex.num_edges(); j++) {
-                        if (scheduler) gcontext.scheduler->add_task(vertex.edge(j)->vertex_id(), true);
-                        converged = false;
-
-                        }
-                    }
-                }
 
+        /* Pattern vertices without support */
+        patternmask_t zero_out = 0, zero_in = 0;
+        for(int u=0; u < pattern.n; u++) {
+            if ((outrel >> u & 1) && c.out[u] == 0) zero_out |= patternmask_t(1) << u;
+            if ((inrel >> u & 1) && c.in[u] == 0) zero_in |= patternmask_t(1) << u;
+        }
+        patternmask_t removed = 0;
+        if (zero_out | zero_in) {
+            for(int u=0; u < pattern.n; u++) {
+                if ((mask >> u & 1) && ((pattern.children[u] & zero_out) || (pattern.parents[u] & zero_in))) {
+                    removed |= patternmask_t(1) << u;
+                }
             }
         }
+        vertex.set_data(c);
 
-
-    }    
+        if (removed != 0) {
+            candidates[v] = mask & ~removed;
+            removed_next[v] = removed;
+            __sync_add_and_fetch(&nremovals, (size_t) popcount(removed));
+            schedule_neighbors(vertex, gcontext);
+        }
+    }
     /**
      * Called before an iteration starts.
      */
-    void before_iteration(int iteration, graphchi_context &info) {
-        iterationcount++;
-        converged = iteration > 0;
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            size_t n = gcontext.nvertices;
+            initial.resize(n);
+            for(size_t v=0; v < n; v++) initial[v] = pattern.candidates(labels[v]);
+            candidates = initial;
+            removed_cur.assign(n, 0);
+            removed_next.assign(n, 0);
+        } else {
+            removed_cur.swap(removed_next);
+            std::fill(removed_next.begin(), removed_next.end(), 0);
+        }
+        nremovals = 0;
     }
-    
+
     /**
      * Called after an iteration has finished.
      */
-    void after_iteration(int iteration, graphchi_context &ginfo) {
-        if (converged) {
-            std::cout << "Converged!" << std::endl;
-            ginfo.set_last_iteration(iteration);
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        logstream(LOG_INFO) << "Iteration " << iteration << ": removed " << nremovals << " candidates." << std::endl;
+    }
+
+    /**
+     * Number of data vertices simulating each pattern vertex.
+     */
+    std::vector<size_t> match_counts() {
+        std::vector<size_t> counts(pattern.n, 0);
+        for(size_t v=0; v < candidates.size(); v++) {
+            for(int u=0; u < pattern.n; u++) counts[u] += (candidates[v] >> u) & 1;
+        }
+        return counts;
+    }
+
+    void write_matches(std::string outfile) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        for(size_t v=0; v < candidates.size(); v++) {
+            for(int u=0; u < pattern.n; u++) {
+                if ((candidates[v] >> u) & 1) fprintf(f, "%u %d\n", (unsigned) v, u);
+            }
         }
+        fclose(f);
     }
-    
+
     /**
      * Called before an execution interval is started.
      */
-    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {        
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {
     }
-    
+
     /**
      * Called after an execution interval has finished.
      */
-    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {        
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {
     }
-    
+
 };
 
+std::vector<unsigned> load_labels(std::string labelfile, size_t nvertices, int nlabels) {
+    std::vector<unsigned> labels(nvertices);
+    if (labelfile.size() == 0) {
+        for(size_t v=0; v < nvertices; v++) labels[v] = (((uint32_t) v * 2654435761u) >> 16) % nlabels;
+        return labels;
+    }
+    /* Unlabeled vertices match nothing */
+    std::fill(labels.begin(), labels.end(), 0xffffffffu);
+    FILE * f = fopen(labelfile.c_str(), "r");
+    if (f == NULL) {
+        logstream(LOG_FATAL) << "Could not open labels file: " << labelfile << std::endl;
+    }
+    assert(f != NULL);
+    unsigned v, label;
+    while (fscanf(f, "%u %u", &v, &label) == 2) {
+        if (v < nvertices) labels[v] = label;
+    }
+    fclose(f);
+    return labels;
+}
+
 int main(int argc, const char ** argv) {
-    /* GraphChi initialization will read the command line 
+    /* GraphChi initialization will read the command line
      arguments and the configuration file. */
     graphchi_init(argc, argv);
 
     /* Metrics object for keeping track of performance counters
      and other information. Currently required. */
-    metrics m("connected-components");
-    
+    metrics m("graph-simulation");
+
     /* Basic arguments for application */
     std::string filename = get_option_string("file");  // Base filename
     int niters           = get_option_int("niters", 1000); // Number of iterations (max)
-    scheduler            = get_option_int("scheduler", false);
-    
+    int nlabels          = get_option_int("nlabels", 5);
+    bool dual            = get_option_string("mode", "sim") == "dual";
+    std::string patternfile = get_option_string("pattern", "");
+    std::string outfile  = get_option_string("output", "");
+
     /* Process input file - if not already preprocessed */
-    int nshards             = (int) convert_if_notexists<EdgeDataType>(filename, get_option_string("nshards", "auto"));
-    
-    int n = 5;
-    printf("InitPatternNClique\n");
-    ImmutableCSR * pattern = InitPatternNClique(n);
-    MatchSet * matchset = new MatchSet(2147483647, n, true);
-    printf("ShowImmutableCSR");
-    ShowImmutableCSR(*pattern);
-    
-    printf("#################################\n");
-    
-    if (get_option_int("onlyresult", 0) == 0) {
-        /* Run */
-        SimPragram program;
-        program.match_set_ = matchset;
-        program.pattern_ = pattern;
-
-        graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m); 
-        engine.run(program, niters);
+    int nshards             = (int) convert_if_notexists_novalues<EdgeDataType>(filename, get_option_string("nshards", "auto"));
+
+    sim_pattern pattern = (patternfile.size() > 0 ? load_pattern(patternfile) :
+                           clique_pattern(get_option_int("clique", 3), nlabels));
+    if (pattern.n == 0 || pattern.n > SIM_MAX_PATTERN) {
+        logstream(LOG_FATAL) << "Pattern must have 1.." << SIM_MAX_PATTERN << " vertices, has " << pattern.n
+                             << ". Recompile with larger SIM_MAX_PATTERN." << std::endl;
     }
-    
-    /* Run analysis of the connected components  (output is written to a file) */
-    m.start_time("label-analysis");
-    
-    analyze_labels<vid_t>(filename);
-    m.stop_time("label-analysis");
-    
+    assert(pattern.n > 0 && pattern.n <= SIM_MAX_PATTERN);
+    pattern.build_index();
+
+    /* Run */
+    SimProgram program(pattern, dual);
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    program.labels = load_labels(get_option_string("labels", ""), engine.num_vertices(), nlabels);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Vertices write only their own counters and candidates */
+    engine.set_enable_deterministic_parallelism(false);
+    engine.run(program, niters);
+
+    std::vector<size_t> counts = program.match_counts();
+    bool matches = true;
+    for(int u=0; u < pattern.n; u++) {
+        std::cout << "Pattern vertex " << u << " (label " << pattern.labels[u] << "): " << counts[u] << " matches" << std::endl;
+        matches = matches && counts[u] > 0;
+    }
+    std::cout << (dual ? "Dual simulation" : "Simulation") << (matches ? " found." : " does not exist.") << std::endl;
+    if (outfile.size() > 0) program.write_matches(outfile);
+
     /* Report execution metrics */
     metrics_report(m);
     return 0;
 }
-
@@ -0,0 +1,274 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Weighted single-source shortest paths with delta-stepping. Edge weights
+ * (non-negative, a negative weight aborts the run) are read from the edge
+ * data, and several sources can be solved in one run (option "sources",
+ * comma separated).
+ *
+ * Tentative distances are kept in memory. Vertices whose distance improves
+ * are pushed to the bucket floor(dist / delta) of a bucketed frontier, and
+ * each iteration processes only the vertices of the lowest non-empty bucket:
+ * the selective scheduler skips all shards without scheduled vertices.
+ * A bucket is repeated until no relaxation falls back into it. Small delta
+ * approaches Dijkstra (few relaxations, many iterations), large delta
+ * approaches Bellman-Ford.
+ *
+ * The vertex value is the minimum distance from any of the sources.
+ */
+
+#include <string>
+#include <vector>
+#include <cfloat>
+#include <fstream>
+#include <sstream>
+
+#include "graphchi_basic_includes.hpp"
+#include "engine/bucket_frontier.hpp"
+#include "util/atomic.hpp"
+
+using namespace graphchi;
+
+/**
+ * Type definitions. Remember to create suitable graph shards using the
+ * Sharder-program.
+ */
+typedef float VertexDataType;
+typedef float EdgeDataType;
+
+const float INF = FLT_MAX;
+
+/**
+ * Delta-stepping SSSP for K sources. dist[v * K + k] is the tentative distance
+ * of vertex v from source k, relaxed[v * K + k] the distance from which v's
+ * out-edges were last relaxed for source k.
+ */
+struct DeltaSteppingProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+    std::vector<vid_t> sources;
+    int K;
+    float delta;
+
+    std::vector<float> dist;
+    std::vector<float> relaxed;
+    std::vector<bool> in_current;   // Vertices of the bucket being processed
+    std::vector<vid_t> current;
+    long curbucket;
+
+    bucket_frontier frontier;
+    size_t nrelaxations;
+    size_t nbucketpasses;
+
+    DeltaSteppingProgram(std::vector<vid_t> sources, float delta) : sources(sources), delta(delta) {
+        K = (int) sources.size();
+        curbucket = -1;
+        nrelaxations = 0;
+        nbucketpasses = 0;
+    }
+
+    inline size_t bucket_of(float d) {
+        return (size_t) (d / delta);
+    }
+
+    /**
+     *  Vertex update function.
+     */
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+        vid_t v = vertex.id();
+        if (gcontext.iteration == 0) {
+            vertex.set_data(INF);
+        }
+        if (!in_current[v]) return;
+
+        float mindist = INF;
+        size_t nrelax = 0;
+        for(int k=0; k < K; k++) {
+            size_t idx = (size_t)v * K + k;
+            float d = dist[idx];
+            if (d < mindist) mindist = d;
+            if (!(d < relaxed[idx]) || (long) bucket_of(d) > curbucket) continue;
+            relaxed[idx] = d;
+
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                graphchi_edge<EdgeDataType> * e = vertex.outedge(i);
+                vid_t dst = e->vertex_id();
+                float w = e->get_data();
+                if (w < 0) {
+                    logstream(LOG_FATAL) << "Negative weight " << w << " on edge " << v << " -> " << dst
+                                         << ", delta-stepping needs non-negative weights." << std::endl;
+                }
+                float nd = d + w;
+                if (atomic_min(dist[(size_t)dst * K + k], nd)) {
+                    frontier.push(dst, bucket_of(nd));
+                }
+            }
+            nrelax += vertex.num_outedges();
+        }
+        vertex.set_data(mindist);
+        if (nrelax > 0) __sync_add_and_fetch(&nrelaxations, nrelax);
+    }
+
+    /**
+     * Called before an iteration starts. Pops the next bucket
+     * and schedules its vertices.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        if (iteration == 0) {
+            size_t n = gcontext.nvertices;
+            dist.assign(n * K, INF);
+            relaxed.assign(n * K, INF);
+            in_current.assign(n, false);
+            for(int k=0; k < K; k++) {
+                if (sources[k] >= n) {
+                    logstream(LOG_FATAL) << "Source " << sources[k] << " out of range, graph has " << n << " vertices." << std::endl;
+                }
+                assert(sources[k] < n);
+                dist[(size_t)sources[k] * K + k] = 0.0f;
+                frontier.push(sources[k], 0);
+            }
+        } else {
+            for(size_t i=0; i < current.size(); i++) in_current[current[i]] = false;
+        }
+
+        /* On the first iteration all vertices are scheduled anyway */
+        if (iteration == 0) {
+            curbucket = frontier.next_bucket(current);
+        } else {
+            curbucket = frontier.schedule_next_bucket(gcontext.scheduler, current);
+        }
+        for(size_t i=0; i < current.size(); i++) in_current[current[i]] = true;
+
+        if (curbucket >= 0) {
+            nbucketpasses++;
+            logstream(LOG_INFO) << "Bucket " << curbucket << ": " << current.size() << " vertices" << std::endl;
+        }
+    }
+
+    /**
+     * Writes "vertex source-index distance" for all reached vertices.
+     */
+    void write_distances(std::string outfile) {
+        FILE * f = fopen(outfile.c_str(), "w");
+        if (f == NULL) {
+            logstream(LOG_ERROR) << "Could not open " << outfile << " for writing." << std::endl;
+            return;
+        }
+        size_t n = dist.size() / K;
+        for(size_t v=0; v < n; v++) {
+            for(int k=0; k < K; k++) {
+                float d = dist[v * K + k];
+                if (d < INF) fprintf(f, "%u %u %f\n", (unsigned) v, (unsigned) sources[k], d);
+            }
+        }
+        fclose(f);
+    }
+
+    void report() {
+        size_t n = dist.size() / K;
+        for(int k=0; k < K; k++) {
+            size_t reached = 0;
+            float maxdist = 0;
+            for(size_t v=0; v < n; v++) {
+                float d = dist[v * K + k];
+                if (d < INF) {
+                    reached++;
+                    if (d > maxdist) maxdist = d;
+                }
+            }
+            std::cout << "Source " << sources[k] << ": reached " << reached << " vertices, max distance " << maxdist << std::endl;
+        }
+        std::cout << "Bucket passes: " << nbucketpasses << ", edge relaxations: " << nrelaxations << std::endl;
+    }
+
+    /**
+     * Called after an iteration has finished.
+     */
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called before an execution interval is started.
+     */
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+
+    /**
+     * Called after an execution interval has finished.
+     */
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {
+    }
+};
+
+static std::vector<vid_t> parse_sources(std::string s) {
+    std::vector<vid_t> sources;
+    std::stringstream ss(s);
+    std::string tok;
+    while (std::getline(ss, tok, ',')) {
+        if (tok.size() > 0) sources.push_back((vid_t) atol(tok.c_str()));
+    }
+    return sources;
+}
+
+int main(int argc, const char **argv) {
+    /* GraphChi initialization will read the command line
+       arguments and the configuration file. */
+    graphchi_init(argc, argv);
+
+    /* Metrics object for keeping track of performance counters
+       and other information. Currently required. */
+    metrics m("sssp-deltastepping");
+
+    /* Basic arguments for application */
+    std::string filename = get_option_string("file");  // Base filename
+    int niters = get_option_int("niters", 1000000);    // Upper bound for the number of bucket passes
+    float delta = get_option_float("delta", 1.0f);     // Bucket width
+    std::vector<vid_t> sources = parse_sources(get_option_string("sources", "0"));
+    std::string outfile = get_option_string("output", "");
+
+    if (sources.empty() || delta <= 0) {
+        logstream(LOG_FATAL) << "Need at least one source and positive delta." << std::endl;
+        return 1;
+    }
+
+    /* Detect the number of shards or preprocess an input to create them */
+    int nshards = convert_if_notexists<EdgeDataType>(filename,
+                                                     get_option_string("nshards", "auto"));
+
+    /* Run */
+    DeltaSteppingProgram program(sources, delta);
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Updates write only to the atomically updated in-memory distances */
+    engine.set_enable_deterministic_parallelism(false);
+    engine.run(program, niters);
+
+    program.report();
+    if (outfile.size() > 0) program.write_distances(outfile);
+
+    /* Report execution metrics */
+    metrics_report(m);
+    return 0;
+}
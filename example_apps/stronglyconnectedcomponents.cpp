@@ -19,7 +19,7 @@
  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
  * See the License for the specific language governing permissions and
  * limitations under the License.
- 
+
  *
  * @section DESCRIPTION
  *
@@ -29,13 +29,32 @@
  author={Salihoglu, Semih and Widom, Jennifer},
  publisher={Stanford InfoLab}
  }
+ *
+ * The algorithm runs in rounds on the vertices not yet assigned to a
+ * component ("live"), which are split into partitions; no SCC crosses
+ * a partition, so only edges within a partition are followed:
+ *  1. Trimming: a vertex without live in- or out-neighbors is an SCC of
+ *     its own. Repeated while it removes at least "trim_fraction" of the
+ *     live vertices per pass.
+ *  2. Forward coloring (multi-pivot): every vertex starts with its own id
+ *     as color and takes the minimum color of its in-neighbors, so the
+ *     color of v is the smallest id that reaches v.
+ *  3. Backward: each vertex whose color is its own id is a pivot; the
+ *     vertices of the same color that reach the pivot form its SCC.
+ * The rest are partitioned by their colors for the next round. Once the
+ * live subgraph fits in "inmem_maxmem_mb" megabytes, it is read into memory
+ * in one pass and finished with Tarjan's algorithm.
+ *
+ * Vertex states are kept in memory, so edges carry no data and all phases
+ * run in a single engine, without contracting the graph in between. The
+ * label of each vertex (smallest vertex id of its SCC) is written as its
+ * vertex value.
  */
 
-
-#define SUPPORT_DELETIONS 1
-
 #include <string>
+#include <vector>
 #include <ostream>
+#include <algorithm>
 
 #include "graphchi_basic_includes.hpp"
 #include "util/labelanalysis.hpp"
@@ -43,364 +62,360 @@
 
 using namespace graphchi;
 
+typedef vid_t VertexDataType;
+typedef bool EdgeDataType;  // not relevant
 
-/**
- * Unlike in weakly connected components, we need
- * to ensure that neighbors do not overwrite each
- * others values. This is achieved by keeping two values
- * in an edge. In this struct, smaller_one is the id of the
- * vertex that has smaller id, and larger_one the others.
- * This complexity is due to us ignoring the direction of an edge.
- */
-struct bidirectional_label {
-    vid_t smaller_one;
-    vid_t larger_one;
-    
-    
-    vid_t & neighbor_label(vid_t myid, vid_t nbid) {
-        assert(larger_one != 0xffffffffu);
-        assert(smaller_one != 0xffffffffu);
-        
-        if (myid < nbid) {
-            return larger_one;
-        } else {
-            return smaller_one;
-        }
-    }
-    
-    vid_t & my_label(vid_t myid, vid_t nbid) {
-        assert(larger_one != 0xffffffffu);
-        assert(smaller_one != 0xffffffffu);
-        
-        if (myid < nbid) {
-            return smaller_one;
-        } else {
-            return larger_one;
-        }
-    }
-    
-    // Annoying hack
-    bool deleted() {
-        return smaller_one == 0xffffffffu;
-    }
-};
+const vid_t UNASSIGNED = 0xffffffffu;
 
-int super_step = 0;
+enum scc_phase { SCC_TRIM, SCC_FORWARD, SCC_BACKWARD, SCC_INMEMORY, SCC_OUTPUT, SCC_DONE };
 
+static const char * phase_names[] = { "trim", "forward", "backward", "in-memory", "output", "done" };
 
-// Id for the output stream for contracted graph
-int CONTRACTED_GRAPH_OUTPUT;
+struct SCCProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 
-struct SCCinfo {
-    vid_t color;
-    bool confirmed;
-    SCCinfo() : color(0), confirmed(false) {}
-    SCCinfo(vid_t color) : color(color), confirmed(false) {}
-    SCCinfo(vid_t color, bool confirmed) : color(color), confirmed(confirmed) {}
-    
-    friend std::ostream& operator<< (std::ostream &out, SCCinfo &scc) {
-        out << scc.color;
-        return out;
-    }
-    
-};
+    double trim_fraction;
+    size_t inmem_maxbytes;
 
-/* Overloaded operators to help with labelanalysis.hpp */
+    std::vector<vid_t> scc;         // Component label, or UNASSIGNED if live
+    std::vector<vid_t> color;       // Forward color of the current round
+    std::vector<vid_t> partition;   // Partition of the current round
 
-bool operator<(const SCCinfo &a, const SCCinfo &b);
-bool operator<(const SCCinfo &a, const SCCinfo &b) {
-    return a.color < b.color;
-}
+    scc_phase phase;
+    bool first_pass;                // First pass of a round, counts the live edges
+    size_t nlive;
+    size_t nlive_edges;
+    size_t nchanged;
+    bool pending;                   // Updates scheduled vertices for the next pass
+    int round;
+    std::vector<size_t> passes;     // Passes per phase
 
-bool operator==(const SCCinfo &a, const SCCinfo &b);
-bool operator==(const SCCinfo &a, const SCCinfo &b) {
-    return a.color == b.color;
-}
-bool operator!=(const SCCinfo &a, const SCCinfo &b);
-bool operator!=(const SCCinfo &a, const SCCinfo &b) {
-    return a.color != b.color;
-}
+    /* In-memory finish */
+    std::vector<vid_t> live_ids;
+    std::vector<vid_t> compact_id;
+    std::vector<std::vector<vid_t> > adj;
 
-typedef SCCinfo VertexDataType;
-typedef bidirectional_label EdgeDataType;
+    SCCProgram(double trim_fraction, size_t inmem_maxbytes) : trim_fraction(trim_fraction), inmem_maxbytes(inmem_maxbytes),
+        phase(SCC_TRIM), first_pass(true), nlive(0), nlive_edges(0), nchanged(0), pending(false), round(0), passes(SCC_DONE + 1, 0) {}
 
-static inline bool VARIABLE_IS_NOT_USED is_deleted_edge_value(bidirectional_label val);
-static inline bool VARIABLE_IS_NOT_USED is_deleted_edge_value(bidirectional_label val) {
-    return 0xffffffffu == val.smaller_one;
-}
+    inline bool live(vid_t v) {
+        return scc[v] == UNASSIGNED;
+    }
 
-static void VARIABLE_IS_NOT_USED remove_edgev(graphchi_edge<bidirectional_label> * e);
-static void VARIABLE_IS_NOT_USED remove_edgev(graphchi_edge<bidirectional_label> * e) {
-    bidirectional_label deletedlabel;
-    deletedlabel.smaller_one = 0xffffffffu;
-    deletedlabel.larger_one = 0xffffffffu;
-    e->set_data(deletedlabel);
-}
+    /* Live neighbor in the same partition */
+    inline bool follows(vid_t v, vid_t nb) {
+        return nb != v && live(nb) && partition[nb] == partition[v];
+    }
 
-bool first_iteration = true;
-bool remainingvertices = true;
+    inline void assign(vid_t v, vid_t label) {
+        scc[v] = label;
+        __sync_sub_and_fetch(&nlive, 1);
+        __sync_add_and_fetch(&nchanged, 1);
+    }
+
+    inline void schedule(vid_t v, graphchi_context &gcontext) {
+        gcontext.scheduler->add_task(v);
+        pending = true;
+    }
 
-/**
- * FORWARD-PHASE
- */
-struct SCCForward : public GraphChiProgram<VertexDataType, EdgeDataType> {
-    
-    
     /**
      *  Vertex update function.
      */
     void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
-        if (first_iteration) {
-            vertex.set_data(SCCinfo(vertex.id()));
-        }
-       
-        
-        if (vertex.get_data().confirmed) {
-           
-            if (vertex.num_edges() > 0) {
-                vertex.remove_alledges();
-            }
+        vid_t v = vertex.id();
+        if (phase == SCC_OUTPUT) {
+            vertex.set_data(scc[v]);
             return;
         }
-        
-        /* Vertices with only in or out edges cannot be part of a SCC (Trimming) */
-        if (vertex.num_inedges() == 0 || vertex.num_outedges() == 0) {
-            if (vertex.num_edges() > 0) {
-                // TODO: check this logic!
-                vertex.set_data(SCCinfo(vertex.id(), true));
+        if (!live(v)) return;
+
+        switch(phase) {
+            case SCC_TRIM: {
+                bool has_in = false, has_out = false;
+                size_t nout = 0;
+                for(int i=0; i < vertex.num_inedges() && !has_in; i++) {
+                    has_in = follows(v, vertex.inedge(i)->vertex_id());
+                }
+                for(int i=0; i < vertex.num_outedges(); i++) {
+                    if (follows(v, vertex.outedge(i)->vertex_id())) {
+                        has_out = true;
+                        nout++;
+                        if (!first_pass) break;
+                    }
+                }
+                if (first_pass) __sync_add_and_fetch(&nlive_edges, nout);
+                if (has_in && has_out) return;
+
+                assign(v, v);
+                /* Neighbors may have become trimmable */
+                for(int i=0; i < vertex.num_edges(); i++) {
+                    vid_t nb = vertex.edge(i)->vertex_id();
+                    if (follows(v, nb)) schedule(nb, gcontext);
+                }
+                break;
             }
-            vertex.remove_alledges();
-            return;
-        }
-        remainingvertices = true;
-        
-        VertexDataType vertexdata = vertex.get_data();
-        bool propagate = false;
-        if (gcontext.iteration == 0) {
-            vertexdata = vertex.id();
-            propagate = true;
-            /* Clean up in-edges. This would be nicer in the messaging abstraction... */
-            for(int i=0; i < vertex.num_inedges(); i++) {
-                bidirectional_label edgedata = vertex.inedge(i)->get_data();
-                if (!edgedata.deleted()) {
-                    edgedata.my_label(vertex.id(), vertex.inedge(i)->vertexid) = vertex.id();
-                    vertex.inedge(i)->set_data(edgedata);
+            case SCC_FORWARD: {
+                vid_t mincolor = color[v];
+                for(int i=0; i < vertex.num_inedges(); i++) {
+                    vid_t nb = vertex.inedge(i)->vertex_id();
+                    if (follows(v, nb)) mincolor = std::min(mincolor, color[nb]);
                 }
+                if (mincolor < color[v]) {
+                    color[v] = mincolor;
+                    for(int i=0; i < vertex.num_outedges(); i++) {
+                        vid_t nb = vertex.outedge(i)->vertex_id();
+                        if (follows(v, nb)) schedule(nb, gcontext);
+                    }
+                }
+                break;
             }
-        } else {
-            
-            /* Loop over in-edges and choose minimum color */
-            vid_t minid = vertexdata.color;
-            for(int i=0; i < vertex.num_inedges(); i++) {
-                if (!vertex.inedge(i)->get_data().deleted()) {
-                    minid = std::min(minid, vertex.inedge(i)->get_data().neighbor_label(vertex.id(), vertex.inedge(i)->vertexid));
+            case SCC_BACKWARD: {
+                vid_t c = color[v];
+                bool reaches = false;
+                for(int i=0; i < vertex.num_outedges() && !reaches; i++) {
+                    vid_t nb = vertex.outedge(i)->vertex_id();
+                    reaches = (nb != v && scc[nb] == c && partition[nb] == partition[v]);
+                }
+                if (!reaches) return;
+                assign(v, c);
+                for(int i=0; i < vertex.num_inedges(); i++) {
+                    vid_t nb = vertex.inedge(i)->vertex_id();
+                    if (follows(v, nb) && color[nb] == c) schedule(nb, gcontext);
                 }
+                break;
             }
-            
-            if (minid != vertexdata.color) {
-                vertexdata.color = minid;
-                propagate = true;
+            case SCC_INMEMORY: {
+                /* Only this update writes the list of v */
+                std::vector<vid_t> &out = adj[compact_id[v]];
+                for(int i=0; i < vertex.num_outedges(); i++) {
+                    vid_t nb = vertex.outedge(i)->vertex_id();
+                    if (follows(v, nb)) out.push_back(compact_id[nb]);
+                }
+                break;
             }
+            default:
+                break;
         }
-        vertex.set_data(vertexdata);
-        
-        if (propagate) {
-            for(int i=0; i < vertex.num_outedges(); i++) {
-                bidirectional_label edgedata = vertex.outedge(i)->get_data();
-                if (!edgedata.deleted()) {
-                    edgedata.my_label(vertex.id(), vertex.outedge(i)->vertexid) = vertexdata.color;
-                    vertex.outedge(i)->set_data(edgedata);
-                    gcontext.scheduler->add_task(vertex.outedge(i)->vertexid, true);
-                }
+    }
+
+    void schedule_live(graphchi_context &gcontext) {
+        for(size_t v=0; v < scc.size(); v++) {
+            if (live((vid_t) v)) gcontext.scheduler->add_task((vid_t) v);
+        }
+    }
+
+    bool fits_in_memory() {
+        size_t bytes = nlive * (3 * sizeof(vid_t) + sizeof(std::vector<vid_t>) + 2 * sizeof(size_t))
+                        + nlive_edges * sizeof(vid_t) + scc.size() * sizeof(vid_t);
+        return bytes <= inmem_maxbytes;
+    }
+
+    void start_round(graphchi_context &gcontext) {
+        round++;
+        phase = SCC_TRIM;
+        first_pass = true;
+        nlive_edges = 0;
+        schedule_live(gcontext);
+    }
+
+    void start_inmemory(graphchi_context &gcontext) {
+        phase = SCC_INMEMORY;
+        live_ids.clear();
+        compact_id.assign(scc.size(), UNASSIGNED);
+        for(size_t v=0; v < scc.size(); v++) {
+            if (live((vid_t) v)) {
+                compact_id[v] = (vid_t) live_ids.size();
+                live_ids.push_back((vid_t) v);
             }
         }
+        adj.assign(live_ids.size(), std::vector<vid_t>());
+        schedule_live(gcontext);
     }
-    
 
-    
-    void after_iteration(int iteration, graphchi_context &gcontext) {
-        first_iteration = false;
+    void start_output(graphchi_context &gcontext) {
+        phase = SCC_OUTPUT;
+        for(size_t v=0; v < scc.size(); v++) gcontext.scheduler->add_task((vid_t) v);
     }
-};
 
-/**
- * BACKWARD phase
- */
-struct SCCBackward : public GraphChiProgram<VertexDataType, EdgeDataType> {
-    
     /**
-     *  Vertex update function.
+     * Iterative Tarjan's algorithm on the in-memory live subgraph.
+     * Labels each SCC with its smallest vertex id.
      */
-    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
-        
-        if (vertex.get_data().confirmed) {
-            return;
-        }
-        
-        VertexDataType vertexdata = vertex.get_data();
-        bool propagate = false;
-        if (gcontext.iteration == 0) {
-            /* "Leader" of the SCC */
-            if (vertexdata.color == vertex.id()) {
-                propagate = true;
-                vertex.remove_alloutedges();
-            }
-            
-        } else {
-            
-            /* Loop over in-edges and see if there is a match */
-            bool match = false;
-            for(int i=0; i < vertex.num_outedges(); i++) {
-                if (!vertex.outedge(i)->get_data().deleted()) {
-                    if (vertex.outedge(i)->get_data().neighbor_label(vertex.id(), vertex.outedge(i)->vertexid) == vertexdata.color) {
-                        match = true;
-                        
-                        break;
+    void tarjan() {
+        size_t m = live_ids.size();
+        std::vector<size_t> index(m, 0), low(m, 0);   // index 0 = not visited
+        std::vector<bool> onstack(m, false);
+        std::vector<vid_t> stack;
+        std::vector<std::pair<vid_t, size_t> > callstack;
+        size_t counter = 1;
+
+        for(size_t s=0; s < m; s++) {
+            if (index[s] > 0) continue;
+            index[s] = low[s] = counter++;
+            stack.push_back((vid_t) s);
+            onstack[s] = true;
+            callstack.push_back(std::pair<vid_t, size_t>((vid_t) s, 0));
+
+            while (!callstack.empty()) {
+                vid_t u = callstack.back().first;
+                size_t &pos = callstack.back().second;
+                if (pos < adj[u].size()) {
+                    vid_t w = adj[u][pos++];
+                    if (index[w] == 0) {
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        onstack[w] = true;
+                        callstack.push_back(std::pair<vid_t, size_t>(w, 0));
+                    } else if (onstack[w]) {
+                        low[u] = std::min(low[u], index[w]);
                     }
+                    continue;
                 }
-            }
-            if (match) {
-                propagate = true;
-                vertex.remove_alloutedges();
-                vertex.set_data(SCCinfo(vertexdata.color, true));
-            } else {
-                vertex.set_data(SCCinfo(vertex.id(), false));
-            }
-        }
-        
-        
-        if (propagate) {
-            for(int i=0; i < vertex.num_inedges(); i++) {
-                bidirectional_label edgedata = vertex.inedge(i)->get_data();
-                if (!edgedata.deleted()) {
-                    edgedata.my_label(vertex.id(), vertex.inedge(i)->vertexid) = vertexdata.color;
-                    vertex.inedge(i)->set_data(edgedata);
-                    gcontext.scheduler->add_task(vertex.inedge(i)->vertexid, true);
+                callstack.pop_back();
+                if (!callstack.empty()) {
+                    vid_t parent = callstack.back().first;
+                    low[parent] = std::min(low[parent], low[u]);
+                }
+                if (low[u] == index[u]) {
+                    /* u is the root of an SCC: pop it */
+                    size_t top = stack.size();
+                    vid_t label = UNASSIGNED;
+                    do {
+                        top--;
+                        label = std::min(label, live_ids[stack[top]]);
+                    } while (stack[top] != u);
+                    for(size_t i=top; i < stack.size(); i++) {
+                        onstack[stack[i]] = false;
+                        scc[live_ids[stack[i]]] = label;
+                    }
+                    stack.resize(top);
                 }
             }
         }
+        nlive = 0;
+        std::vector<std::vector<vid_t> >().swap(adj);
+        std::vector<vid_t>().swap(compact_id);
+        std::vector<vid_t>().swap(live_ids);
     }
-    
-    void before_iteration(int iteration, graphchi_context &gcontext) {}
-    
-    void after_iteration(int iteration, graphchi_context &gcontext) {}
-    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) { }
-    
-    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {}
-};
-
-graphchi_engine<VertexDataType, EdgeDataType> * gengine = NULL;
 
-/* Simple contraction step that just outputs the non-deleted edges. Would be better
- done automatically, but the dynamic engine is a bit flaky. */
-struct ContractionStep : public GraphChiProgram<VertexDataType, EdgeDataType> {
-    
-    ContractionStep() {
+    /**
+     * Called before an iteration starts. Moves to the next phase
+     * when the previous one has converged.
+     */
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        size_t n = gcontext.nvertices;
+        if (iteration == 0) {
+            scc.assign(n, UNASSIGNED);
+            color.assign(n, 0);
+            partition.assign(n, 0);
+            nlive = n;
+            nchanged = 0;
+            round = 1;
+            phase = SCC_TRIM;   // All vertices are run on the first iteration anyway
+            first_pass = true;
+        } else {
+            size_t changed = nchanged;
+            bool converged = !pending;
+            nchanged = 0;
+            pending = false;
+            switch(phase) {
+                case SCC_TRIM:
+                    if (first_pass && fits_in_memory()) {
+                        first_pass = false;
+                        start_inmemory(gcontext);
+                        break;
+                    }
+                    first_pass = false;
+                    if (!converged && nlive > 0 && changed >= trim_fraction * nlive) break;  // Continue trimming
+                    if (nlive == 0) {
+                        start_output(gcontext);
+                        break;
+                    }
+                    phase = SCC_FORWARD;
+                    for(size_t v=0; v < n; v++) color[v] = (vid_t) v;
+                    schedule_live(gcontext);
+                    break;
+                case SCC_FORWARD:
+                    if (!converged) break;
+                    phase = SCC_BACKWARD;
+                    for(size_t v=0; v < n; v++) {
+                        if (live((vid_t) v) && color[v] == v) {
+                            scc[v] = (vid_t) v;   // Pivot
+                            nlive--;
+                        }
+                    }
+                    schedule_live(gcontext);
+                    break;
+                case SCC_BACKWARD:
+                    if (!converged) break;
+                    for(size_t v=0; v < n; v++) {
+                        if (live((vid_t) v)) partition[v] = color[v];
+                    }
+                    if (nlive == 0) {
+                        start_output(gcontext);
+                    } else {
+                        start_round(gcontext);
+                    }
+                    break;
+                case SCC_INMEMORY:
+                    tarjan();
+                    start_output(gcontext);
+                    break;
+                case SCC_OUTPUT:
+                    phase = SCC_DONE;
+                    return;   // No tasks, engine will stop
+                default:
+                    return;
+            }
+        }
+        passes[phase]++;
+        logstream(LOG_INFO) << "Round " << round << ", " << phase_names[phase] << ": "
+                            << nlive << " live vertices" << std::endl;
     }
-    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
-        
-        // Loop over only in-edges and output them. This way deleted edges won't be included.
-        for(int i=0; i < vertex.num_inedges(); i++) {
-            graphchi_edge<EdgeDataType> * e = vertex.inedge(i);
-            ((sharded_graph_output<VertexDataType, EdgeDataType> *)gengine->output(CONTRACTED_GRAPH_OUTPUT))->output_edgeval(e->vertex_id(), vertex.id(),
-                                                                     e->get_data());
+
+    void report() {
+        std::cout << "Rounds: " << round << ", passes:";
+        for(int p=0; p < SCC_DONE; p++) {
+            std::cout << " " << phase_names[p] << " " << passes[p];
         }
+        std::cout << std::endl;
     }
-    
+
+    void after_iteration(int iteration, graphchi_context &gcontext) {}
+    void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {}
+    void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &gcontext) {}
 };
 
 int main(int argc, const char ** argv) {
     /* GraphChi initialization will read the command line
      arguments and the configuration file. */
     graphchi_init(argc, argv);
-    global_logger().set_log_level(LOG_DEBUG);
-    
+
     /* Metrics object for keeping track of performance counters
      and other information. Currently required. */
     metrics m("strongly-connected-components");
-    
+
     /* Basic arguments for application */
     std::string filename = get_option_string("file");  // Base filename
-    bool scheduler       = true;
-    
+    double trim_fraction = get_option_float("trim_fraction", 0.001f);
+    double inmem_maxmem_mb = get_option_float("inmem_maxmem_mb", 512.0f);
+
     /* Detect the number of shards or preprocess an input to create them */
-    
-    int nshards = find_shards<EdgeDataType>(filename);
-    if (nshards > 0) {
-        delete_shards<EdgeDataType>(filename, nshards);
-    }
-    
-    nshards          = convert_if_notexists<EdgeDataType>(filename,
-                                                          get_option_string("nshards", "auto"));
-    
-    
-    
+    int nshards = convert_if_notexists_novalues<EdgeDataType>(filename,
+                                                              get_option_string("nshards", "auto"));
+
     /* Run */
-    while(remainingvertices) {
-        std::cout  << "STARTING SUPER STEP: " << super_step << std::endl;
-        super_step++;
-        remainingvertices = false;
-        
-        SCCForward forwardSCC;
-        graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
-        if (first_iteration) {
-            engine.set_reset_vertexdata(true);
-        }
-        engine.set_save_edgesfiles_after_inmemmode(true);
-        engine.run(forwardSCC, 1000);
-        
-        if (remainingvertices) {
-            std::cout  << "STARTING BACKWARD " << std::endl;
-            SCCBackward backwardSCC;
-            graphchi_engine<VertexDataType, EdgeDataType> engine2(filename, nshards, scheduler, m);
-            engine2.set_save_edgesfiles_after_inmemmode(true);
-            engine2.run(backwardSCC, 1000);
-            
-            int orig_numshards = (int) engine2.get_intervals().size();
-            
-            if (orig_numshards > 1) {
-                metrics_entry me = m.start_time();
-                // Contract deleted edges --- this is a bit hacky solution, as the dynamic engine would
-                // do it automatically. But currently one cannot call the dynamic engine repetitively.
-                graphchi_engine<VertexDataType, EdgeDataType> engine3(filename, nshards, false, m);
-                
-                std::string contractedname = filename + "C";
-                ContractionStep contraction;
-                sharded_graph_output<VertexDataType, EdgeDataType> shardedout(contractedname, NULL);
-                gengine = &engine3;
-                
-                CONTRACTED_GRAPH_OUTPUT = (int)engine3.add_output(&shardedout);
-                engine3.set_disable_vertexdata_storage();
-                engine3.set_modifies_inedges(false);
-                engine3.set_modifies_outedges(false);
-                engine3.set_disable_outedges(true);
-                engine3.run(contraction, 1);
-                
-                // Copy vertex file
-                std::string old_vertex_filename = filename_vertex_data<VertexDataType>(filename);
-                std::string new_vertex_filename = filename_vertex_data<VertexDataType>(contractedname);
-                
-                rename(old_vertex_filename.c_str(), new_vertex_filename.c_str());
-                
-                // Clean up
-                delete_shards<EdgeDataType>(filename, orig_numshards);
-                
-                nshards = (int)shardedout.finish_sharding();
-                filename = contractedname;
-                gengine = NULL;
-                
-                logstream(LOG_INFO) << "New filename: " << filename << ", edges:" << shardedout.num_edges() << std::endl;
-                m.stop_time(me, "runtime"); // include sharding in runtime
-                
-            }
-            
-        }
-    }
+    SCCProgram program(trim_fraction, (size_t) (inmem_maxmem_mb * 1024 * 1024));
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, true, m);
+    engine.set_only_adjacency(true);
+    engine.set_modifies_inedges(false);
+    engine.set_modifies_outedges(false);
+    /* Updates write only to their own entries of the in-memory state */
+    engine.set_enable_deterministic_parallelism(false);
+    engine.run(program, get_option_int("niters", 100000));
+
+    program.report();
     analyze_labels<VertexDataType>(filename);
-    
-    delete_shards<EdgeDataType>(filename, nshards);
-    
-    
+
     /* Report execution metrics */
     metrics_report(m);
     return 0;
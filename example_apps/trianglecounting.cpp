@@ -60,6 +60,7 @@
 #include "engine/dynamic_graphs/graphchi_dynamicgraph_engine.hpp"
 #include "engine/auxdata/degree_data.hpp"
 #include "preprocessing/util/orderbydegree.hpp"
+#include "util/intersection.hpp"
 
 using namespace graphchi;
 
@@ -90,54 +91,54 @@ class OutputVertexCallback : public VCallback<VertexDataType> {
   */
 int grabbed_edges = 0;
 
-
-// Linear search
-inline bool findadj_linear(vid_t * datachunk, size_t n, vid_t target) {
-    for(int i=0; i<(int)n; i++) {
-        if (datachunk[i] == target) return true;
-        else if (datachunk[i] > target) return false;
-    }
-    return false;
-}
-
-// Binary search
-inline bool findadj(vid_t * datachunk, size_t n, vid_t target) {
-    if (n<32) return findadj_linear(datachunk, n, target);
-    register size_t lo = 0;
-    register size_t hi = n;
-    register size_t m = lo + (hi-lo)/2;
-    while(hi>lo) {
-        vid_t eto = datachunk[m];
-        if (target == eto) {
-            return true;
-        }
-        if (target > eto) {
-            lo = m+1;
-        } else {
-            hi = m;
-        }
-        m = lo + (hi-lo)/2;
-    }
-    return false;
-}
-
+/* Pivots with at least this many relevant neighbors get a bitmap, if it is dense enough */
+int hub_bitmap_mincount = 1024;
 
 
 struct dense_adj {
     int count;
     vid_t * adjlist;
+    id_bitmap bitmap;  // Only for hub pivots
     
-    dense_adj() { adjlist = NULL; }
+    dense_adj() { adjlist = NULL; count = 0; }
     dense_adj(int _count, vid_t * _adjlist) : count(_count), adjlist(_adjlist) {
     }
 };
 
 
+/**
+  * Sorted, duplicate-free list of the neighbors of a vertex with larger
+  * id than the vertex, and for each the index of the (first) edge to it.
+  * Kept per thread so that it is allocated only once.
+  */
+struct neighbor_list {
+    std::vector<vid_t> ids;
+    std::vector<int> edgeidx;
+    std::vector<int> matches;
+    
+    void build(graphchi_vertex<uint32_t, uint32_t> &v) {
+        ids.clear();
+        edgeidx.clear();
+        int ncount = v.num_edges();
+        vid_t lastvid = 0;
+        for(int i=0; i < ncount; i++) {
+            vid_t nb = v.edge(i)->vertexid;
+            if (nb > v.id() && nb != lastvid) {
+                ids.push_back(nb);
+                edgeidx.push_back(i);
+            }
+            lastvid = nb;
+        }
+        if (matches.size() < ids.size()) matches.resize(ids.size());
+    }
+};
+
+std::vector<neighbor_list> thread_neighbor_lists;
+
 
 // This is used for keeping in-memory
 class adjlist_container {
     std::vector<dense_adj> adjs;
-    mutex m;
 public:
     vid_t pivot_st, pivot_en;
     
@@ -152,6 +153,7 @@ public:
                 free(it->adjlist);
                 it->adjlist = NULL;
             }
+            it->bitmap.release();
         }
         adjs.clear();
         pivot_st = pivot_en;
@@ -167,37 +169,23 @@ public:
     }
     
     /**
-      * Grab pivot's adjacency list into memory.
+      * Grab pivot's adjacency list into memory. Called from the (parallel)
+      * update function, so each pivot writes only its own slot.
       */
     int grab_adj(graphchi_vertex<uint32_t, uint32_t> &v) {
         if(is_pivot(v.id())) {            
-            int ncount = v.num_edges();
-            // Count how many neighbors have larger id than v
+            neighbor_list &nbrs = thread_neighbor_lists[omp_get_thread_num()];
             v.sort_edges_indirect();
-     
+            nbrs.build(v);  // Need to store only ids larger than me
             
-            int actcount = 0;
-            vid_t lastvid = 0;
-            for(int i=0; i<ncount; i++) {
-                if (v.edge(i)->vertexid > v.id() && v.edge(i)->vertexid != lastvid)  
-                    actcount++;  // Need to store only ids larger than me
-                lastvid = v.edge(i)->vertex_id();
+            int actcount = (int) nbrs.ids.size();
+            dense_adj dadj = dense_adj(actcount, (vid_t*) malloc(sizeof(vid_t) * std::max(1, actcount)));
+            if (actcount > 0) memcpy(dadj.adjlist, &nbrs.ids[0], sizeof(vid_t) * actcount);
+            if (id_bitmap::worthwhile(dadj.adjlist, actcount, hub_bitmap_mincount)) {
+                dadj.bitmap.build(dadj.adjlist, actcount);
             }
-            
-            // Allocate the in-memory adjacency list, using the
-            // knowledge of the number of edges.
-            dense_adj dadj = dense_adj(actcount, (vid_t*) calloc(sizeof(vid_t), actcount));
-            actcount = 0;
-            lastvid = 0;
-            for(int i=0; i<ncount; i++) {
-                if (v.edge(i)->vertexid > v.id() && v.edge(i)->vertexid != lastvid) {  // Need to store only ids larger than me
-                    dadj.adjlist[actcount++] = v.edge(i)->vertex_id();
-                }
-                lastvid = v.edge(i)->vertex_id();
-            }
-            assert(dadj.count == actcount);
-            adjs[v.id() - pivot_st] = dadj;
             assert(v.id() - pivot_st < adjs.size());
+            adjs[v.id() - pivot_st] = dadj;
             __sync_add_and_fetch(&grabbed_edges, actcount);
             return actcount;
         }
@@ -210,59 +198,27 @@ public:
     
     
     /** 
-      * Compute size of the relevant intersection of v and a pivot
+      * Compute size of the relevant intersection of v and a pivot. The pivot
+      * is the k'th entry of v's neighbor list, and the candidates are the
+      * neighbors after it. Increments the edges between v and the matches.
       */
-    int intersection_size(graphchi_vertex<uint32_t, uint32_t> &v, vid_t pivot, int start_i) {
+    int intersection_size(graphchi_vertex<uint32_t, uint32_t> &v, neighbor_list &nbrs, int k) {
+        vid_t pivot = nbrs.ids[k];
         assert(is_pivot(pivot));
-        int count = 0;
-        if (pivot > v.id()) {
-            dense_adj &dadj = adjs[pivot - pivot_st];
-            int vc = v.num_edges();
-             
-            /**
-              * If the adjacency list sizes are not too different, use
-              * 'merge'-type of operation to compute size intersection.
-              */
-            if (dadj.count < 32 * (vc - start_i)) { // TODO: do real profiling to find best cutoff value
-                // Do merge-style of check
-                assert(v.edge(start_i)->vertex_id() == pivot);
-                int i1 = 0;
-                int i2 = start_i+1;
-                int nedges = v.num_edges(); 
-                
-                while (i1 < dadj.count && i2 < nedges) {
-                    vid_t dst = v.edge(i2)->vertexid;
-                    vid_t a = dadj.adjlist[i1];
-                    if (a == dst) {
-                        /* Add one to edge between v and the match */
-                        v.edge(i2)->set_data(v.edge(i2)->get_data() + 1);
-                        count++;
-                        i1++; i2++;
-                        
-                    } else {
-                        i1 += a < dst;
-                        i2 += a > dst;
-                    }  
-                }
-            } else {
-                /**
-                  * Otherwise, use linear/binary search.
-                  */
-                vid_t lastvid = 0;
-                for(int i=start_i+1; i < vc; i++) {
-                    vid_t nb = v.edge(i)->vertexid;
-                    if (nb > pivot && nb != lastvid) {
-                        int match = findadj(dadj.adjlist, dadj.count, nb);
-                        count += match;
-                        if (match > 0) {
-                            /* Add one to edge between v and the match */
-                            v.edge(i)->set_data(v.edge(i)->get_data() + 1);
-                        }
-                    }
-                    lastvid = nb;
-                }
-            }
-        }        
+        if (pivot <= v.id()) return 0;
+        
+        dense_adj &dadj = adjs[pivot - pivot_st];
+        int ncand = (int) nbrs.ids.size() - k - 1;
+        if (ncand <= 0) return 0;
+        
+        int * matches = &nbrs.matches[0];
+        int count = intersect_adaptive(&nbrs.ids[k + 1], ncand, dadj.adjlist, dadj.count,
+                                       &dadj.bitmap, matches);
+        for(int j=0; j < count; j++) {
+            /* Add one to edge between v and the match */
+            graphchi_edge<uint32_t> * e = v.edge(nbrs.edgeidx[k + 1 + matches[j]]);
+            e->set_data(e->get_data() + 1);
+        }
         return count;
     }
     
@@ -294,38 +250,33 @@ struct TriangleCountingProgram : public GraphChiProgram<VertexDataType, EdgeData
             uint32_t newcounts = 0;
 
             v.sort_edges_indirect();
-            
-            vid_t lastvid = 0;
+            neighbor_list &nbrs = thread_neighbor_lists[omp_get_thread_num()];
+            nbrs.build(v);
             
             /**
-              * Iterate through the edges, and if an edge is from a 
+              * Iterate through the neighbors, and if a neighbor is a
               * pivot vertex, compute intersection of the relevant
-              * adjacency lists.
+              * adjacency lists. Reciprocal edges (a->b, b<-a) appear
+              * only once in the neighbor list.
               */
-            for(int i=0; i<v.num_edges(); i++) {
+            for(int k=0; k < (int)nbrs.ids.size(); k++) {
+                vid_t nb = nbrs.ids[k];
+                if (nb < adjcontainer->pivot_st) continue;
+                if (!adjcontainer->is_pivot(nb)) break;
+                
+                int i = nbrs.edgeidx[k];
                 graphchi_edge<uint32_t> * e = v.edge(i);
-                if (e->vertexid > v.id() && e->vertexid >= adjcontainer->pivot_st) {
-                    assert(!is_deleted_edge_value(e->get_data()));
-                    if (e->vertexid != lastvid) {  // Handles reciprocal edges (a->b, b<-a)
-                        if (adjcontainer->is_pivot(e->vertexid)) {
-                            uint32_t pivot_triangle_count = adjcontainer->intersection_size(v, e->vertexid, i);
-                            newcounts += pivot_triangle_count;
-                            
-                            /* Write the number of triangles into edge between this vertex and pivot */
-                            if (pivot_triangle_count == 0 && e->get_data() == 0) {
-                                /* ... or remove the edge, if the count is zero. */
-                                v.remove_edge(i); 
-                            } else {
-                                
-                                e->set_data(e->get_data() + pivot_triangle_count);
-                            }
-                        } else {
-                            break;
-                        }
-                    }
-                    lastvid = e->vertexid;
-                }  
-                assert(newcounts >= 0);
+                assert(!is_deleted_edge_value(e->get_data()));
+                uint32_t pivot_triangle_count = adjcontainer->intersection_size(v, nbrs, k);
+                newcounts += pivot_triangle_count;
+                
+                /* Write the number of triangles into edge between this vertex and pivot */
+                if (pivot_triangle_count == 0 && e->get_data() == 0) {
+                    /* ... or remove the edge, if the count is zero. */
+                    v.remove_edge(i); 
+                } else {
+                    e->set_data(e->get_data() + pivot_triangle_count);
+                }
             }
             
             if (newcounts > 0) {
@@ -455,6 +406,8 @@ int main(int argc, const char ** argv) {
     
     /* Initialize adjacency container */
     adjcontainer = new adjlist_container();
+    thread_neighbor_lists.resize(std::max(omp_get_max_threads(), get_option_int("execthreads", 1)));
+    hub_bitmap_mincount = get_option_int("hub_bitmap_mincount", 1024);
     
     // TODO: ordering by degree.
     
@@ -26,6 +26,13 @@
  * O(|V|) of RAM, but only one pass of the data. Thus much faster than
  * the completely disk based "connectedcomponents.cpp" example app.
  *
+ * The union-find is lock-free (see util/concurrent_union_find.hpp), so the
+ * in-edges are united directly by the parallel shard loader, using
+ * "loadthreads" threads (default: all cores). Each edge is seen exactly once.
+ * If the parent array does not fit in memory (option "unionfind_maxmem_mb",
+ * default half of the physical memory), falls back to disk-based label
+ * propagation.
+ *
  * Highly optimized non-idiomatic GraphChi code that uses an overloaded vertex
  * class to prevent actually creating the graph in memory.
  *
@@ -39,28 +46,16 @@
 #include <string>
 #include "graphchi_basic_includes.hpp"
 #include "util/labelanalysis.hpp"
+#include "util/concurrent_union_find.hpp"
 
 using namespace graphchi;
 
 
-vid_t *  sets;
-unsigned int * setCounts; // Union-find
-
-
-/* Find operator of Union-Find with path compression */
-vid_t Find(vid_t x);
-inline vid_t Find(vid_t x) {
-    while (sets[x] != x) {
-        x = sets[x] = sets[sets[x]];
-    }
-    return sets[x];
-}
+concurrent_union_find * uf = NULL;
 
 typedef vid_t VertexDataType;
 typedef bool EdgeDataType; // not relevant
 
-size_t ne = 0;
-
  class UnionFindVertex : public graphchi_vertex<VertexDataType, EdgeDataType> {
 public:
     
@@ -75,22 +70,9 @@ public:
     graphchi_vertex<VertexDataType, EdgeDataType> (_id, NULL, NULL, indeg, outdeg) { 
     }
     
+    /* Called concurrently by the shard loader threads */
     inline void add_inedge(vid_t src, EdgeDataType * ptr, bool special_edge) {
-        vid_t setDst = Find(this->vertexid);
-        vid_t setSrc = Find(src);
-        // If in same component, nothing to do, otherwise, Unite
-        if (setSrc != setDst) {
-            if (setCounts[setSrc] > setCounts[setDst]) {
-                // A is bigger set, merge with A
-                sets[setDst] = setSrc;
-                setCounts[setSrc] += setCounts[setDst];
-            } else {
-                // or vice versa
-                sets[setSrc] = setDst;
-                setCounts[setDst] += setCounts[setSrc];
-            }
-        }
-        ne++;
+        uf->unite(this->vertexid, src);
     }
     
        
@@ -127,12 +109,7 @@ struct UnionFindProgram : public GraphChiProgram<VertexDataType, EdgeDataType, U
      */
     void before_iteration(int iteration, graphchi_context &gcontext) {
         /* Initialize */
-        sets = new vid_t[gcontext.nvertices];
-        for(vid_t i=0; i<gcontext.nvertices; i++) sets[i] = i;
-        setCounts = new unsigned int[gcontext.nvertices];
-        // All sets start with 1
-        for(vid_t i=0; i<gcontext.nvertices; i++) setCounts[i] = 1;
-
+        uf = new concurrent_union_find(gcontext.nvertices);
     }
     
     /**
@@ -142,9 +119,7 @@ struct UnionFindProgram : public GraphChiProgram<VertexDataType, EdgeDataType, U
         
         // Now find everyone
         logstream(LOG_INFO) << "Final finds..." << std::endl;
-        for(size_t i=0; i<gcontext.nvertices; i++) {
-            sets[i] = Find(i);
-        }
+        uf->compress();
     }
     
     /**
@@ -161,6 +136,50 @@ struct UnionFindProgram : public GraphChiProgram<VertexDataType, EdgeDataType, U
     
 };
 
+/**
+ * Fallback: label propagation with the labels stored on the edges and
+ * vertex values on disk (see connectedcomponents.cpp). Needs no O(|V|) memory,
+ * but up to diameter-many passes.
+ */
+struct LabelPropagationProgram : public GraphChiProgram<vid_t, vid_t> {
+    
+    bool converged;
+    
+    void update(graphchi_vertex<vid_t, vid_t> &vertex, graphchi_context &gcontext) {
+        vid_t curmin = (gcontext.iteration == 0 ? vertex.id() : vertex.get_data());
+        for(int i=0; i < vertex.num_edges(); i++) {
+            vid_t nblabel = (gcontext.iteration == 0 ? vertex.edge(i)->vertex_id() : vertex.edge(i)->get_data());
+            curmin = std::min(nblabel, curmin);
+        }
+        vertex.set_data(curmin);
+        
+        /* On first iteration, write only to out-edges to avoid overwriting data */
+        if (gcontext.iteration == 0) {
+            for(int i=0; i < vertex.num_outedges(); i++) {
+                vertex.outedge(i)->set_data(curmin);
+            }
+        } else {
+            for(int i=0; i < vertex.num_edges(); i++) {
+                if (curmin < vertex.edge(i)->get_data()) {
+                    vertex.edge(i)->set_data(curmin);
+                    converged = false;
+                }
+            }
+        }
+    }
+    
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+        converged = iteration > 0;
+    }
+    
+    void after_iteration(int iteration, graphchi_context &gcontext) {
+        if (converged) {
+            logstream(LOG_INFO) << "Label propagation converged." << std::endl;
+            gcontext.set_last_iteration(iteration);
+        }
+    }
+};
+
 int main(int argc, const char ** argv) {
     /* GraphChi initialization will read the command line 
      arguments and the configuration file. */
@@ -178,25 +197,43 @@ int main(int argc, const char ** argv) {
     int nshards          = convert_if_notexists_novalues<EdgeDataType>(filename, 
                                                               get_option_string("nshards", "auto"));
     
-    // Always run with only thread only (code is not thread-safe)
-    set_conf("execthreads", "1");
+    /* Union-find runs in the (parallel) shard loader */
+    if (!is_cmdline_option("loadthreads")) {
+        std::stringstream ss;
+        ss << std::max(get_option_int("loadthreads", 2), omp_get_max_threads());
+        set_conf("loadthreads", ss.str());
+    }
+    
+    size_t maxmem = (size_t) get_option_long("unionfind_maxmem_mb", 0) * 1024 * 1024;
     
     /* Run */
     UnionFindProgram unionFind;
     graphchi_engine<VertexDataType, EdgeDataType, UnionFindVertex > engine(filename, nshards, false, m); 
-    engine.set_disable_outedges(true);
-    engine.set_only_adjacency(true);
-    engine.set_modifies_inedges(false);
-    engine.set_disable_vertexdata_storage();
-    engine.run(unionFind, niters);
-    
-    /* Write vertex data */
-    std::string outputfile = filename_vertex_data<VertexDataType>(filename);
-    
     
-    FILE * f = fopen(outputfile.c_str(), "w");
-    fwrite(sets, sizeof(vid_t), engine.num_vertices(), f);
-    fclose(f);
+    if (concurrent_union_find::fits_in_memory(engine.num_vertices(), maxmem)) {
+        engine.set_disable_outedges(true);
+        engine.set_only_adjacency(true);
+        engine.set_modifies_inedges(false);
+        engine.set_disable_vertexdata_storage();
+        engine.run(unionFind, niters);
+        
+        logstream(LOG_INFO) << "Number of components: " << uf->num_components() << std::endl;
+        
+        /* Write vertex data */
+        std::string outputfile = filename_vertex_data<VertexDataType>(filename);
+        
+        FILE * f = fopen(outputfile.c_str(), "w");
+        fwrite(uf->labels(), sizeof(vid_t), engine.num_vertices(), f);
+        fclose(f);
+        delete uf;
+    } else {
+        logstream(LOG_WARNING) << "Union-find parent array does not fit in memory, "
+                               << "falling back to label propagation." << std::endl;
+        int lp_nshards = convert_if_notexists<vid_t>(filename, get_option_string("nshards", "auto"));
+        LabelPropagationProgram lp;
+        graphchi_engine<vid_t, vid_t> lpengine(filename, lp_nshards, false, m);
+        lpengine.run(lp, get_option_int("niters", 1000));
+    }
     
     /* Analyze */
     analyze_labels<vid_t>(filename);
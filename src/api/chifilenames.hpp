@@ -74,6 +74,14 @@ namespace graphchi {
         return basefilename + "_degs.bin";
     }
     
+    /**
+     * Per-graph configuration, written by the autotuner. Read by the
+     * engine as defaults that override the global configuration file.
+     */
+    static std::string filename_graph_config(std::string basefilename) {
+        return basefilename + ".graphchi.cnf";
+    }
+
     static std::string filename_intervals(std::string basefilename, int nshards) {
         std::stringstream ss;
         ss << basefilename;
@@ -338,8 +338,32 @@ namespace graphchi {
                 memmove(&this->inedges_ptr[this->inc], this->outedges_ptr, this->outc * sizeof(graphchi_edge<EdgeDataType>));
                 this->outedges_ptr = &this->inedges_ptr[this->inc];
             }
-            quickSort(this->inedges_ptr, (int) (this->inc + this->outc), eptr_less<EdgeDataType>);
             
+            /* Edges are loaded as a concatenation of sorted runs (one for each
+               shard or index chunk), so merging the runs is much cheaper than
+               sorting from scratch. Fall back to sorting if there are many runs. */
+            graphchi_edge<EdgeDataType> * e = this->inedges_ptr;
+            int n = this->inc + this->outc;
+            std::vector<int> runs(1, 0);
+            for(int i=1; i < n; i++) {
+                if (e[i].vertexid < e[i - 1].vertexid) {
+                    runs.push_back(i);
+                    if (runs.size() > 64) {
+                        quickSort(this->inedges_ptr, n, eptr_less<EdgeDataType>);
+                        return;
+                    }
+                }
+            }
+            runs.push_back(n);
+            while (runs.size() > 2) {
+                std::vector<int> merged(1, 0);
+                for(int r=0; r + 2 < (int)runs.size(); r += 2) {
+                    std::inplace_merge(e + runs[r], e + runs[r + 1], e + runs[r + 2], eptr_less<EdgeDataType>);
+                    merged.push_back(runs[r + 2]);
+                }
+                if (runs.size() % 2 == 0) merged.push_back(n);
+                runs = merged;
+            }
         }
         
         
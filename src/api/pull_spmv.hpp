@@ -0,0 +1,205 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Pull-mode sparse matrix-vector iteration x <- apply(A^T scatter(x)), for
+ * PageRank-like computations. The value each vertex sends to its out-neighbors
+ * is kept in an array of floats, and an update sums the values of its
+ * in-neighbors, so the engine only loads adjacency: no edge data is read or
+ * written. The array is in memory, or memory mapped from a file next to the
+ * graph if it does not fit in half of the memory budget.
+ *
+ * The kernel is a template parameter (no virtual calls) with methods
+ *   float initial(vid_t v)                -- value on the first iteration,
+ *   float scatter(float x, int outdegree) -- value read by out-neighbors,
+ *   float apply(float sum)                -- new value from the sum of in-neighbors.
+ *
+ * In the Jacobi variant, iteration i reads the values of iteration i - 1 from a
+ * second array; in the Gauss-Seidel variant, there is one array and updates see
+ * the newest values. If tolerance is positive, the run stops when the sum of
+ * |x_new - x_old| of an iteration is below it. Values are written as vertex data.
+ */
+
+#ifndef DEF_GRAPHCHI_PULL_SPMV
+#define DEF_GRAPHCHI_PULL_SPMV
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <omp.h>
+
+#include "api/graphchi_program.hpp"
+#include "engine/graphchi_engine.hpp"
+#include "logger/logger.hpp"
+
+namespace graphchi {
+
+    /**
+     * Array of T, in memory or memory mapped from a (temporary) file.
+     */
+    template <typename T>
+    class spmv_array {
+        T * data;
+        size_t length;
+        std::string filename;
+        int filedesc;
+
+        // Not copyable
+        spmv_array(const spmv_array &);
+        spmv_array& operator=(const spmv_array &);
+
+    public:
+        spmv_array() : data(NULL), length(0), filedesc(-1) {}
+
+        ~spmv_array() {
+            if (filedesc >= 0) {
+                munmap(data, length * sizeof(T));
+                close(filedesc);
+                unlink(filename.c_str());
+            } else {
+                free(data);
+            }
+        }
+
+        /**
+         * Allocates n zeroed elements; memory mapped if mmapfile is not empty.
+         */
+        T * allocate(size_t n, std::string mmapfile = "") {
+            length = n;
+            if (mmapfile.empty()) {
+                data = (T *) calloc(n, sizeof(T));
+            } else {
+                filename = mmapfile;
+                /* Truncated first, so that a file left by an aborted run is not reused */
+                filedesc = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+                if (filedesc < 0 || ftruncate(filedesc, n * sizeof(T)) != 0) {
+                    logstream(LOG_FATAL) << "Could not create " << filename << ": " << strerror(errno) << std::endl;
+                }
+                data = (T *) mmap(NULL, n * sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED, filedesc, 0);
+                assert(data != MAP_FAILED);
+            }
+            assert(data != NULL);
+            return data;
+        }
+    };
+
+    template <class KERNEL, typename EdgeDataType>
+    struct pull_spmv_program : public GraphChiProgram<float, EdgeDataType> {
+
+        KERNEL kernel;
+        bool gauss_seidel;
+        double tolerance;
+        float * cur;       // Values read in this iteration
+        float * next;      // Values written in this iteration (== cur for Gauss-Seidel)
+        std::vector<double> residuals;   // Per execution thread, padded to separate cache lines
+        double residual;
+
+        pull_spmv_program(KERNEL kernel, float * cur, float * next, bool gauss_seidel, double tolerance) :
+            kernel(kernel), gauss_seidel(gauss_seidel), tolerance(tolerance), cur(cur), next(next), residual(0) {
+        }
+
+        void update(graphchi_vertex<float, EdgeDataType> &v, graphchi_context &ginfo) {
+            vid_t id = v.id();
+            float x;
+            if (ginfo.iteration == 0) {
+                x = kernel.initial(id);
+            } else {
+                float sum = 0.0f;
+                int n = v.num_inedges();
+                for(int i=0; i < n; i++) {
+                    sum += cur[v.inedge(i)->vertexid];
+                }
+                x = kernel.apply(sum);
+                residuals[omp_get_thread_num() * 8] += std::fabs(x - v.get_data());
+            }
+            /* The out-degree is known even though out-edges are not loaded */
+            next[id] = kernel.scatter(x, v.outc);
+            v.set_data(x);
+        }
+
+        void before_iteration(int iteration, graphchi_context &ginfo) {
+            residuals.assign(ginfo.execthreads * 8, 0.0);
+        }
+
+        void after_iteration(int iteration, graphchi_context &ginfo) {
+            if (iteration == 0) {
+                /* Both arrays start with the initial values */
+                if (next != cur) memcpy(cur, next, sizeof(float) * ginfo.nvertices);
+                return;
+            }
+            residual = 0;
+            for(size_t i=0; i < residuals.size(); i++) residual += residuals[i];
+            logstream(LOG_INFO) << "Iteration " << iteration << " residual: " << residual << std::endl;
+            std::swap(cur, next);
+            if (tolerance > 0 && residual < tolerance) {
+                logstream(LOG_INFO) << "Converged." << std::endl;
+                ginfo.set_last_iteration(iteration);
+            }
+        }
+
+        void before_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {
+        }
+
+        void after_exec_interval(vid_t window_st, vid_t window_en, graphchi_context &ginfo) {
+        }
+    };
+
+    /**
+     * Runs the kernel for at most niters iterations (the first one initializes
+     * the values). Returns the residual of the last iteration.
+     */
+    template <class KERNEL, typename EdgeDataType>
+    double run_pull_spmv(graphchi_engine<float, EdgeDataType> &engine, std::string basefilename, KERNEL kernel,
+                         int niters, bool gauss_seidel, double tolerance) {
+        size_t n = engine.num_vertices();
+        size_t bytes = n * sizeof(float) * (gauss_seidel ? 1 : 2);
+        bool use_mmap = bytes > (size_t) engine.get_membudget_mb() * 1024L * 1024L / 2;
+        if (use_mmap) {
+            logstream(LOG_INFO) << "Memory mapping the value arrays (" << (bytes / 1024 / 1024) << " MB)." << std::endl;
+        }
+        spmv_array<float> a, b;
+        float * cur = a.allocate(n, use_mmap ? basefilename + ".spmv.0" : "");
+        float * next = gauss_seidel ? cur : b.allocate(n, use_mmap ? basefilename + ".spmv.1" : "");
+
+        engine.set_only_adjacency(true);
+        engine.set_disable_outedges(true);
+        engine.set_modifies_inedges(false);
+        engine.set_modifies_outedges(false);
+        /* Jacobi iterations do not conflict, and Gauss-Seidel tolerates races */
+        engine.set_enable_deterministic_parallelism(false);
+
+        pull_spmv_program<KERNEL, EdgeDataType> program(kernel, cur, next, gauss_seidel, tolerance);
+        engine.run(program, niters);
+        return program.residual;
+    }
+
+}
+
+#endif
@@ -0,0 +1,390 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Configuration autotuner. Runs short calibration passes over a sample
+ * of the shards of a graph and measures the device bandwidth, the
+ * decompression throughput and the per-edge cost of constructing
+ * vertices. From these, recommends values for niothreads, loadthreads,
+ * execthreads, membudget_mb, cachesize_mb and blocksize, and writes
+ * them to the per-graph configuration file (see filename_graph_config()),
+ * which the engine of that graph reads as defaults.
+ *
+ * Enable by running any application with --autotune=1. The number of
+ * sampled shards is set with --autotune.samples (default 2).
+ */
+
+#ifndef DEF_GRAPHCHI_AUTOTUNER
+#define DEF_GRAPHCHI_AUTOTUNER
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <omp.h>
+#include <sys/time.h>
+
+#include "api/chifilenames.hpp"
+#include "api/graph_objects.hpp"
+#include "engine/auxdata/degree_data.hpp"
+#include "io/stripedio.hpp"
+#include "logger/logger.hpp"
+#include "metrics/metrics.hpp"
+#include "shards/memoryshard.hpp"
+#include "util/cmdopts.hpp"
+#include "util/ioutil.hpp"
+
+namespace graphchi {
+
+    struct autotune_result {
+        int niothreads;
+        int loadthreads;
+        int execthreads;
+        int membudget_mb;
+        int cachesize_mb;
+        size_t blocksize;
+        int recommended_nshards;
+
+        /* Measurements */
+        double device_mbps;      // Raw read bandwidth, MB/sec
+        double decode_mbps;      // Decompressed edge data, MB/sec (single thread)
+        double edge_cost_ns;     // Vertex construction cost per edge, nanosecs
+    };
+
+    template <typename EdgeDataType>
+    class graphchi_autotuner {
+
+        typedef graphchi_vertex<int, EdgeDataType> tvertex_t;
+
+        std::string base_filename;
+        int nshards;
+        std::vector<std::pair<vid_t, vid_t> > intervals;
+        std::vector<int> sample_shards;
+        metrics &m;
+
+        static double now() {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            return tv.tv_sec + tv.tv_usec * 1e-6;
+        }
+
+        /**
+         * Drops the file from the OS page cache, so that read timings
+         * measure the device and not memory.
+         */
+        static void drop_from_cache(std::string filename) {
+#ifdef POSIX_FADV_DONTNEED
+            int f = open(filename.c_str(), O_RDONLY);
+            if (f < 0) return;
+            posix_fadvise(f, 0, 0, POSIX_FADV_DONTNEED);
+            close(f);
+#endif
+        }
+
+        size_t default_blocksize() {
+            size_t bs = 1024 * 1024;
+            while (bs % sizeof(EdgeDataType) != 0) bs++;
+            return bs;
+        }
+
+        /**
+         * Returns the edge data block files of a shard for the given blocksize,
+         * or an empty list if the shard has not been split to such blocks.
+         */
+        std::vector<std::pair<std::string, size_t> > edata_blocks(int p, size_t blocksize) {
+            std::vector<std::pair<std::string, size_t> > blocks;
+            std::string edataname = filename_shard_edata<EdgeDataType>(base_filename, p, nshards);
+            if (!file_exists(filename_shard_edata_block(edataname, 0, blocksize))) return blocks;
+            size_t edatasize = get_shard_edata_filesize<EdgeDataType>(edataname);
+            for(int i=0; i * blocksize < edatasize; i++) {
+                std::string blockname = filename_shard_edata_block(edataname, i, blocksize);
+                if (!file_exists(blockname)) break;
+                blocks.push_back(std::pair<std::string, size_t>(blockname, std::min(blocksize, edatasize - i * blocksize)));
+            }
+            return blocks;
+        }
+
+        /**
+         * Reads the adjacency files of the sample shards with nthreads
+         * parallel readers in chunks of chunksize bytes. Returns MB/sec.
+         */
+        double measure_device_bandwidth(int nthreads, size_t chunksize, size_t maxbytes) {
+            size_t totbytes = 0;
+            double t = 0;
+            for(int i=0; i < (int)sample_shards.size(); i++) {
+                std::string adjname = filename_shard_adj(base_filename, sample_shards[i], nshards);
+                size_t len = std::min(get_filesize(adjname), maxbytes);
+                int nchunks = (int) (len / chunksize + (len % chunksize != 0));
+                drop_from_cache(adjname);
+
+                double st = now();
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+                for(int thr=0; thr < nthreads; thr++) {
+                    int f = open(adjname.c_str(), O_RDONLY);
+                    char * buf = (char *) malloc(chunksize);
+                    for(int c=thr; c < nchunks; c += nthreads) {
+                        size_t off = c * chunksize;
+                        preada(f, buf, std::min(chunksize, len - off), off);
+                    }
+                    free(buf);
+                    close(f);
+                }
+                t += now() - st;
+                totbytes += len;
+            }
+            return (t > 0 ? totbytes / t / 1024.0 / 1024.0 : 0.0);
+        }
+
+        /**
+         * Reads and decompresses the edge data blocks of the sample shards
+         * with nthreads threads. Files are in the page cache after the first
+         * call, so this measures the decoding throughput. Returns MB/sec of
+         * decompressed data.
+         */
+        double measure_decode_throughput(int nthreads, size_t blocksize, size_t maxbytes) {
+            std::vector<std::pair<std::string, size_t> > blocks;
+            size_t totbytes = 0;
+            for(int i=0; i < (int)sample_shards.size(); i++) {
+                std::vector<std::pair<std::string, size_t> > b = edata_blocks(sample_shards[i], blocksize);
+                for(int j=0; j < (int)b.size() && j * blocksize < maxbytes; j++) {
+                    blocks.push_back(b[j]);
+                    totbytes += b[j].second;
+                }
+            }
+            if (blocks.empty()) return 0.0;
+
+            double st = now();
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic, 1)
+            for(int i=0; i < (int)blocks.size(); i++) {
+                char * buf = (char *) malloc(blocks[i].second);
+                int f = open(blocks[i].first.c_str(), O_RDONLY);
+                read_compressed(f, buf, blocks[i].second);
+                close(f);
+                free(buf);
+            }
+            double t = now() - st;
+            return (t > 0 ? totbytes / t / 1024.0 / 1024.0 : 0.0);
+        }
+
+        /**
+         * Loads a window of a sample interval through a memory shard, the same
+         * way the engine does, and returns the cost per edge in nanoseconds.
+         */
+        double measure_edge_cost(size_t blocksize, size_t maxedges) {
+            stripedio iomgr(m);
+            degree_data degrees(base_filename, &iomgr);
+            int p = sample_shards[0];
+            vid_t st = intervals[p].first, en = intervals[p].second;
+            if (st > en) return 0.0;
+            degrees.load(st, en);
+
+            /* Limit the window to maxedges; the window is [st, wen) and nedges
+               counts exactly the edges of its vertices */
+            size_t nedges = 0;
+            vid_t wen = st;
+            for(; wen <= en; wen++) {
+                degree d = degrees.get_degree(wen);
+                if (nedges + d.indegree + d.outdegree > maxedges && wen > st) break;
+                nedges += d.indegree + d.outdegree;
+            }
+            int nvertices = wen - st;
+
+            memory_shard<int, EdgeDataType, tvertex_t> memshard(&iomgr,
+                                                                filename_shard_edata<EdgeDataType>(base_filename, p, nshards),
+                                                                filename_shard_adj(base_filename, p, nshards),
+                                                                st, en, blocksize, m);
+            memshard.load();
+
+            double t0 = now();
+            std::vector<tvertex_t> vertices(nvertices, tvertex_t());
+            graphchi_edge<EdgeDataType> * edata = (graphchi_edge<EdgeDataType> *)
+                malloc((nedges + 1) * sizeof(graphchi_edge<EdgeDataType>));
+            size_t ecounter = 0;
+            for(int i=0; i < nvertices; i++) {
+                degree d = degrees.get_degree(st + i);
+                vertices[i] = tvertex_t(st + i, &edata[ecounter], &edata[ecounter + d.indegree], d.indegree, d.outdegree);
+                vertices[i].scheduled = true;
+                ecounter += d.indegree + d.outdegree;
+            }
+            memshard.load_vertices(st, st + nvertices - 1, vertices, true, true);
+            iomgr.wait_for_reads();
+            double t = now() - t0;
+
+            memshard.commit(false, false);
+            free(edata);
+            return (ecounter > 0 ? t * 1e9 / ecounter : 0.0);
+        }
+
+        /**
+         * Memory needed to load each interval in one window, computed the
+         * same way as graphchi_engine::determine_next_window().
+         */
+        size_t max_interval_memreq(size_t &total_memreq) {
+            stripedio iomgr(m);
+            degree_data degrees(base_filename, &iomgr);
+            size_t maxreq = 0;
+            total_memreq = 0;
+            for(int p=0; p < nshards; p++) {
+                if (intervals[p].first > intervals[p].second) continue;
+                degrees.load(intervals[p].first, intervals[p].second);
+                size_t memreq = 0;
+                for(vid_t v=intervals[p].first; v <= intervals[p].second; v++) {
+                    degree d = degrees.get_degree(v);
+                    memreq += sizeof(tvertex_t) + (sizeof(EdgeDataType) + sizeof(vid_t) + sizeof(graphchi_edge<EdgeDataType>)) * (d.indegree + d.outdegree);
+                }
+                maxreq = std::max(maxreq, memreq);
+                total_memreq += memreq;
+            }
+            return maxreq;
+        }
+
+        size_t total_compressed_edata() {
+            size_t tot = 0;
+            for(int p=0; p < nshards; p++) {
+                std::vector<std::pair<std::string, size_t> > blocks = edata_blocks(p, default_blocksize());
+                for(int i=0; i < (int)blocks.size(); i++) tot += get_filesize(blocks[i].first);
+            }
+            return tot;
+        }
+
+        static size_t physical_memory() {
+            return (size_t) sysconf(_SC_PHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE);
+        }
+
+    public:
+
+        graphchi_autotuner(std::string base_filename, int nshards, metrics &_m) : base_filename(base_filename), nshards(nshards), m(_m) {
+            load_vertex_intervals(base_filename, nshards, intervals);
+            int nsamples = std::max(1, std::min(nshards, get_option_int("autotune.samples", 2)));
+            for(int i=0; i < nsamples; i++) {
+                sample_shards.push_back((int) ((long)i * nshards / nsamples));
+            }
+        }
+
+        autotune_result run() {
+            autotune_result res;
+            int ncores = omp_get_max_threads();
+            size_t maxbytes = get_option_long("autotune.maxbytes_mb", 256) * 1024L * 1024L;
+            logstream(LOG_INFO) << "Autotuner: calibrating on " << sample_shards.size() << " of " << nshards << " shards." << std::endl;
+
+            /* Blocksize: only consider sizes the shards have been split to (see blocksplitter) */
+            size_t candidate_bs[] = {256 * 1024, 512 * 1024, 1024 * 1024, 2 * 1024 * 1024, 4 * 1024 * 1024};
+            res.blocksize = default_blocksize();
+            double best_decode = 0;
+            for(int i=0; i < 5; i++) {
+                size_t bs = candidate_bs[i];
+                while (bs % sizeof(EdgeDataType) != 0) bs++;
+                if (edata_blocks(sample_shards[0], bs).empty()) continue;
+                measure_decode_throughput(1, bs, maxbytes);  // Warm up page cache
+                double mbps = measure_decode_throughput(1, bs, maxbytes);
+                logstream(LOG_INFO) << "Autotuner: blocksize " << bs << " decodes at " << mbps << " MB/s" << std::endl;
+                if (mbps > best_decode) {
+                    best_decode = mbps;
+                    res.blocksize = bs;
+                }
+            }
+            res.decode_mbps = best_decode;
+
+            /* Device bandwidth with different number of I/O threads */
+            res.niothreads = 1;
+            res.device_mbps = 0;
+            for(int nt=1; nt <= 4; nt *= 2) {
+                double mbps = measure_device_bandwidth(nt, res.blocksize, maxbytes);
+                logstream(LOG_INFO) << "Autotuner: niothreads=" << nt << " reads at " << mbps << " MB/s" << std::endl;
+                if (mbps > res.device_mbps * 1.1) {
+                    res.device_mbps = mbps;
+                    res.niothreads = nt;
+                }
+            }
+
+            /* Update cost: per-edge cost of building vertices in memory */
+            res.edge_cost_ns = measure_edge_cost(res.blocksize, maxbytes / sizeof(graphchi_edge<EdgeDataType>));
+            logstream(LOG_INFO) << "Autotuner: vertex construction costs " << res.edge_cost_ns << " ns/edge" << std::endl;
+
+            /* Load threads: enough to decode edge data as fast as the
+               execution threads consume it, but stop when scaling saturates. */
+            double consume_mbps = (res.edge_cost_ns > 0 ?
+                                   ncores * sizeof(EdgeDataType) * 1e3 / res.edge_cost_ns : 1e9);
+            res.loadthreads = 1;
+            double prev = best_decode;
+            for(int lt=2; lt <= ncores && prev < consume_mbps; lt *= 2) {
+                double mbps = measure_decode_throughput(lt, res.blocksize, maxbytes);
+                logstream(LOG_INFO) << "Autotuner: loadthreads=" << lt << " decodes at " << mbps << " MB/s" << std::endl;
+                if (mbps < prev * 1.2) break;
+                res.loadthreads = lt;
+                prev = mbps;
+            }
+            res.execthreads = ncores;
+
+            /* Memory: fit the largest interval in one window if possible,
+               and use the rest for caching edge data blocks. */
+            size_t physmem = physical_memory();
+            size_t total_memreq = 0;
+            size_t maxreq = max_interval_memreq(total_memreq);
+            size_t budget = std::min(maxreq + maxreq / 10, physmem / 2);
+            res.membudget_mb = (int) std::max((size_t)64, budget / 1024 / 1024);
+            size_t cachemax = physmem * 3 / 4 > (size_t)res.membudget_mb * 1024 * 1024 ?
+                physmem * 3 / 4 - (size_t)res.membudget_mb * 1024 * 1024 : 0;
+            res.cachesize_mb = (int) (std::min(cachemax, total_compressed_edata()) / 1024 / 1024);
+
+            /* Shards: such that each interval fits in the memory budget */
+            res.recommended_nshards = (int) (total_memreq / ((size_t)res.membudget_mb * 1024 * 1024) + 1);
+            if (maxreq <= budget) res.recommended_nshards = std::min(res.recommended_nshards, nshards);
+
+            m.set("autotune.device_mbps", res.device_mbps);
+            m.set("autotune.decode_mbps", res.decode_mbps);
+            m.set("autotune.edge_cost_ns", res.edge_cost_ns);
+            return res;
+        }
+
+        /**
+         * Writes the result to the per-graph configuration file.
+         */
+        void save(autotune_result &res) {
+            std::string fname = filename_graph_config(base_filename);
+            std::ofstream f(fname.c_str());
+            f << "# Written by the GraphChi autotuner. Command-line parameters" << std::endl;
+            f << "# override values in this file." << std::endl;
+            f << "# device bandwidth: " << res.device_mbps << " MB/s, decode: " << res.decode_mbps
+              << " MB/s, vertex construction: " << res.edge_cost_ns << " ns/edge" << std::endl;
+            f << "niothreads = " << res.niothreads << std::endl;
+            f << "loadthreads = " << res.loadthreads << std::endl;
+            f << "execthreads = " << res.execthreads << std::endl;
+            f << "membudget_mb = " << res.membudget_mb << std::endl;
+            f << "cachesize_mb = " << res.cachesize_mb << std::endl;
+            f << "blocksize = " << res.blocksize << std::endl;
+            if (res.recommended_nshards != nshards) {
+                f << "# Recommended: reshard with nshards = " << res.recommended_nshards << std::endl;
+            }
+            f.close();
+            logstream(LOG_INFO) << "Autotuner: wrote configuration to " << fname << std::endl;
+        }
+    };
+
+}
+
+#endif
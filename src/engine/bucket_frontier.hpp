@@ -0,0 +1,159 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Bucketed priority frontier: vertices are pushed to integer-priority
+ * buckets from the update functions, and between iterations the lowest
+ * non-empty bucket is popped and scheduled. Used by priority-driven
+ * algorithms such as delta-stepping SSSP.
+ *
+ * Buckets are split into lock-striped parts (by vertex id), so that
+ * concurrent pushes rarely contend. A vertex may be pushed many times;
+ * duplicates within a bucket are removed when it is popped, and entries
+ * that have become stale are for the caller to skip.
+ */
+
+#ifndef DEF_GRAPHCHI_BUCKET_FRONTIER
+#define DEF_GRAPHCHI_BUCKET_FRONTIER
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "graphchi_types.hpp"
+#include "api/ischeduler.hpp"
+#include "util/pthread_tools.hpp"
+
+namespace graphchi {
+
+    class bucket_frontier {
+        typedef std::map<size_t, std::vector<vid_t> > bucketmap_t;
+
+        int nstripes;
+        bucketmap_t * stripes;
+        spinlock * locks;
+
+        // Not copyable
+        bucket_frontier(const bucket_frontier &);
+        bucket_frontier& operator=(const bucket_frontier &);
+
+    public:
+        bucket_frontier(int nstripes = 64) : nstripes(nstripes) {
+            stripes = new bucketmap_t[nstripes];
+            locks = new spinlock[nstripes];
+        }
+
+        ~bucket_frontier() {
+            delete [] stripes;
+            delete [] locks;
+        }
+
+        /**
+         * Adds vertex to the bucket. Thread-safe.
+         */
+        void push(vid_t v, size_t bucket) {
+            int s = (int) (v % nstripes);
+            locks[s].lock();
+            stripes[s][bucket].push_back(v);
+            locks[s].unlock();
+        }
+
+        /**
+         * Removes all entries. Must not be called concurrently with push().
+         */
+        void clear() {
+            for(int s=0; s < nstripes; s++) stripes[s].clear();
+        }
+
+        bool empty() {
+            for(int s=0; s < nstripes; s++) {
+                if (!stripes[s].empty()) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Number of entries in all buckets, including duplicates.
+         */
+        size_t size() {
+            size_t n = 0;
+            for(int s=0; s < nstripes; s++) {
+                for(bucketmap_t::iterator it=stripes[s].begin(); it != stripes[s].end(); ++it) {
+                    n += it->second.size();
+                }
+            }
+            return n;
+        }
+
+        /**
+         * Removes the lowest non-empty bucket and writes its (sorted, unique)
+         * vertices to out. Returns the bucket index, or -1 if the frontier is empty.
+         * Must not be called concurrently with push().
+         */
+        long next_bucket(std::vector<vid_t> &out) {
+            return next_buckets(out, 1);
+        }
+
+        /**
+         * As above, but removes all buckets b with lowest <= b < lowest + window.
+         * Returns the lowest bucket index.
+         */
+        long next_buckets(std::vector<vid_t> &out, size_t window) {
+            out.clear();
+            long minbucket = -1;
+            for(int s=0; s < nstripes; s++) {
+                if (stripes[s].empty()) continue;
+                long b = (long) stripes[s].begin()->first;
+                if (minbucket < 0 || b < minbucket) minbucket = b;
+            }
+            if (minbucket < 0) return -1;
+            size_t maxbucket = (size_t) minbucket + window;
+            for(int s=0; s < nstripes; s++) {
+                bucketmap_t::iterator it = stripes[s].begin();
+                while (it != stripes[s].end() && it->first < maxbucket) {
+                    out.insert(out.end(), it->second.begin(), it->second.end());
+                    stripes[s].erase(it++);
+                }
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+            return minbucket;
+        }
+
+        /**
+         * Pops the lowest bucket and adds its vertices as tasks for the
+         * next iteration. Returns the bucket index, or -1 if empty.
+         */
+        long schedule_next_bucket(ischeduler * scheduler, std::vector<vid_t> &out) {
+            long b = next_bucket(out);
+            for(size_t i=0; i < out.size(); i++) {
+                scheduler->add_task(out[i]);
+            }
+            return b;
+        }
+    };
+
+}
+
+#endif
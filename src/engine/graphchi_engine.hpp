@@ -47,6 +47,7 @@
 #include "api/graphchi_program.hpp"
 #include "engine/auxdata/degree_data.hpp"
 #include "engine/auxdata/vertex_data.hpp"
+#include "engine/autotuner.hpp"
 #include "engine/bitset_scheduler.hpp"
 #include "io/stripedio.hpp"
 #include "logger/logger.hpp"
@@ -106,6 +107,7 @@ namespace graphchi {
         int membudget_mb;
         int load_threads;
         int exec_threads;
+        std::map<std::string, std::string> graphconf;  // Per-graph configuration, see load_graph_config()
         
         /* State */
         vid_t sub_interval_st;
@@ -146,10 +148,6 @@ namespace graphchi {
          * @param selective_scheduling if true, uses selective scheduling 
          */
         graphchi_engine(std::string _base_filename, int _nshards, bool _selective_scheduling, metrics &_m) : base_filename(_base_filename), nshards(_nshards), use_selective_scheduling(_selective_scheduling), m(_m) {
-            /* Initialize IO */
-            m.start_time("iomgr_init");
-            iomgr = new stripedio(m);
-            m.stop_time("iomgr_init");
 #ifndef DYNAMICEDATA
             logstream(LOG_INFO) << "Initializing graphchi_engine. This engine expects " << sizeof(EdgeDataType)
             << "-byte edge data. " << std::endl;
@@ -167,6 +165,24 @@ namespace graphchi {
                 }
             }
             
+            /* Calibrate and load per-graph configuration before any of the
+               configurable components are created. */
+            if (get_option_int("autotune", 0) == 1) {
+#ifndef DYNAMICEDATA
+                graphchi_autotuner<EdgeDataType> tuner(base_filename, nshards, m);
+                autotune_result tuned = tuner.run();
+                tuner.save(tuned);
+#else
+                logstream(LOG_WARNING) << "Autotuner does not support dynamic edge data." << std::endl;
+#endif
+            }
+            graphconf = load_graph_config(base_filename);
+            
+            /* Initialize IO */
+            m.start_time("iomgr_init");
+            iomgr = new stripedio(m, get_graph_option_int(graphconf, "niothreads", 1));
+            m.stop_time("iomgr_init");
+            
             /* Initialize a plenty of fields */
             memoryshard = NULL;
             modifies_outedges = true;
@@ -177,14 +193,22 @@ namespace graphchi {
             disable_outedges = false;
             reset_vertexdata = false;
             initialize_edges_before_run = false;
-            blocksize =  1024 * 1024;
+            blocksize = get_graph_option_long(graphconf, "blocksize", 1024 * 1024);
 #ifndef DYNAMICEDATA
             while (blocksize % sizeof(EdgeDataType) != 0) blocksize++;
+            if (blocksize != 1024 * 1024 && !block_files_exist(blocksize)) {
+                logstream(LOG_WARNING) << "Shards have not been split to blocks of " << blocksize
+                << " bytes (see blocksplitter). Using default blocksize." << std::endl;
+                blocksize = 1024 * 1024;
+                while (blocksize % sizeof(EdgeDataType) != 0) blocksize++;
+            }
+#else
+            blocksize = 1024 * 1024;
 #endif
             
             disable_vertexdata_storage = false;
 
-            membudget_mb = get_option_int("membudget_mb", 1024);
+            membudget_mb = get_graph_option_int(graphconf, "membudget_mb", 1024);
             nupdates = 0;
             iter = 0;
             work = 0;
@@ -194,8 +218,8 @@ namespace graphchi {
             degree_handler = NULL;
             vertex_data_handler = NULL;
             enable_deterministic_parallelism = true;
-            load_threads = get_option_int("loadthreads", 2);
-            exec_threads = get_option_int("execthreads", omp_get_max_threads());
+            load_threads = get_graph_option_int(graphconf, "loadthreads", 2);
+            exec_threads = get_graph_option_int(graphconf, "execthreads", omp_get_max_threads());
             maxwindow = 40000000;
 
             /* Load graph shard interval information */
@@ -255,6 +279,18 @@ namespace graphchi {
         }
         
         
+        /**
+         * Checks that the edge data of all shards has been split to
+         * blocks of the given size.
+         */
+        bool block_files_exist(size_t bs) {
+            for(int p=0; p < nshards; p++) {
+                std::string edata_filename = filename_shard_edata<EdgeDataType>(base_filename, p, nshards);
+                if (!file_exists(filename_shard_edata_block(edata_filename, 0, bs))) return false;
+            }
+            return true;
+        }
+        
         virtual void initialize_sliding_shards() {
             assert(sliding_shards.size() == 0);
             for(int p=0; p < nshards; p++) {
@@ -719,10 +755,10 @@ namespace graphchi {
             m.start_time("runtime");
             if (degree_handler == NULL)
                 degree_handler = create_degree_handler();
-            iomgr->set_cache_budget(get_option_long("cachesize_mb", 0) * 1024L * 1024L);
+            iomgr->set_cache_budget(get_graph_option_long(graphconf, "cachesize_mb", 0) * 1024L * 1024L);
 
-            m.set("cachesize_mb", get_option_int("cachesize_mb", 0));
-            m.set("membudget_mb", get_option_int("membudget_mb", 0));
+            m.set("cachesize_mb", get_graph_option_int(graphconf, "cachesize_mb", 0));
+            m.set("membudget_mb", get_graph_option_int(graphconf, "membudget_mb", 0));
 
             randomization = get_option_int("randomization", 0) == 1;
             
@@ -0,0 +1,225 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * In-memory store of random walks (after DrunkardMob, Kyrola 2013). Each walk
+ * is one 64-bit word: the index of its source (32 bits), its hop count
+ * (16 bits) and the offset of its current vertex within a bucket of 2^16
+ * consecutive vertex ids (16 bits). The walks are kept in per-bucket arrays,
+ * so no edge data is needed to carry them.
+ *
+ * Usage from a GraphChi program:
+ *  - before_exec_interval(): begin_interval(st, en) takes the walks of the
+ *    interval and groups them by vertex,
+ *  - update(): walks_at(v, n) returns the walks currently at the vertex,
+ *    and move_walk() puts them to their next vertex (thread-safe),
+ *  - after_exec_interval(): end_interval() returns the walks of vertices
+ *    that were not updated.
+ * Walks moved during an interval are picked up when the interval of their
+ * new vertex is loaded next, so they advance in bulk per interval.
+ */
+
+#ifndef DEF_GRAPHCHI_WALK_MANAGER
+#define DEF_GRAPHCHI_WALK_MANAGER
+
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+
+#include "graphchi_types.hpp"
+#include "api/ischeduler.hpp"
+#include "util/pthread_tools.hpp"
+
+namespace graphchi {
+
+    typedef uint64_t walk_t;
+
+#define WALK_BUCKET_BITS 16
+#define WALK_HOP_BITS 16
+
+    static inline walk_t encode_walk(uint32_t source, uint32_t hop, vid_t vertex) {
+        assert(hop < (1u << WALK_HOP_BITS));
+        return ((walk_t) source << 32) | ((walk_t) hop << WALK_BUCKET_BITS) |
+               (walk_t) (vertex & ((1u << WALK_BUCKET_BITS) - 1));
+    }
+
+    static inline uint32_t walk_source(walk_t w) {
+        return (uint32_t) (w >> 32);
+    }
+
+    static inline uint32_t walk_hop(walk_t w) {
+        return (uint32_t) (w >> WALK_BUCKET_BITS) & ((1u << WALK_HOP_BITS) - 1);
+    }
+
+    static inline uint32_t walk_offset(walk_t w) {
+        return (uint32_t) w & ((1u << WALK_BUCKET_BITS) - 1);
+    }
+
+    class walk_manager {
+        size_t nvertices;
+        size_t nbuckets;
+        std::vector<std::vector<walk_t> > buckets;
+        spinlock * locks;
+
+        /* Walks of the current interval, grouped by vertex */
+        vid_t interval_st, interval_en;
+        std::vector<walk_t> interval_walks;
+        std::vector<size_t> interval_index;
+        std::vector<char> taken;
+
+        size_t nactive;
+
+        // Not copyable
+        walk_manager(const walk_manager &);
+        walk_manager& operator=(const walk_manager &);
+
+        inline size_t bucket_of(vid_t v) {
+            return (size_t) (v >> WALK_BUCKET_BITS);
+        }
+
+        inline vid_t vertex_of(size_t bucket, walk_t w) {
+            return (vid_t) ((bucket << WALK_BUCKET_BITS) + walk_offset(w));
+        }
+
+    public:
+        walk_manager(size_t nvertices) : nvertices(nvertices), interval_st(0), interval_en(0), nactive(0) {
+            nbuckets = (nvertices >> WALK_BUCKET_BITS) + 1;
+            buckets.resize(nbuckets);
+            locks = new spinlock[nbuckets];
+        }
+
+        ~walk_manager() {
+            delete [] locks;
+        }
+
+        /**
+         * Adds a walk (new or moved) to its vertex. Thread-safe.
+         */
+        void move_walk(uint32_t source, uint32_t hop, vid_t vertex) {
+            assert(vertex < nvertices);
+            size_t b = bucket_of(vertex);
+            walk_t w = encode_walk(source, hop, vertex);
+            locks[b].lock();
+            buckets[b].push_back(w);
+            locks[b].unlock();
+        }
+
+        void start_walk(uint32_t source, vid_t vertex) {
+            move_walk(source, 0, vertex);
+            __sync_add_and_fetch(&nactive, 1);
+        }
+
+        /**
+         * Called when a walk ends (is not moved). Thread-safe.
+         */
+        void end_walk() {
+            __sync_sub_and_fetch(&nactive, 1);
+        }
+
+        size_t num_active() {
+            return nactive;
+        }
+
+        /**
+         * Takes the walks of vertices st..en from the buckets and groups them by vertex.
+         */
+        void begin_interval(vid_t st, vid_t en) {
+            if (en >= nvertices) en = (vid_t) (nvertices - 1);
+            interval_st = st;
+            interval_en = en;
+            size_t n = en - st + 1;
+            interval_index.assign(n + 1, 0);
+            taken.assign(n, 0);
+
+            /* Count */
+            for(size_t b = bucket_of(st); b <= bucket_of(en); b++) {
+                for(size_t i=0; i < buckets[b].size(); i++) {
+                    vid_t v = vertex_of(b, buckets[b][i]);
+                    if (v >= st && v <= en) interval_index[v - st + 1]++;
+                }
+            }
+            for(size_t i=0; i < n; i++) interval_index[i + 1] += interval_index[i];
+            interval_walks.resize(interval_index[n]);
+
+            /* Place; walks outside the interval stay in the (boundary) buckets */
+            std::vector<size_t> pos(interval_index.begin(), interval_index.end() - 1);
+            for(size_t b = bucket_of(st); b <= bucket_of(en); b++) {
+                std::vector<walk_t> &bucket = buckets[b];
+                size_t keep = 0;
+                for(size_t i=0; i < bucket.size(); i++) {
+                    vid_t v = vertex_of(b, bucket[i]);
+                    if (v >= st && v <= en) {
+                        interval_walks[pos[v - st]++] = bucket[i];
+                    } else {
+                        bucket[keep++] = bucket[i];
+                    }
+                }
+                bucket.resize(keep);
+                if (keep == 0) std::vector<walk_t>().swap(bucket);  // Release memory
+            }
+        }
+
+        /**
+         * Returns the walks at vertex v of the current interval, and marks them
+         * taken: the caller must move or end each of them.
+         */
+        walk_t * walks_at(vid_t v, size_t &count) {
+            assert(v >= interval_st && v <= interval_en);
+            size_t i = v - interval_st;
+            count = interval_index[i + 1] - interval_index[i];
+            taken[i] = 1;
+            return count == 0 ? NULL : &interval_walks[interval_index[i]];
+        }
+
+        bool has_walks(vid_t v) {
+            size_t i = v - interval_st;
+            return interval_index[i + 1] > interval_index[i];
+        }
+
+        /**
+         * Returns the walks of the vertices that were not updated (and schedules
+         * them for the next iteration), and releases the interval.
+         */
+        void end_interval(ischeduler * scheduler = NULL) {
+            size_t n = taken.size();
+            for(size_t i=0; i < n; i++) {
+                if (taken[i]) continue;
+                for(size_t j=interval_index[i]; j < interval_index[i + 1]; j++) {
+                    walk_t w = interval_walks[j];
+                    move_walk(walk_source(w), walk_hop(w), interval_st + (vid_t) i);
+                }
+                if (scheduler != NULL && interval_index[i + 1] > interval_index[i]) {
+                    scheduler->add_task(interval_st + (vid_t) i);
+                }
+            }
+            std::vector<walk_t>().swap(interval_walks);
+            std::vector<size_t>().swap(interval_index);
+            std::vector<char>().swap(taken);
+        }
+
+    };
+
+}
+
+#endif
@@ -250,7 +250,10 @@ namespace graphchi {
         std::map<std::string, mmap_info> mmaped;
         
     public:
-        stripedio( metrics &_m) : m(_m), cache(0) {
+        /**
+         * @param _niothreads number of I/O threads, by default option "niothreads"
+         */
+        stripedio( metrics &_m, int _niothreads = 0) : m(_m), cache(0) {
             stripesize = get_option_int("io.stripesize", 1024 * 1024 / 2);
 
             multiplex = get_option_int("multiplex", 1);
@@ -265,7 +268,7 @@ namespace graphchi {
             m.set("stripesize", (size_t)stripesize);
             
             // Start threads (niothreads is now threads per multiplex)
-            niothreads = get_option_int("niothreads", 1);
+            niothreads = (_niothreads > 0 ? _niothreads : get_option_int("niothreads", 1));
             m.set("niothreads", (size_t)niothreads);
        
             logstream(LOG_DEBUG) << "Start io-manager with " << niothreads << " threads." << std::endl;
@@ -0,0 +1,131 @@
+#!/bin/bash
+# Regression tests of the engine and the example applications on tiny inputs.
+# Build first with: make tests apps
+# Run from the GraphChi root directory: bash src/tests/runtests.sh
+export GRAPHCHI_ROOT=$PWD
+
+# all inputs, logs and metrics reports are written to a temporary directory
+testdir=`mktemp -d /tmp/graphchi_tests.XXXXXX`
+stdoutfname=$testdir/stdout.log
+cd $testdir
+
+echo | tee -a $stdoutfname
+echo "Running engine and application tests"| tee -a $stdoutfname
+echo "===================================="| tee -a $stdoutfname
+somefailed=0
+
+function check {
+  if [ $1 -eq 0 ]; then
+    echo "PASS $2"| tee -a $stdoutfname
+  else
+    somefailed=1
+    echo "FAIL $2"| tee -a $stdoutfname
+  fi
+}
+
+echo "---------AUTOTUNER-------------"  | tee -a $stdoutfname
+# ring of 6 vertices plus chords, so that every vertex of the sampled interval has edges
+cat > $testdir/ring6 <<EOF
+0 1
+1 2
+2 3
+3 4
+4 5
+5 0
+0 3
+1 4
+2 5
+EOF
+$GRAPHCHI_ROOT/bin/tests/basic_smoketest --file=$testdir/ring6 --filetype=edgelist --nshards=1 --niters=4 --autotune=1 >> $stdoutfname 2>& 1
+check $? "TEST 1 (smoketest with --autotune=1)"
+test -f $testdir/ring6.graphchi.cnf
+check $? "TEST 2 (autotuner writes the per-graph configuration)"
+# the per-graph configuration must not leak to the engines of other graphs
+cp $testdir/ring6 $testdir/ring6b
+printf "membudget_mb = 7\n" > $testdir/ring6b.graphchi.cnf
+cp $testdir/ring6 $testdir/ring6c
+$GRAPHCHI_ROOT/bin/tests/test_graph_config --file=$testdir/ring6b --file2=$testdir/ring6c --filetype=edgelist >> $stdoutfname 2>& 1
+check $? "TEST 3 (per-graph configuration applies to its own graph only)"
+
+echo "---------MSBFS CENTRALITY-------------"  | tee -a $stdoutfname
+# directed paths, the deepest BFS level is a sink; output is "vertex closeness harmonic betweenness"
+printf "0 1\n1 2\n" > $testdir/path3
+$GRAPHCHI_ROOT/bin/example_apps/msbfs_centrality --file=$testdir/path3 --filetype=edgelist --nshards=1 --sources=0 --betweenness=1 --output=$testdir/path3.out >> $stdoutfname 2>& 1 &&
+  awk '$1 == 1 && $4 != 3 { exit 1 }' $testdir/path3.out
+check $? "TEST 4 (msbfs_centrality betweenness, path of 3 vertices)"
+printf "0 1\n1 2\n2 3\n" > $testdir/path4
+$GRAPHCHI_ROOT/bin/example_apps/msbfs_centrality --file=$testdir/path4 --filetype=edgelist --nshards=1 --sources=0 --betweenness=1 --output=$testdir/path4.out >> $stdoutfname 2>& 1 &&
+  awk '($1 == 1 && $4 != 8) || ($1 == 2 && $4 != 4) || ($1 == 3 && $4 != 0) { exit 1 }' $testdir/path4.out
+check $? "TEST 5 (msbfs_centrality betweenness, path of 4 vertices)"
+
+echo "---------LOUVAIN-------------"  | tee -a $stdoutfname
+# two triangles joined by one edge, more execution threads than cores
+printf "0 1\n1 2\n2 0\n3 4\n4 5\n5 3\n2 3\n" > $testdir/triangles
+$GRAPHCHI_ROOT/bin/example_apps/louvain --file=$testdir/triangles --filetype=edgelist --nshards=1 --execthreads=8 > $testdir/louvain.log 2>& 1 &&
+  grep -q "Communities: 2," $testdir/louvain.log
+check $? "TEST 6 (louvain with --execthreads=8)"
+cat $testdir/louvain.log >> $stdoutfname
+
+echo "---------COMMUNITY DETECTION-------------"  | tee -a $stdoutfname
+$GRAPHCHI_ROOT/bin/example_apps/communitydetection --file=$testdir/triangles --filetype=edgelist --nshards=1 --execthreads=8 > $testdir/communitydetection.log 2>& 1 &&
+  grep -q "label: " $testdir/communitydetection.log
+check $? "TEST 7 (communitydetection with --execthreads=8)"
+cat $testdir/communitydetection.log >> $stdoutfname
+
+echo "---------PULL SPMV-------------"  | tee -a $stdoutfname
+$GRAPHCHI_ROOT/bin/example_apps/pagerank --file=$testdir/triangles --filetype=edgelist --nshards=1 --execthreads=8 --tolerance=0.001 > $testdir/pagerank.log 2>& 1 &&
+  grep -q "Converged" $testdir/pagerank.log
+check $? "TEST 8 (pull mode pagerank with --execthreads=8)"
+cat $testdir/pagerank.log >> $stdoutfname
+! $GRAPHCHI_ROOT/bin/example_apps/pagerank --file=$testdir/triangles --filetype=edgelist --nshards=1 --mode=push >> $stdoutfname 2>& 1
+check $? "TEST 9 (pagerank rejects an unknown --mode)"
+
+echo "---------HYPERANF-------------"  | tee -a $stdoutfname
+$GRAPHCHI_ROOT/bin/example_apps/hyperanf --file=$testdir/triangles --filetype=edgelist --nshards=1 --execthreads=8 > $testdir/hyperanf.log 2>& 1 &&
+  grep -q "effective diameter" $testdir/hyperanf.log
+check $? "TEST 10 (hyperanf with --execthreads=8)"
+cat $testdir/hyperanf.log >> $stdoutfname
+# memory mapped counters, with counter files left over from an aborted run
+head -c 768 /dev/zero | tr '\0' '\377' > $testdir/triangles.hll.0
+cp $testdir/triangles.hll.0 $testdir/triangles.hll.1
+$GRAPHCHI_ROOT/bin/example_apps/hyperanf --file=$testdir/triangles --filetype=edgelist --nshards=1 --membudget_mb=0 > $testdir/hyperanf_mmap.log 2>& 1 &&
+  diff <(grep "^N(\|effective" $testdir/hyperanf.log) <(grep "^N(\|effective" $testdir/hyperanf_mmap.log) >> $stdoutfname
+check $? "TEST 11 (hyperanf with memory mapped counters)"
+cat $testdir/hyperanf_mmap.log >> $stdoutfname
+
+echo "---------PERSONALIZED PAGERANK-------------"  | tee -a $stdoutfname
+# a batch stopped by --niters must not leak into the next one
+$GRAPHCHI_ROOT/bin/example_apps/personalizedpagerank --file=$testdir/triangles --filetype=edgelist --nshards=1 --sources=0,3 --batchsize=1 --niters=3 --output=$testdir/ppr_batched.out >> $stdoutfname 2>& 1 &&
+  $GRAPHCHI_ROOT/bin/example_apps/personalizedpagerank --file=$testdir/triangles --filetype=edgelist --nshards=1 --sources=3 --niters=3 --output=$testdir/ppr_single.out >> $stdoutfname 2>& 1 &&
+  awk '$1 == 1 { print $2, $3 }' $testdir/ppr_batched.out > $testdir/ppr_batched.top &&
+  awk '{ print $2, $3 }' $testdir/ppr_single.out | diff - $testdir/ppr_batched.top >> $stdoutfname
+check $? "TEST 12 (personalizedpagerank, batches are independent)"
+! $GRAPHCHI_ROOT/bin/example_apps/personalizedpagerank --file=$testdir/triangles --filetype=edgelist --nshards=1 --sources=0 --batchsize=0 >> $stdoutfname 2>& 1
+check $? "TEST 13 (personalizedpagerank rejects --batchsize=0)"
+
+echo "---------GRAPH SIMULATION-------------"  | tee -a $stdoutfname
+printf "v 0 0\nv 1 1\ne 0 1\n" > $testdir/pattern_ok
+$GRAPHCHI_ROOT/bin/example_apps/sim --file=$testdir/triangles --filetype=edgelist --nshards=1 --pattern=$testdir/pattern_ok >> $stdoutfname 2>& 1
+check $? "TEST 14 (sim with a pattern file)"
+printf "v 0 0\nv 40 1\ne 0 40\n" > $testdir/pattern_bigid
+! $GRAPHCHI_ROOT/bin/example_apps/sim --file=$testdir/triangles --filetype=edgelist --nshards=1 --pattern=$testdir/pattern_bigid >> $stdoutfname 2>& 1
+check $? "TEST 15 (sim rejects pattern vertex ids over SIM_MAX_PATTERN)"
+printf "v 0 0\nv 1 1\ne 0 5\n" > $testdir/pattern_baddst
+! $GRAPHCHI_ROOT/bin/example_apps/sim --file=$testdir/triangles --filetype=edgelist --nshards=1 --pattern=$testdir/pattern_baddst >> $stdoutfname 2>& 1
+check $? "TEST 16 (sim rejects pattern edges to undefined vertices)"
+
+echo "---------BFS-------------"  | tee -a $stdoutfname
+! $GRAPHCHI_ROOT/bin/example_apps/bfs --file=$testdir/triangles --filetype=edgelist --nshards=1 --sources=0,40 >> $stdoutfname 2>& 1
+check $? "TEST 17 (bfs rejects sources out of range)"
+
+echo "---------DELTA-STEPPING SSSP-------------"  | tee -a $stdoutfname
+printf "0 1 1.0\n1 2 -2.0\n" > $testdir/negweights
+! $GRAPHCHI_ROOT/bin/example_apps/sssp_deltastepping --file=$testdir/negweights --filetype=edgelist --nshards=1 --sources=0 >> $stdoutfname 2>& 1
+check $? "TEST 18 (sssp_deltastepping rejects negative edge weights)"
+
+cd $GRAPHCHI_ROOT
+if [ $somefailed == 1 ]; then
+  echo "Some of the tests failed, see $stdoutfname"
+  exit 1
+fi
+rm -fR $testdir
@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Checks that the per-graph configuration (see load_graph_config()) of one
+ * graph applies to the engine of that graph only. Graph "file" must have a
+ * configuration file with membudget_mb = 7, graph "file2" must have none.
+ */
+
+#include <string>
+
+#include "graphchi_basic_includes.hpp"
+
+using namespace graphchi;
+
+typedef int VertexDataType;
+typedef int EdgeDataType;
+
+int main(int argc, const char ** argv) {
+    graphchi_init(argc, argv);
+    metrics m("test-graph-config");
+
+    std::string filename = get_option_string("file");
+    std::string filename2 = get_option_string("file2");
+    int nshards = convert_if_notexists<EdgeDataType>(filename, "1");
+    int nshards2 = convert_if_notexists<EdgeDataType>(filename2, "1");
+    int expected2 = get_option_int("membudget_mb", 1024);
+
+    graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, false, m);
+    if (engine.get_membudget_mb() != 7) {
+        logstream(LOG_ERROR) << "Engine of " << filename << " has membudget_mb " << engine.get_membudget_mb()
+                             << ", expected 7 from its graph configuration." << std::endl;
+        return 1;
+    }
+
+    /* Created while the engine of the first graph still exists */
+    graphchi_engine<VertexDataType, EdgeDataType> engine2(filename2, nshards2, false, m);
+    if (engine2.get_membudget_mb() != expected2) {
+        logstream(LOG_ERROR) << "Engine of " << filename2 << " has membudget_mb " << engine2.get_membudget_mb()
+                             << ", expected " << expected2 << "." << std::endl;
+        return 1;
+    }
+
+    logstream(LOG_INFO) << "Graph configuration test passed." << std::endl;
+    return 0;
+}
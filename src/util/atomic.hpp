@@ -93,6 +93,31 @@ namespace graphchi {
                                             *reinterpret_cast<const uint32_t*>(&newval));
     };
     
+    /**
+     * Atomically sets a = min(a, b). Returns true if a was changed.
+     */
+    template<typename T>
+    bool atomic_min(T& a, const T &b) {
+        T old;
+        do {
+            old = a;
+            if (!(b < old)) return false;
+        } while (!atomic_compare_and_swap(a, old, b));
+        return true;
+    };
+    
+    /**
+     * Atomically adds b to a (also for float and double). Returns the old value of a.
+     */
+    template<typename T>
+    T atomic_add(T& a, const T &b) {
+        T old;
+        do {
+            old = a;
+        } while (!atomic_compare_and_swap(a, old, (T) (old + b)));
+        return old;
+    };
+    
     template<typename T>
     void atomic_exchange(T& a, T& b) {
         b =__sync_lock_test_and_set(&a, b);
@@ -147,7 +147,38 @@ namespace graphchi {
             std::cout << "       You need to call set_argc() in the beginning of the program." << std::endl;
         }
     }
-    
+
+    /**
+     * Returns true if the option was given on the command line, either
+     * as "option value" or as "--option=value".
+     */
+    static bool VARIABLE_IS_NOT_USED is_cmdline_option(const char *option_name) {
+        std::string prefix = std::string("--") + option_name + "=";
+        for (int i = 1; i < _argc; i++) {
+            if (i < _argc - 1 && strcmp(_argv[i], option_name) == 0) return true;
+            if (std::string(_argv[i]).substr(0, prefix.size()) == prefix) return true;
+        }
+        return false;
+    }
+
+    /**
+     * Loads the per-graph configuration file (written by the autotuner), if
+     * one exists. The values are returned instead of being merged to the global
+     * configuration, so that they only apply to the engine of that graph; read
+     * them with get_graph_option_int() and get_graph_option_long().
+     */
+    static std::map<std::string, std::string> VARIABLE_IS_NOT_USED load_graph_config(std::string basefilename) {
+        std::map<std::string, std::string> graphconf;
+        std::string fname = filename_graph_config(basefilename);
+        if (!file_exists(fname)) return graphconf;
+        graphconf = loadconfig(fname, fname);
+        std::map<std::string, std::string>::iterator it = graphconf.begin();
+        for(; it != graphconf.end(); ++it) {
+            logstream(LOG_INFO) << "Graph config " << fname << ": " << it->first << " = " << it->second << std::endl;
+        }
+        return graphconf;
+    }
+
     
 
     
@@ -248,6 +279,27 @@ namespace graphchi {
         return (float) get_config_option_double(option_name, default_value);
     }
     
+    /**
+     * Value of an option for one graph. Options given on the command line take
+     * precedence over the per-graph configuration (see load_graph_config()),
+     * which overrides the global configuration file.
+     */
+    static int VARIABLE_IS_NOT_USED get_graph_option_int(std::map<std::string, std::string> &graphconf,
+                                                         const char *option_name, int default_value)
+    {
+        if (!is_cmdline_option(option_name) && graphconf.find(option_name) != graphconf.end())
+            return atoi(graphconf[option_name].c_str());
+        return get_option_int(option_name, default_value);
+    }
+    
+    static uint64_t VARIABLE_IS_NOT_USED get_graph_option_long(std::map<std::string, std::string> &graphconf,
+                                                               const char *option_name, uint64_t default_value)
+    {
+        if (!is_cmdline_option(option_name) && graphconf.find(option_name) != graphconf.end())
+            return atol(graphconf[option_name].c_str());
+        return get_option_long(option_name, default_value);
+    }
+    
 } // End namespace
 
 
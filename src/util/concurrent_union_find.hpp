@@ -0,0 +1,133 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Lock-free concurrent union-find for connected components. Roots are
+ * always hooked under the smaller id with compare-and-swap (as in
+ * Shiloach-Vishkin), so parent[x] <= x holds at all times and the
+ * structure stays acyclic under concurrent unions. Finds do path halving,
+ * also with compare-and-swap. After compress(), the label of each vertex
+ * is the smallest vertex id of its component, same as with label propagation.
+ */
+
+#ifndef DEF_GRAPHCHI_CONCURRENT_UNION_FIND
+#define DEF_GRAPHCHI_CONCURRENT_UNION_FIND
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    class concurrent_union_find {
+        vid_t * parent;
+        size_t n;
+
+        // Not copyable
+        concurrent_union_find(const concurrent_union_find &);
+        concurrent_union_find& operator=(const concurrent_union_find &);
+
+    public:
+        concurrent_union_find(size_t n) : n(n) {
+            parent = (vid_t *) malloc(n * sizeof(vid_t));
+#pragma omp parallel for
+            for(long i=0; i < (long)n; i++) parent[i] = (vid_t) i;
+        }
+
+        ~concurrent_union_find() {
+            free(parent);
+        }
+
+        /**
+         * Returns true if the parent array for n vertices fits in
+         * the given amount of memory (0 = half of the physical memory).
+         */
+        static bool fits_in_memory(size_t n, size_t maxbytes = 0) {
+            if (maxbytes == 0) {
+                maxbytes = (size_t) sysconf(_SC_PHYS_PAGES) * (size_t) sysconf(_SC_PAGESIZE) / 2;
+            }
+            return n * sizeof(vid_t) <= maxbytes;
+        }
+
+        inline vid_t find(vid_t x) {
+            vid_t p = parent[x];
+            while (p != x) {
+                vid_t gp = parent[p];
+                if (gp != p) __sync_bool_compare_and_swap(&parent[x], p, gp);
+                x = gp;
+                p = parent[x];
+            }
+            return x;
+        }
+
+        /**
+         * Joins the sets of a and b. Returns true if they were different sets.
+         */
+        inline bool unite(vid_t a, vid_t b) {
+            /* Fast path: common case once most vertices hang directly under the root */
+            if (parent[a] == parent[b]) return false;
+            while (true) {
+                a = find(a);
+                b = find(b);
+                if (a == b) return false;
+                if (a < b) std::swap(a, b);
+                /* Hook the larger root under the smaller one */
+                if (__sync_bool_compare_and_swap(&parent[a], a, b)) return true;
+            }
+        }
+
+        /**
+         * Points every vertex directly to its root. Must not run
+         * concurrently with unite().
+         */
+        void compress() {
+#pragma omp parallel for
+            for(long i=0; i < (long)n; i++) {
+                parent[i] = find((vid_t) i);
+            }
+        }
+
+        size_t num_components() {
+            size_t c = 0;
+            for(size_t i=0; i < n; i++) c += (parent[i] == i);
+            return c;
+        }
+
+        /**
+         * Label array (valid after compress()).
+         */
+        vid_t * labels() {
+            return parent;
+        }
+
+        size_t size() {
+            return n;
+        }
+    };
+
+}
+
+#endif
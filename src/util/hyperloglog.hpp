@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * HyperLogLog counters (Flajolet et al.) stored as m = 2^b byte registers.
+ * A counter is a plain pointer to its m registers, so counters can be
+ * packed into one array (counter of item i at offset i * m). The union of
+ * two counters is the register-wise maximum (SSE2, with a scalar fallback).
+ */
+
+#ifndef DEF_GRAPHCHI_HYPERLOGLOG
+#define DEF_GRAPHCHI_HYPERLOGLOG
+
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphchi {
+
+    /**
+     * 64-bit mixing function (finalizer of MurmurHash3).
+     */
+    static inline uint64_t hll_hash(uint64_t x, uint64_t seed) {
+        x ^= seed + 0x9e3779b97f4a7c15ull;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /**
+     * Adds an item to a counter of 2^log2m registers.
+     */
+    static inline void hll_add(uint8_t * registers, int log2m, uint64_t item, uint64_t seed) {
+        uint64_t h = hll_hash(item, seed);
+        size_t j = h >> (64 - log2m);
+        uint64_t rest = h << log2m;
+        /* Position of the first one-bit of the remaining 64 - log2m bits */
+        uint8_t rho = rest == 0 ? (uint8_t) (64 - log2m + 1) : (uint8_t) (__builtin_clzll(rest) + 1);
+        if (rho > registers[j]) registers[j] = rho;
+    }
+
+    /**
+     * dst = max(dst, src) register-wise. Returns true if dst changed.
+     */
+    static inline bool hll_union(uint8_t * dst, const uint8_t * src, int m) {
+        int i = 0;
+        bool changed = false;
+#ifdef __SSE2__
+        for(; i + 16 <= m; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+            __m128i mx = _mm_max_epu8(d, s);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(mx, d)) != 0xffff) {
+                changed = true;
+                _mm_storeu_si128((__m128i *) (dst + i), mx);
+            }
+        }
+#endif
+        for(; i < m; i++) {
+            if (src[i] > dst[i]) {
+                dst[i] = src[i];
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    /**
+     * Estimated number of distinct items, with the small-range (linear
+     * counting) correction. The large-range correction is not needed with
+     * 64-bit hashes.
+     */
+    static inline double hll_estimate(const uint8_t * registers, int m) {
+        double alpha;
+        switch (m) {
+            case 16: alpha = 0.673; break;
+            case 32: alpha = 0.697; break;
+            case 64: alpha = 0.709; break;
+            default: alpha = 0.7213 / (1.0 + 1.079 / m);
+        }
+        double sum = 0;
+        int zeros = 0;
+        for(int j=0; j < m; j++) {
+            sum += ldexp(1.0, -registers[j]);
+            zeros += registers[j] == 0;
+        }
+        double e = alpha * m * m / sum;
+        if (e <= 2.5 * m && zeros > 0) {
+            e = m * log((double) m / zeros);
+        }
+        return e;
+    }
+
+}
+
+#endif
@@ -0,0 +1,225 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Intersection of sorted, duplicate-free lists of vertex ids. All kernels
+ * write the positions (in the first list) of the common elements to
+ * 'matches' and return the number of them. The adaptive version picks
+ * the kernel based on the ratio of the list sizes:
+ *  - bitmap probe, if the second list has a dense bitmap (hub vertices),
+ *  - galloping (exponential) search, if the lists are very different in size,
+ *  - otherwise block-wise SIMD merge (SSE2, with a scalar fallback).
+ */
+
+#ifndef DEF_GRAPHCHI_INTERSECTION
+#define DEF_GRAPHCHI_INTERSECTION
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    /**
+     * Dense bitmap of a sorted list, covering ids [first, last].
+     */
+    struct id_bitmap {
+        vid_t first;
+        vid_t last;
+        uint64_t * words;
+
+        id_bitmap() : first(0), last(0), words(NULL) {}
+
+        void build(const vid_t * list, int n) {
+            first = list[0];
+            last = list[n - 1];
+            size_t nwords = (last - first) / 64 + 1;
+            words = (uint64_t *) calloc(nwords, sizeof(uint64_t));
+            for(int i=0; i < n; i++) {
+                vid_t b = list[i] - first;
+                words[b >> 6] |= (uint64_t(1) << (b & 63));
+            }
+        }
+
+        void release() {
+            if (words != NULL) free(words);
+            words = NULL;
+        }
+
+        inline bool contains(vid_t x) const {
+            if (x < first || x > last) return false;
+            vid_t b = x - first;
+            return (words[b >> 6] >> (b & 63)) & 1;
+        }
+
+        /**
+         * Builds a bitmap only if it is not much larger than the list itself.
+         */
+        static bool worthwhile(const vid_t * list, int n, int mincount) {
+            if (n < mincount) return false;
+            size_t bitmapbytes = (list[n - 1] - list[0]) / 8 + 8;
+            return bitmapbytes <= 4 * n * sizeof(vid_t);
+        }
+    };
+
+    static inline int intersect_scalar_merge(const vid_t * a, int na, const vid_t * b, int nb, int * matches) {
+        int i = 0, j = 0, count = 0;
+        while (i < na && j < nb) {
+            vid_t x = a[i], y = b[j];
+            if (x == y) {
+                matches[count++] = i;
+                i++; j++;
+            } else {
+                i += x < y;
+                j += x > y;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Block-wise merge: compares four elements of each list at once
+     * (all 16 pairs), and advances the list whose block ends first.
+     */
+    static inline int intersect_simd_merge(const vid_t * a, int na, const vid_t * b, int nb, int * matches) {
+#ifdef __SSE2__
+        int i = 0, j = 0, count = 0;
+        int na4 = na & ~3, nb4 = nb & ~3;
+        /* Ids are unsigned, but SSE2 compares only signed; equality is all we need here */
+        while (i < na4 && j < nb4) {
+            __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *) (b + j));
+            __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                                                   _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+                                      _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                                                   _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(eq));
+            while (mask) {
+                int bit = __builtin_ctz(mask);
+                matches[count++] = i + bit;
+                mask &= mask - 1;
+            }
+            vid_t amax = a[i + 3], bmax = b[j + 3];
+            i += (amax <= bmax) * 4;
+            j += (bmax <= amax) * 4;
+        }
+        /* Finish the tails. Elements before i and j have been fully compared. */
+        int tailcount = intersect_scalar_merge(a + i, na - i, b + j, nb - j, matches + count);
+        for(int k=0; k < tailcount; k++) matches[count + k] += i;
+        return count + tailcount;
+#else
+        return intersect_scalar_merge(a, na, b, nb, matches);
+#endif
+    }
+
+    /**
+     * Returns the first position >= lo in the list whose value is not less than x,
+     * searching with exponentially growing steps and then binary search.
+     */
+    static inline int gallop_lower_bound(const vid_t * list, int n, int lo, vid_t x) {
+        int step = 1;
+        int hi = lo;
+        while (hi < n && list[hi] < x) {
+            lo = hi + 1;
+            hi = lo + step;
+            step <<= 1;
+        }
+        if (hi > n) hi = n;
+        while (lo < hi) {
+            int m = lo + (hi - lo) / 2;
+            if (list[m] < x) lo = m + 1;
+            else hi = m;
+        }
+        return lo;
+    }
+
+    /**
+     * For each element of the small list, gallops forward in the large
+     * list. Reports positions in the small list.
+     */
+    static inline int intersect_galloping(const vid_t * small, int ns, const vid_t * large, int nl, int * matches) {
+        int lo = 0, count = 0;
+        for(int i=0; i < ns && lo < nl; i++) {
+            lo = gallop_lower_bound(large, nl, lo, small[i]);
+            if (lo < nl && large[lo] == small[i]) {
+                matches[count++] = i;
+                lo++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * As above, but reports positions in the large list.
+     */
+    static inline int intersect_galloping_rev(const vid_t * large, int nl, const vid_t * small, int ns, int * matches) {
+        int lo = 0, count = 0;
+        for(int i=0; i < ns && lo < nl; i++) {
+            lo = gallop_lower_bound(large, nl, lo, small[i]);
+            if (lo < nl && large[lo] == small[i]) {
+                matches[count++] = lo;
+                lo++;
+            }
+        }
+        return count;
+    }
+
+    static inline int intersect_bitmap(const vid_t * a, int na, const id_bitmap &bm, int * matches) {
+        int count = 0;
+        for(int i=0; i < na; i++) {
+            if (bm.contains(a[i])) matches[count++] = i;
+        }
+        return count;
+    }
+
+    /**
+     * Adaptive intersection. Reports positions of the matches in list a.
+     * @param bm optional bitmap of list b (can be NULL)
+     */
+    static inline int intersect_adaptive(const vid_t * a, int na, const vid_t * b, int nb,
+                                         const id_bitmap * bm, int * matches) {
+        if (na == 0 || nb == 0) return 0;
+        if (a[na - 1] < b[0] || b[nb - 1] < a[0]) return 0;
+        const int ratio = 32;
+        if (bm != NULL && bm->words != NULL && na < nb) {
+            return intersect_bitmap(a, na, *bm, matches);
+        }
+        if (na * ratio < nb) {
+            return intersect_galloping(a, na, b, nb, matches);
+        }
+        if (nb * ratio < na) {
+            return intersect_galloping_rev(a, na, b, nb, matches);
+        }
+        return intersect_simd_merge(a, na, b, nb, matches);
+    }
+
+}
+
+#endif
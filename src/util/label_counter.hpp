@@ -0,0 +1,157 @@
+
+/**
+ * @file
+ * @author  Aapo Kyrola <akyrola@cs.cmu.edu>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Aapo Kyrola, Guy Blelloch, Carlos Guestrin / Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+
+ *
+ * @section DESCRIPTION
+ *
+ * Accumulates weights per label, for example the labels of the neighbors of
+ * a vertex. Small inputs are sorted and merged; large ones are counted in an
+ * open-addressing hash table, so the cost stays linear in the degree. The
+ * counter reuses its buffers, so keep one per thread rather than one per
+ * update.
+ */
+
+#ifndef DEF_GRAPHCHI_LABEL_COUNTER
+#define DEF_GRAPHCHI_LABEL_COUNTER
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "graphchi_types.hpp"
+
+namespace graphchi {
+
+    template <typename W>
+    class label_counter {
+    public:
+        typedef std::pair<vid_t, W> entry_t;
+
+    private:
+        static const vid_t EMPTY = 0xffffffffu;
+
+        size_t hash_threshold;
+        bool hashing;
+        std::vector<entry_t> entries;
+        std::vector<entry_t> table;
+        size_t mask;
+
+        static bool by_label(const entry_t &a, const entry_t &b) {
+            return a.first < b.first;
+        }
+
+        static inline size_t hash(vid_t x) {
+            return (size_t) (x * 2654435761u);
+        }
+
+    public:
+        label_counter(size_t hash_threshold = 512) : hash_threshold(hash_threshold), hashing(false), mask(0) {}
+
+        /**
+         * Starts a new count for at most expected additions.
+         */
+        void reset(size_t expected) {
+            entries.clear();
+            hashing = expected > hash_threshold;
+            if (hashing) {
+                size_t cap = 16;
+                while (cap < 2 * expected) cap *= 2;
+                if (table.size() < cap) table.assign(cap, entry_t(EMPTY, W()));
+                mask = cap - 1;
+            }
+        }
+
+        /**
+         * Adds weight w to label. The label must not be 0xffffffff.
+         */
+        inline void add(vid_t label, W w) {
+            if (!hashing) {
+                entries.push_back(entry_t(label, w));
+                return;
+            }
+            size_t i = hash(label) & mask;
+            while (table[i].first != EMPTY && table[i].first != label) i = (i + 1) & mask;
+            if (table[i].first == EMPTY) {
+                table[i] = entry_t(label, w);
+                entries.push_back(entry_t(label, W()));   // Remember the slot's label
+            } else {
+                table[i].second += w;
+            }
+        }
+
+        /**
+         * Returns the distinct labels with their total weights, sorted by
+         * label. Ends the count.
+         */
+        std::vector<entry_t> &result() {
+            if (hashing) {
+                for(size_t j=0; j < entries.size(); j++) {
+                    size_t i = hash(entries[j].first) & mask;
+                    while (table[i].first != entries[j].first) i = (i + 1) & mask;
+                    entries[j].second = table[i].second;
+                }
+                /* Clear only the used slots. The probes above do not stop at
+                   empty slots, so clearing in any order is safe. */
+                for(size_t j=0; j < entries.size(); j++) {
+                    size_t i = hash(entries[j].first) & mask;
+                    while (table[i].first != entries[j].first) i = (i + 1) & mask;
+                    table[i].first = EMPTY;
+                }
+                hashing = false;
+                std::sort(entries.begin(), entries.end(), by_label);
+                return entries;
+            }
+            std::sort(entries.begin(), entries.end(), by_label);
+            size_t k = 0;
+            for(size_t j=0; j < entries.size(); j++) {
+                if (k > 0 && entries[k - 1].first == entries[j].first) {
+                    entries[k - 1].second += entries[j].second;
+                } else {
+                    entries[k++] = entries[j];
+                }
+            }
+            entries.resize(k);
+            return entries;
+        }
+
+        /**
+         * Label with the largest weight; ties go to the larger label.
+         * Returns false if nothing was added. Ends the count.
+         */
+        bool most_frequent(vid_t &label, W &weight) {
+            std::vector<entry_t> &r = result();
+            if (r.empty()) return false;
+            label = r[0].first;
+            weight = r[0].second;
+            for(size_t j=1; j < r.size(); j++) {
+                if (r[j].second >= weight) {
+                    label = r[j].first;
+                    weight = r[j].second;
+                }
+            }
+            return true;
+        }
+    };
+
+}
+
+#endif
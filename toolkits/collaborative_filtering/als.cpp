@@ -54,14 +54,15 @@
 
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
+#include "factor_store.hpp"
+#include "normal_equations.hpp"
 
 double lambda = 0.065;
 
 struct vertex_data {
-  vec pvec;
+  vec_view pvec;
 
-  vertex_data() {
-    pvec = zeros(D);
+  vertex_data() : pvec(NULL, 0) {
   }
   void set_val(int index, float val){
     pvec[index] = val;
@@ -82,6 +83,7 @@ typedef float EdgeDataType;  // Edges store the "rating" of user->movie pair
 graphchi_engine<VertexDataType, EdgeDataType> * pengine = NULL; 
 graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine = NULL; 
 std::vector<vertex_data> latent_factors_inmem;
+factor_store latent_factors_store;
 
 #include "io.hpp"
 #include "rmse.hpp"
@@ -122,16 +124,15 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
    */
   void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
     vertex_data & vdata = latent_factors_inmem[vertex.id()];
-    mat XtX = mat::Zero(D, D); 
-    vec Xty = vec::Zero(D);
+    normal_equations & eq = thread_normal_equations();
+    eq.reset(vertex.num_edges());
 
     bool compute_rmse = (vertex.num_outedges() > 0);
     // Compute XtX and Xty (NOTE: unweighted)
     for(int e=0; e < vertex.num_edges(); e++) {
       float observation = vertex.edge(e)->get_data();                
       vertex_data & nbr_latent = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-      Xty += nbr_latent.pvec * observation;
-      XtX.triangularView<Eigen::Upper>() += nbr_latent.pvec * nbr_latent.pvec.transpose();
+      eq.add(nbr_latent.pvec, observation);
       if (compute_rmse) {
         double prediction;
         rmse_vec[omp_get_thread_num()] += als_predict(vdata, nbr_latent, observation, prediction);
@@ -141,11 +142,9 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
     double regularization = lambda;
     if (regnormal)
       regularization *= vertex.num_edges();
-    for(int i=0; i < D; i++) XtX(i,i) += regularization;
-
 
     // Solve the least squares problem with eigen using Cholesky decomposition
-    vdata.pvec = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xty);
+    eq.solve(regularization, vdata.pvec);
   }
 
 
@@ -193,11 +192,12 @@ int main(int argc, const char ** argv) {
   
   parse_command_line_args();
   parse_implicit_command_line();
+  init_normal_equations();
 
 
   /* Preprocess data if needed, or discover preprocess files */
   int nshards = convert_matrixmarket<EdgeDataType>(training, 0, 0, tokens_per_row, TRAINING, false);
-  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_inmem, !load_factors_from_file);
+  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_store, latent_factors_inmem, !load_factors_from_file);
   if (validation != ""){
     int vshards = convert_matrixmarket<EdgeDataType>(validation, 0, 0, tokens_per_row, VALIDATION, false);
     init_validation_rmse_engine<VertexDataType, EdgeDataType>(pvalidation_engine, vshards, &als_predict);
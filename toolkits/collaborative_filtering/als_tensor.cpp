@@ -32,6 +32,7 @@
 
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
+#include "normal_equations.hpp"
 
 double lambda = 0.065;
 
@@ -111,8 +112,8 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
    */
   void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
     vertex_data & vdata = latent_factors_inmem[vertex.id()];
-    mat XtX = mat::Zero(D, D); 
-    vec Xty = vec::Zero(D);
+    normal_equations & eq = thread_normal_equations();
+    eq.reset(vertex.num_edges());
 
     bool compute_rmse = is_user(vertex.id()); 
     // Compute XtX and Xty (NOTE: unweighted)
@@ -124,9 +125,7 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
       vertex_data & nbr_latent = latent_factors_inmem[vertex.edge(e)->vertex_id()];
       vertex_data & time_node = latent_factors_inmem[time];
       assert(time != vertex.id() && time != vertex.edge(e)->vertex_id());
-      vec XY = nbr_latent.pvec.cwiseProduct(time_node.pvec);
-      Xty += XY * observation;
-      XtX.triangularView<Eigen::Upper>() += XY * XY.transpose();
+      eq.add(nbr_latent.pvec.cwiseProduct(time_node.pvec), observation);
       if (compute_rmse) {
         double prediction;
         rmse_vec[omp_get_thread_num()] += als_tensor_predict(vdata, nbr_latent, observation, prediction, (void*)&time_node);
@@ -135,11 +134,9 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
     double regularization = lambda;
     if (regnormal)
       regularization *= vertex.num_edges();
-    for(int i=0; i < D; i++) 
-      XtX(i,i) += regularization;
 
     // Solve the least squares problem with eigen using Cholesky decomposition
-    vdata.pvec = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xty);
+    eq.solve(regularization, vdata.pvec);
   }
 
 
@@ -188,6 +185,7 @@ int main(int argc, const char ** argv) {
   lambda        = get_option_float("lambda", 0.065);
   parse_command_line_args();
   parse_implicit_command_line();
+  init_normal_equations();
 
   /* Preprocess data if needed, or discover preprocess files */
   int nshards = convert_matrixmarket4<edge_data>(training, true);
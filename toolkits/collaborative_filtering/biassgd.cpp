@@ -31,6 +31,7 @@
 
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
+#include "factor_store.hpp"
 
 double biassgd_lambda = 1e-3; //sgd step size
 double biassgd_gamma = 1e-3;  //sgd regularization
@@ -38,11 +39,10 @@ double biassgd_step_dec = 0.9; //sgd step decrement
 #define BIAS_POS -1
 
 struct vertex_data {
-  vec pvec; //storing the feature vector
+  vec_view pvec; //storing the feature vector
   double bias;
 
-  vertex_data() {
-    pvec = zeros(D);
+  vertex_data() : pvec(NULL, 0) {
     bias = 0;
   }
 
@@ -71,9 +71,11 @@ typedef float EdgeDataType;  // Edges store the "rating" of user->movie pair
 graphchi_engine<VertexDataType, EdgeDataType> * pengine = NULL; 
 graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine = NULL; 
 std::vector<vertex_data> latent_factors_inmem;
+factor_store latent_factors_store;
 #include "rmse.hpp"
 #include "rmse_engine.hpp"
 #include "io.hpp"
+#include "dsgd.hpp"
 
 /** compute a missing value based on bias-SGD algorithm */
 float bias_sgd_predict(const vertex_data& user, 
@@ -97,6 +99,25 @@ float bias_sgd_predict(const vertex_data& user,
 
 
 
+/** bias-SGD step on a single rating, returns the squared error */
+double bias_sgd_update(vertex_data & user, vertex_data & movie, float observation){
+  double estScore = 0;
+  double sqerr = bias_sgd_predict(user, movie, observation, estScore);
+  double err = observation - estScore;
+  if (std::isnan(err) || std::isinf(err))
+    logstream(LOG_FATAL)<<"BIASSGD got into numerical error. Please tune step size using --biassgd_gamma and biassgd_lambda" << std::endl;
+  user.bias += biassgd_gamma*(err - biassgd_lambda* user.bias);
+  movie.bias += biassgd_gamma*(err - biassgd_lambda* movie.bias); 
+  //NOTE: in the vertex-centric mode the following code is not thread safe, since potentially several
+  //user nodes may update this item gradient vector concurrently. However in practice it
+  //did not matter in terms of accuracy on a multicore machine.
+  //Use --dsgd=1 for conflict free parallel updates.
+  axpby(biassgd_gamma*err, user.pvec, 1 - biassgd_gamma*biassgd_lambda, movie.pvec);
+  axpby(biassgd_gamma*err, movie.pvec, 1 - biassgd_gamma*biassgd_lambda, user.pvec);
+  return sqerr;
+}
+
+
 /**
  * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type> 
  * class. The main logic is usually in the update function.
@@ -115,8 +136,8 @@ struct BIASSGDVerticesInMemProgram : public GraphChiProgram<VertexDataType, Edge
    * Called after an iteration has finished.
    */
   void after_iteration(int iteration, graphchi_context &gcontext) {
-    biassgd_gamma *= biassgd_step_dec;
     training_rmse(iteration, gcontext);
+    biassgd_gamma = next_step_size(iteration, biassgd_gamma, biassgd_step_dec);
     run_validation(pvalidation_engine, gcontext);
   }
 
@@ -129,23 +150,7 @@ struct BIASSGDVerticesInMemProgram : public GraphChiProgram<VertexDataType, Edge
       for(int e=0; e < vertex.num_edges(); e++) {
         float observation = vertex.edge(e)->get_data();                
         vertex_data & movie = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-        double estScore = 0;
-        rmse_vec[omp_get_thread_num()] += bias_sgd_predict(user, movie, observation, estScore);
-        double err = observation - estScore;
-        if (std::isnan(err) || std::isinf(err))
-          logstream(LOG_FATAL)<<"BIASSGD got into numerical error. Please tune step size using --biassgd_gamma and biassgd_lambda" << std::endl;
-        user.bias += biassgd_gamma*(err - biassgd_lambda* user.bias);
-        movie.bias += biassgd_gamma*(err - biassgd_lambda* movie.bias); 
-        //NOTE: the following code is not thread safe, since potentially several
-        //user nodes may update this item gradient vector concurrently. However in practice it
-        //did not matter in terms of accuracy on a multicore machine.
-        //if you like to defend the code, you can define a global variable
-        //mutex mymutex;
-        //
-        //and then do: mymutex.lock()
-        movie.pvec += biassgd_gamma*(err*user.pvec - biassgd_lambda*movie.pvec);
-        //here add: mymutex.unlock();
-        user.pvec += biassgd_gamma*(err*movie.pvec - biassgd_lambda*user.pvec);
+        rmse_vec[omp_get_thread_num()] += bias_sgd_update(user, movie, observation);
       }
     }
 
@@ -186,11 +191,12 @@ int main(int argc, const char ** argv) {
 
   parse_command_line_args();
   parse_implicit_command_line();
+  parse_step_schedule(biassgd_gamma);
 
 
   /* Preprocess data if needed, or discover preprocess files */
   int nshards = convert_matrixmarket<EdgeDataType>(training, 0, 0, 3, TRAINING, false);
-  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_inmem, !load_factors_from_file);
+  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_store, latent_factors_inmem, !load_factors_from_file);
   if (validation != ""){
     int vshards = convert_matrixmarket<EdgeDataType>(validation, 0, 0, 3, VALIDATION, false);
     init_validation_rmse_engine<VertexDataType, EdgeDataType>(pvalidation_engine, vshards, &bias_sgd_predict);
@@ -212,7 +218,9 @@ int main(int argc, const char ** argv) {
   graphchi_engine<VertexDataType, EdgeDataType> engine(training, nshards, false, m); 
   set_engine_flags(engine);
   pengine = &engine;
-  engine.run(program, niters);
+  if (get_option_int("dsgd", 0))
+    run_dsgd(engine, program, &bias_sgd_update, niters);
+  else engine.run(program, niters);
 
   /* Output latent factor matrices in matrix-market format */
   output_biassgd_result(training);
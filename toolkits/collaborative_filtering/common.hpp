@@ -30,6 +30,7 @@
 #include <string>
 
 #include "util.hpp"
+#include "fixed_kernels.hpp"
 #include "graphchi_basic_includes.hpp"
 #include "api/vertex_aggregator.hpp"
 #include "preprocessing/sharder.hpp"
@@ -70,6 +71,7 @@ int regnormal = 0; // if set to 1, compute LS regularization according to the pa
 int clean_cache = 0;
 int R_output_format = 0; // if set to 1, all matrices and vectors are written in sparse matrix market format since
                          // R does not currently support array format (dense format).
+int binary_factors = 0; // if set to 1, factor matrices and vectors are written and read in binary format (see factor_file.hpp)
 int tokens_per_row = 3; //number of columns per input row
 int allow_zeros;
 int start_user=0; //start offset of user 
@@ -189,9 +191,14 @@ void parse_command_line_args(){
     remove_cached_files();
 
   R_output_format = get_option_int("R_output_format", R_output_format);
+  binary_factors = get_option_int("binary_factors", binary_factors);
   start_user = get_option_int("start_user", start_user);
   end_user   = get_option_int("end_user",   end_user);
   exact_training_rmse = get_option_int("exact_training_rmse", 0);
+  //--fixed_kernels=0 forces the dynamically sized code for every D (see fixed_kernels.hpp)
+  if (get_option_int("fixed_kernels", 1) && init_fixed_kernels(D))
+    logstream(LOG_INFO)<<"Using compiled in kernels for feature width " << D << std::endl;
+  else init_fixed_kernels(0);
 }
 
 template<typename T>
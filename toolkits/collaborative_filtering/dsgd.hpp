@@ -0,0 +1,229 @@
+#ifndef _DSGD_HPP__
+#define _DSGD_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Stratified (distributed) SGD, see: R. Gemulla, E. Nijkamp, P. J. Haas and Y. Sismanis.
+ * Large-Scale Matrix Factorization with Distributed Stochastic Gradient Descent. KDD 2011.
+ *
+ * With --dsgd=1 the ratings are read once from the shards into memory and split into
+ * P x P blocks of user range x item range (--dsgd_blocks, default the number of threads).
+ * The ranges are cut so that each holds about the same number of ratings. An epoch consists
+ * of P sub-epochs in random order; sub-epoch s processes the blocks (p, p+s mod P) in parallel.
+ * These blocks share no user and no item, so the updates need no locks and do not race.
+ * Inside a block the ratings are sorted by user and then item, so the user factors stay in
+ * cache and the item factors come from a range of about N/P items.
+ *
+ * Must be included after rmse_engine.hpp, since the training RMSE and the validation
+ * are reported with the same functions as in the vertex-centric mode.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+#include "common.hpp"
+
+/**
+ * Step size schedules, selected with --step_schedule. They are applied after each
+ * iteration, after the training RMSE has been computed.
+ * 0) multiply the step size by step_dec (default)
+ * 1) bold driver: increase the step size by 5% if the training RMSE decreased, otherwise halve it
+ * 2) gamma_0 / sqrt(iteration + 2)
+ * An application can also set step_size_hook to compute the step size itself.
+ */
+enum STEP_SCHEDULES{
+  STEP_DECREMENT = 0,
+  STEP_BOLD_DRIVER = 1,
+  STEP_INV_SQRT = 2
+};
+
+int step_schedule = STEP_DECREMENT;
+double initial_step_size = 0;
+double (*step_size_hook)(int iteration, double step_size) = NULL;
+
+void parse_step_schedule(double step_size){
+  step_schedule = get_option_int("step_schedule", step_schedule);
+  if (step_schedule < STEP_DECREMENT || step_schedule > STEP_INV_SQRT)
+    logstream(LOG_FATAL)<<"--step_schedule=XX should be one of: 0=decrement, 1=bold driver, 2=inverse square root" << std::endl;
+  initial_step_size = step_size;
+}
+
+double next_step_size(int iteration, double step_size, double step_dec){
+  if (step_size_hook != NULL)
+    return (*step_size_hook)(iteration, step_size);
+  switch(step_schedule){
+    case STEP_BOLD_DRIVER:
+      if (iteration == 0)
+        return step_size;
+      return dtraining_rmse < last_training_rmse ? step_size * 1.05 : step_size * 0.5;
+    case STEP_INV_SQRT:
+      return initial_step_size / sqrt(iteration + 2.0);
+    default:
+      return step_size * step_dec;
+  }
+}
+
+struct dsgd_rating{
+  uint user;
+  uint item;
+  float rating;
+  dsgd_rating(){}
+  dsgd_rating(uint user, uint item, float rating) : user(user), item(item), rating(rating) { }
+  bool operator<(const dsgd_rating & o) const {
+    return user < o.user || (user == o.user && item < o.item);
+  }
+};
+
+/**
+ * Number of per-thread slots: the engine runs the updates with --execthreads threads,
+ * which may exceed the number of cores.
+ */
+inline int dsgd_threads(){
+  int threads = std::max(number_of_omp_threads(), omp_get_max_threads());
+  return std::max(threads, (int)get_option_int("execthreads", threads));
+}
+
+class dsgd_strata {
+  int P;
+  std::vector<std::vector<dsgd_rating> > thread_ratings;
+  std::vector<std::vector<dsgd_rating> > blocks; // block (p,q) at p * P + q
+
+  /* cut the nodes into P consecutive ranges holding about total/P ratings each */
+  static void cut_ranges(const std::vector<size_t> & counts, size_t total, int P, std::vector<int> & block_of){
+    block_of.resize(counts.size());
+    size_t seen = 0;
+    for (uint i=0; i< counts.size(); i++){
+      block_of[i] = std::min(P - 1, (int)((double)seen * P / std::max(total, (size_t)1)));
+      seen += counts[i];
+    }
+  }
+
+  public:
+  dsgd_strata() : P(0) { }
+
+  void init(int nblocks){
+    P = nblocks;
+    thread_ratings.clear();
+    thread_ratings.resize(dsgd_threads());
+  }
+
+  inline void add(uint user, uint item, float rating){
+    thread_ratings[omp_get_thread_num()].push_back(dsgd_rating(user, item, rating));
+  }
+
+  /**
+   * Split the collected ratings into blocks.
+   */
+  void finalize(){
+    std::vector<size_t> user_count(M, 0), item_count(N, 0);
+    size_t total = 0;
+    for (uint t=0; t< thread_ratings.size(); t++){
+      for (uint j=0; j< thread_ratings[t].size(); j++){
+        user_count[thread_ratings[t][j].user]++;
+        item_count[thread_ratings[t][j].item - M]++;
+      }
+      total += thread_ratings[t].size();
+    }
+    std::vector<int> user_block, item_block;
+    cut_ranges(user_count, total, P, user_block);
+    cut_ranges(item_count, total, P, item_block);
+
+    blocks.clear();
+    blocks.resize(P * P);
+    for (uint t=0; t< thread_ratings.size(); t++){
+      for (uint j=0; j< thread_ratings[t].size(); j++){
+        const dsgd_rating & r = thread_ratings[t][j];
+        blocks[user_block[r.user] * P + item_block[r.item - M]].push_back(r);
+      }
+      std::vector<dsgd_rating>().swap(thread_ratings[t]);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int b=0; b< P*P; b++)
+      std::sort(blocks[b].begin(), blocks[b].end());
+    logstream(LOG_INFO)<<"DSGD: " << total << " ratings in " << P << "x" << P << " blocks" << std::endl;
+  }
+
+  /**
+   * One pass over all ratings. rating_update(user, item, rating) updates the factors of the
+   * pair and returns its training error, which is added to rmse_vec.
+   */
+  template<typename F>
+  void epoch(F rating_update){
+    std::vector<int> order(P);
+    for (int s=0; s< P; s++)
+      order[s] = s;
+    for (int s=P-1; s> 0; s--)
+      std::swap(order[s], order[lrand48() % (s+1)]);
+
+    for (int k=0; k< P; k++){
+      int s = order[k];
+#pragma omp parallel for schedule(dynamic)
+      for (int p=0; p< P; p++){
+        const std::vector<dsgd_rating> & block = blocks[p * P + (p + s) % P];
+        double err = 0;
+        for (uint j=0; j< block.size(); j++)
+          err += rating_update(latent_factors_inmem[block[j].user], latent_factors_inmem[block[j].item], block[j].rating);
+        rmse_vec[omp_get_thread_num()] += err;
+      }
+    }
+  }
+};
+
+dsgd_strata dsgd_blocks;
+
+/**
+ * Reads the ratings (out edges of the user nodes) into memory.
+ */
+struct DSGDCollectProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+  void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+    for(int e=0; e < vertex.num_outedges(); e++)
+      dsgd_blocks.add(vertex.id(), vertex.outedge(e)->vertex_id(), vertex.outedge(e)->get_data());
+  }
+};
+
+/**
+ * Run niters epochs of stratified SGD. The before_iteration() and after_iteration()
+ * functions of the application program are called around each epoch as in the engine.
+ */
+template<typename Program, typename F>
+void run_dsgd(graphchi_engine<VertexDataType, EdgeDataType> & engine, Program & program, F rating_update, int niters){
+  int P = get_option_int("dsgd_blocks", number_of_omp_threads());
+  if (P < 1)
+    logstream(LOG_FATAL)<<"Option dsgd_blocks must be at least 1, was " << P << "." << std::endl;
+  dsgd_blocks.init(P);
+  DSGDCollectProgram collect;
+  engine.run(collect, 1);
+  dsgd_blocks.finalize();
+
+  graphchi_context gcontext;
+  gcontext.execthreads = dsgd_threads();
+  gcontext.nvertices = engine.num_vertices();
+  for (int iter=0; iter < niters; iter++){
+    gcontext.iteration = iter;
+    program.before_iteration(iter, gcontext);
+    dsgd_blocks.epoch(rating_update);
+    program.after_iteration(iter, gcontext);
+    if (gcontext.last_iteration >= 0 && gcontext.last_iteration <= iter)
+      break;
+  }
+}
+
+#endif //_DSGD_HPP__
@@ -59,6 +59,8 @@ typedef MatrixXi imat;
 typedef Matrix<size_t, Dynamic, Dynamic> matst;
 typedef SparseVector<double> sparse_vec;
 
+#include "fixed_kernels.hpp"
+
 inline void debug_print_vec(const char * name,const vec& _vec, int len){
   printf("%s ) ", name);
   for (int i=0; i< len; i++)
@@ -206,14 +208,22 @@ inline void dot2(const vec&  x1, const vec& x3, mat & Q, int j, int len){
   }
 }
 
+//solve upper(A) x = b in place, using the fixed size kernel when A is D x D
+inline void sym_solve_in_place(const mat &A, vec &bx){
+  if (A.rows() == cf_kernels.dim && cf_kernels.solve_sym != NULL)
+    cf_kernels.solve_sym(A.data(), bx.data());
+  else bx = A.selfadjointView<Upper>().ldlt().solve(bx);
+}
 inline bool ls_solve_chol(const mat &A, const vec &b, vec &result){
   //result = A.jacobiSvd(ComputeThinU | ComputeThinV).solve(b);
-  result = A.ldlt().solve(b);
+  result = b;
+  sym_solve_in_place(A, result);
   return true;
 }
 inline bool ls_solve(const mat &A, const vec &b, vec &result){
   //result = A.jacobiSvd(ComputeThinU | ComputeThinV).solve(b);
-  result = A.ldlt().solve(b);
+  result = b;
+  sym_solve_in_place(A, result);
   return true;
 }
 inline bool chol(mat& sigma, mat& out){
@@ -541,9 +551,53 @@ inline vec pow(const vec&v, int exponent){
 inline double dot_prod(sparse_vec &v1, sparse_vec & v2){
   return v1.dot(v2);
 }
+inline double dot_prod(const double * v1, const double * v2, int len){
+  if (len == cf_kernels.dim)
+    return cf_kernels.dot(v1, v2);
+  return Map<const vec>(v1, len).dot(Map<const vec>(v2, len));
+}
 inline double dot_prod(const vec &v1, const vec & v2){
+  return dot_prod(v1.data(), v2.data(), v1.size());
+}
+//maps (e.g. factor_store rows) go through the same kernels as vec
+template<int O1, int O2>
+inline double dot_prod(const Map<vec, O1> &v1, const Map<vec, O2> & v2){
+  return dot_prod(v1.data(), v2.data(), v1.size());
+}
+template<int O>
+inline double dot_prod(const vec &v1, const Map<vec, O> & v2){
+  return dot_prod(v1.data(), v2.data(), v1.size());
+}
+template<int O>
+inline double dot_prod(const Map<vec, O> &v1, const vec & v2){
+  return dot_prod(v1.data(), v2.data(), v1.size());
+}
+//other dense expressions, without copying them into a vec
+template<typename A, typename B>
+inline double dot_prod(const MatrixBase<A> &v1, const MatrixBase<B> & v2){
   return v1.dot(v2);
 }
+//y += alpha * x, for vec or Map<vec>
+template<typename X, typename Y>
+inline void axpy(double alpha, const X & x, Y & y){
+  if (y.size() == cf_kernels.dim)
+    cf_kernels.axpy(alpha, x.data(), y.data());
+  else y += alpha * x;
+}
+//y = alpha * x + beta * y, for vec or Map<vec>
+template<typename X, typename Y>
+inline void axpby(double alpha, const X & x, double beta, Y & y){
+  if (y.size() == cf_kernels.dim)
+    cf_kernels.axpby(alpha, x.data(), beta, y.data());
+  else y = alpha * x + beta * y;
+}
+//upper(A) += alpha * x * x', for vec or Map<vec>
+template<typename X>
+inline void rank1_update(mat & A, double alpha, const X & x){
+  if (x.size() == cf_kernels.dim)
+    cf_kernels.rank1(alpha, x.data(), A.data());
+  else A.triangularView<Upper>() += alpha * x * x.transpose();
+}
 inline double dot3(const vec &v1, const vec & v2, const vec & v3){
   double ret = 0;
   for (int i=0; i < v1.size(); i++)
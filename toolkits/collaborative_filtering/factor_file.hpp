@@ -0,0 +1,253 @@
+#ifndef _FACTOR_FILE_HPP__
+#define _FACTOR_FILE_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Binary factor files. With --binary_factors=1 the factor matrices and vectors that are
+ * normally written as Matrix Market text (X_U.mm, X_V.mm, X_U_bias.mm, ...) are written as
+ * X_U.bin, X_V.bin, ... instead. When loading factors with --binary_factors=1, the .bin file
+ * is used if it exists; other inputs (for example the global mean, which stays a Matrix Market
+ * scalar) are read as text.
+ *
+ * Layout: a 4096 byte header page (factor_file_header) followed by the rows. Each row holds
+ * cols values of type dtype and starts row_stride bytes after the previous one; rows are
+ * padded to 16 bytes so that the data, which starts on a page boundary, can be used in place
+ * with aligned loads. This is the same row layout as a factor_store, and the file given with
+ * --factors_mmap has this format too. The file is written in parallel through a shared memory
+ * mapping, and opened for reading with one mmap call: rows are paged in as they are accessed,
+ * without any parsing. The apps that keep their factors in a factor_store use the rows of
+ * the mapping in place instead of copying them.
+ */
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eigen_wrapper.hpp"
+#include "common.hpp"
+
+#define FACTOR_FILE_MAGIC "GCFACTR"
+#define FACTOR_FILE_VERSION 1
+#define FACTOR_FILE_DATA_OFFSET 4096
+
+struct factor_file_header {
+  char magic[8];         // FACTOR_FILE_MAGIC
+  uint32_t version;      // FACTOR_FILE_VERSION
+  uint32_t dtype;        // size in bytes of a value, 8 = double
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t row_stride;   // bytes from one row to the next
+  uint64_t data_offset;  // bytes from the start of the file to the first row
+};
+
+/* X_U.mm -> X_U.bin */
+std::string binary_factor_filename(const std::string & fname){
+  if (fname.size() > 3 && fname.substr(fname.size() - 3) == ".mm")
+    return fname.substr(0, fname.size() - 3) + ".bin";
+  return fname + ".bin";
+}
+
+/**
+ * Memory mapping of a binary factor file.
+ */
+class factor_file {
+  int fd;
+  char * data;
+  size_t bytes;
+  factor_file_header header;
+
+  factor_file(const factor_file &);
+  factor_file & operator=(const factor_file &);
+
+  void map(const std::string & fname, int prot, int flags){
+    data = (char*) mmap(NULL, bytes, prot, flags, fd, 0);
+    if (data == MAP_FAILED)
+      logstream(LOG_FATAL)<<"Failed to memory map binary factor file " << fname << std::endl;
+  }
+
+  public:
+  factor_file() : fd(-1), data(NULL), bytes(0) { }
+  ~factor_file(){ close_file(); }
+
+  /**
+   * Map an existing file. Returns false if the file does not exist and optional is set.
+   * With writable set the mapping is private (copy on write): the factors can be updated
+   * in place, and the pages that are modified are copied, so the file itself is not changed.
+   */
+  bool open_file(const std::string & fname, bool optional = false, bool writable = false){
+    close_file();
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0){
+      if (optional)
+        return false;
+      logstream(LOG_FATAL)<<"Failed to open binary factor file " << fname << std::endl;
+    }
+    bytes = st.st_size;
+    if (bytes < sizeof(header))
+      logstream(LOG_FATAL)<<"Binary factor file " << fname << " is truncated" << std::endl;
+    fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      logstream(LOG_FATAL)<<"Failed to open binary factor file " << fname << std::endl;
+    map(fname, writable ? PROT_READ | PROT_WRITE : PROT_READ, writable ? MAP_PRIVATE : MAP_SHARED);
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, FACTOR_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != FACTOR_FILE_VERSION)
+      logstream(LOG_FATAL)<<"File " << fname << " is not a binary factor file (or was written by another version)" << std::endl;
+    if (header.dtype != sizeof(double))
+      logstream(LOG_FATAL)<<"Unsupported value size " << header.dtype << " in binary factor file " << fname << std::endl;
+    if (header.data_offset + header.rows * header.row_stride > bytes)
+      logstream(LOG_FATAL)<<"Binary factor file " << fname << " is truncated" << std::endl;
+    return true;
+  }
+
+  /**
+   * Create a file of rows x cols zero factors, mapped shared and writable. With reuse set,
+   * an existing file of the same size is mapped as it is; returns true in that case.
+   */
+  bool create_file(const std::string & fname, size_t rows, int cols, bool reuse = false){
+    close_file();
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FACTOR_FILE_MAGIC, sizeof(header.magic));
+    header.version = FACTOR_FILE_VERSION;
+    header.dtype = sizeof(double);
+    header.rows = rows;
+    header.cols = cols;
+    header.row_stride = ((cols + 1) & ~(uint64_t)1) * sizeof(double);
+    header.data_offset = FACTOR_FILE_DATA_OFFSET;
+    bytes = header.data_offset + header.rows * header.row_stride;
+
+    bool existing = false;
+    struct stat st;
+    if (reuse && stat(fname.c_str(), &st) == 0 && (size_t)st.st_size == bytes){
+      factor_file_header old;
+      FILE * f = fopen(fname.c_str(), "r");
+      existing = f != NULL && fread(&old, sizeof(old), 1, f) == 1 && memcmp(&old, &header, sizeof(header)) == 0;
+      if (f != NULL)
+        fclose(f);
+    }
+    fd = open(fname.c_str(), O_RDWR | O_CREAT | (existing ? 0 : O_TRUNC), S_IROTH | S_IWOTH | S_IWUSR | S_IRUSR);
+    if (fd < 0 || ftruncate(fd, bytes) != 0)
+      logstream(LOG_FATAL)<<"Failed to create binary factor file " << fname << std::endl;
+    map(fname, PROT_READ | PROT_WRITE, MAP_SHARED);
+    if (!existing)
+      memcpy(data, &header, sizeof(header));
+    return existing;
+  }
+
+  void close_file(){
+    if (fd < 0)
+      return;
+    munmap(data, bytes);
+    close(fd);
+    fd = -1;
+    data = NULL;
+  }
+
+  /* Flush a shared writable mapping to disk */
+  void sync(){
+    if (fd >= 0)
+      msync(data, bytes, MS_SYNC);
+  }
+
+  inline size_t rows(){ return header.rows; }
+  inline int cols(){ return header.cols; }
+  inline double * row(size_t i){
+    return (double*)(data + header.data_offset + i * header.row_stride);
+  }
+};
+
+/**
+ * The pvec of the apps that keep their factors in a factor_store is a view of a row,
+ * which can point into a mapped file; other apps own their factors and copy them.
+ */
+template<int O>
+inline double * factor_row(Map<vec, O> & pvec){ return pvec.data(); }
+template<typename T>
+inline double * factor_row(T & pvec){ return NULL; }
+
+template<int O>
+inline void point_to_row(Map<vec, O> & pvec, double * row, int cols){ new (&pvec) Map<vec, O>(row, cols); }
+template<typename T>
+inline void point_to_row(T & pvec, double * row, int cols){ assert(false); }
+
+/**
+ * Write get_val(first) .. get_val(first + cols - 1) of the nodes start .. end-1. The file is
+ * written under a temporary name and renamed, so a mapping of the previous file that is still
+ * in use (the factors may have been loaded from it) keeps its content.
+ */
+template<typename vertex_data>
+void save_binary_factors(const std::string & fname, uint start, uint end, int cols, int first, std::vector<vertex_data> & latent_factors_inmem){
+  assert(start <= end && cols > 0);
+  std::string tmpname = fname + ".tmp";
+  factor_file f;
+  f.create_file(tmpname, end - start, cols);
+  bool views = first == 0 && start < end && factor_row(latent_factors_inmem[start].pvec) != NULL &&
+    latent_factors_inmem[start].pvec.size() == cols;
+
+#pragma omp parallel for
+  for (int i=0; i< (int)f.rows(); i++){
+    double * row = f.row(i);
+    if (views)
+      memcpy(row, factor_row(latent_factors_inmem[start + i].pvec), cols * sizeof(double));
+    else for (int j=0; j< cols; j++)
+      row[j] = latent_factors_inmem[start + i].get_val(first + j);
+  }
+  f.close_file();
+  if (rename(tmpname.c_str(), fname.c_str()) != 0)
+    logstream(LOG_FATAL)<<"Failed to rename " << tmpname << " to " << fname << std::endl;
+  logstream(LOG_INFO)<<"Wrote binary factors of size " << (end - start) << " x " << cols << " to file: " << fname << std::endl;
+}
+
+/* Files whose rows are used in place; they stay mapped until the program exits */
+std::vector<factor_file*> mapped_factor_files;
+
+/**
+ * Set get_val(first) .. get_val(first + cols - 1) of the nodes offset .. offset + rows - 1
+ * from the file f, which must have been opened writable. When the columns are exactly the
+ * pvec of a node that is a factor_store view, the views are pointed at the rows of the file,
+ * so loading takes O(1) time and the pages are read as they are accessed; otherwise the values
+ * are copied. Takes ownership of f.
+ */
+template<typename vertex_data>
+void load_binary_factors(factor_file * f, int offset, int first, std::vector<vertex_data> & latent_factors_inmem, const std::string & fname){
+  if (offset < 0 || (size_t)offset + f->rows() > latent_factors_inmem.size())
+    logstream(LOG_FATAL)<<"Binary factor file " << fname << " has " << f->rows() << " rows, which do not fit into nodes "
+      << offset << " .. " << latent_factors_inmem.size() - 1 << std::endl;
+  if (f->rows() > 0 && first == 0 && factor_row(latent_factors_inmem[offset].pvec) != NULL &&
+      latent_factors_inmem[offset].pvec.size() == f->cols()){
+    for (uint i=0; i< f->rows(); i++)
+      point_to_row(latent_factors_inmem[offset + i].pvec, f->row(i), f->cols());
+    mapped_factor_files.push_back(f);
+    return;
+  }
+#pragma omp parallel for
+  for (int i=0; i< (int)f->rows(); i++){
+    const double * row = f->row(i);
+    for (int j=0; j< f->cols(); j++)
+      latent_factors_inmem[offset + i].set_val(first + j, row[j]);
+  }
+  delete f;
+}
+
+#endif //_FACTOR_FILE_HPP__
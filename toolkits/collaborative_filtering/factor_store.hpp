@@ -0,0 +1,132 @@
+#ifndef _FACTOR_STORE_HPP__
+#define _FACTOR_STORE_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contiguous storage for the latent factors of all nodes. Row i holds the D factors of
+ * node i; rows are padded to a multiple of 16 bytes and the first row is cache line aligned,
+ * so every row can be used with aligned (SIMD) loads. The vertex_data of an application
+ * keeps a vec_view of its row instead of owning a separately allocated vec, so the factors
+ * of neighboring nodes are read from one array instead of scattered heap blocks.
+ *
+ * With --factors_mmap=filename the array is memory mapped from that file, which allows
+ * models larger than RAM. The file is a binary factor file (see factor_file.hpp) of M+N
+ * rows. If it already exists with the expected size its content is used as the initial
+ * factors, so a run can continue from the factors of a previous run.
+ *
+ * Without it the array is an anonymous mapping, so rows that are never written (for example
+ * the rows of nodes whose views are pointed into binary factor files, see
+ * load_binary_factors()) take no memory.
+ */
+
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include "eigen_wrapper.hpp"
+#include "common.hpp"
+#include "factor_file.hpp"
+
+//view of one row of a factor_store
+typedef Map<vec, Aligned> vec_view;
+
+class factor_store {
+  double * data;
+  size_t rows;
+  int cols;
+  size_t stride;
+  size_t anon_bytes;
+  factor_file backing;
+
+  factor_store(const factor_store &);
+  factor_store & operator=(const factor_store &);
+
+  public:
+  factor_store() : data(NULL), rows(0), cols(0), stride(0), anon_bytes(0) { }
+  ~factor_store(){ release(); }
+
+  void release(){
+    if (anon_bytes > 0)
+      munmap(data, anon_bytes);
+    backing.close_file();
+    anon_bytes = 0;
+    data = NULL;
+    rows = 0;
+  }
+
+  /**
+   * Allocate n rows of d factors, zero initialized, or map them from mmapfile.
+   * Returns true if the factors were read from an existing file.
+   */
+  bool resize(size_t n, int d, std::string mmapfile = ""){
+    release();
+    rows = n; cols = d;
+    stride = (d + 1) & ~(size_t)1;
+    if (mmapfile.empty()){
+      anon_bytes = std::max(rows * stride * sizeof(double), (size_t)64);
+      data = (double*) mmap(NULL, anon_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (data == MAP_FAILED)
+        logstream(LOG_FATAL)<<"Failed to allocate " << anon_bytes / 1024 / 1024 << " MB for the latent factors" << std::endl;
+      return false;
+    }
+    bool existing = backing.create_file(mmapfile, n, d, true);
+    data = backing.row(0);
+    logstream(LOG_INFO)<<"Memory mapped latent factors from " << mmapfile << (existing ? " (existing factors)" : "") << std::endl;
+    return existing;
+  }
+
+  inline double * row(size_t i){ return data + i * stride; }
+  inline size_t size(){ return rows; }
+  inline int dim(){ return cols; }
+  inline size_t row_stride(){ return stride; }
+
+  /**
+   * Flush memory mapped factors to disk.
+   */
+  void sync(){
+    backing.sync();
+  }
+};
+
+/**
+ * Like init_feature_vectors() in common.hpp, but the pvec of each node is a vec_view
+ * of a row of the store.
+ */
+template<typename T>
+void init_feature_vectors(uint size, factor_store & store, T& latent_factors_inmem, bool randomize = true, double scale = 1.0){
+  assert(size > 0);
+
+  srand48(time(NULL));
+  if (store.resize(size, D, get_option_string("factors_mmap", "")))
+    randomize = false;
+  latent_factors_inmem.resize(size); // Initialize in-memory vertices.
+  for (uint i=0; i < size; i++)
+    new (&latent_factors_inmem[i].pvec) vec_view(store.row(i), D);
+  if (!randomize)
+    return;
+
+#pragma omp parallel for
+  for (int i=0; i < (int)size; i++){
+    for (int j=0; j<D; j++)
+      latent_factors_inmem[i].pvec[j] = scale * drand48();
+  }
+}
+
+#endif //_FACTOR_STORE_HPP__
@@ -0,0 +1,122 @@
+#ifndef _FIXED_KERNELS_HPP__
+#define _FIXED_KERNELS_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Dense kernels of the CF inner loops, compiled for fixed feature widths.
+ *
+ * D is a run time parameter, so the factor vectors are dynamically sized Eigen types and
+ * every dot product or update loops over an unknown number of elements. For the common
+ * widths D = 8, 16, 20, 32, 50, 64, 100 and 128, init_fixed_kernels() selects at startup
+ * versions of the dot product, the vector updates, the symmetric rank-1 update and the
+ * symmetric LDLT solve that are instantiated with D as a template argument; the compiler
+ * unrolls and vectorizes them, and the solve works on stack allocated matrices.
+ * For any other width cf_kernels.dim stays 0 and the callers keep using the dynamic code.
+ *
+ * The kernels work on plain column major arrays. The wrappers in eigen_wrapper.hpp check
+ * the vector size against cf_kernels.dim, so vectors of any other length (biases, the
+ * concatenated vectors of svdpp, etc.) still go through the dynamic path.
+ */
+
+#include "Eigen/Dense"
+
+struct fixed_kernels {
+  int dim; // width the kernels were compiled for, 0 if none
+  double (*dot)(const double * a, const double * b);
+  void (*axpy)(double alpha, const double * x, double * y);               // y += alpha * x
+  void (*axpby)(double alpha, const double * x, double beta, double * y); // y = alpha * x + beta * y
+  void (*rank1)(double alpha, const double * x, double * A);              // upper(A) += alpha * x * x'
+  void (*solve_sym)(const double * A, double * bx);                       // bx = upper(A) \ bx, NULL if not specialized
+};
+
+fixed_kernels cf_kernels = { 0, NULL, NULL, NULL, NULL, NULL };
+
+template<int N>
+struct fixed_kernel_impl {
+  typedef Eigen::Matrix<double, N, 1> vecN;
+  typedef Eigen::Matrix<double, N, N> matN;
+
+  static double dot(const double * a, const double * b){
+    return Eigen::Map<const vecN>(a).dot(Eigen::Map<const vecN>(b));
+  }
+  static void axpy(double alpha, const double * x, double * y){
+    Eigen::Map<vecN>(y) += alpha * Eigen::Map<const vecN>(x);
+  }
+  static void axpby(double alpha, const double * x, double beta, double * y){
+    Eigen::Map<vecN> yv(y);
+    yv = alpha * Eigen::Map<const vecN>(x) + beta * yv;
+  }
+  static void rank1(double alpha, const double * x, double * A){
+    for (int j=0; j < N; j++){
+      double s = alpha * x[j];
+      double * col = A + j * N;
+      for (int i=0; i <= j; i++)
+        col[i] += s * x[i];
+    }
+  }
+  static void solve_sym(const double * A, double * bx){
+    Eigen::Map<const matN> Am(A);
+    Eigen::LDLT<matN, Eigen::Upper> ldlt(Am);
+    Eigen::Map<vecN> x(bx);
+    ldlt.solveInPlace(x);
+  }
+};
+
+//the factorization of the two largest widths would need several 100K of stack per thread,
+//and the O(D^3) work hides the loop overhead anyway, so they are solved by the dynamic code
+template<int N, bool on_stack = (N <= 64)>
+struct fixed_solver {
+  static void (*get())(const double *, double *){ return &fixed_kernel_impl<N>::solve_sym; }
+};
+template<int N>
+struct fixed_solver<N, false> {
+  static void (*get())(const double *, double *){ return NULL; }
+};
+
+template<int N>
+inline void set_fixed_kernels(){
+  typedef fixed_kernel_impl<N> impl;
+  fixed_kernels k = { N, &impl::dot, &impl::axpy, &impl::axpby, &impl::rank1, fixed_solver<N>::get() };
+  cf_kernels = k;
+}
+
+/**
+ * Select the kernels for feature width d. Returns false if there is no specialization
+ * for d, in which case all callers use the dynamically sized code.
+ */
+inline bool init_fixed_kernels(int d){
+  switch(d){
+    case 8:   set_fixed_kernels<8>();   break;
+    case 16:  set_fixed_kernels<16>();  break;
+    case 20:  set_fixed_kernels<20>();  break;
+    case 32:  set_fixed_kernels<32>();  break;
+    case 50:  set_fixed_kernels<50>();  break;
+    case 64:  set_fixed_kernels<64>();  break;
+    case 100: set_fixed_kernels<100>(); break;
+    case 128: set_fixed_kernels<128>(); break;
+    default:
+      fixed_kernels none = { 0, NULL, NULL, NULL, NULL, NULL };
+      cf_kernels = none;
+      return false;
+  }
+  return true;
+}
+
+#endif //_FIXED_KERNELS_HPP__
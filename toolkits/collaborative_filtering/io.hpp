@@ -25,6 +25,8 @@
 
 #include "types.hpp"
 #include "implicit.hpp"
+#include "factor_file.hpp"
+#include "mm_reader.hpp"
 
 /*
  * open a file and verify open success
@@ -161,6 +163,10 @@ bool decide_if_edge_is_active(size_t i, int type){
 template<typename vertex_data>
 struct  MMOutputter_vec{
   MMOutputter_vec(std::string fname, uint start, uint end, int index, std::string comment, std::vector<vertex_data> & latent_factors_inmem)  {
+    if (binary_factors){
+      save_binary_factors(binary_factor_filename(fname), start, end, 1, index, latent_factors_inmem);
+      return;
+    }
     MM_typecode matcode;
     set_matcode(matcode, R_output_format);
     FILE * outf = open_file(fname.c_str(), "w");
@@ -186,13 +192,17 @@ template<typename vertex_data>
 struct  MMOutputter_mat{
   MMOutputter_mat(std::string fname, uint start, uint end, std::string comment, std::vector<vertex_data> & latent_factors_inmem, int size = 0)  {
     assert(start < end);
+    int actual_Size = size > 0 ? size : latent_factors_inmem[start].pvec.size();
+    if (binary_factors){
+      save_binary_factors(binary_factor_filename(fname), start, end, actual_Size, 0, latent_factors_inmem);
+      return;
+    }
     MM_typecode matcode;
     set_matcode(matcode, R_output_format);
     FILE * outf = open_file(fname.c_str(), "w");
     mm_write_banner(outf, matcode);
     if (comment != "")
       fprintf(outf, "%%%s\n", comment.c_str());
-    int actual_Size = size > 0 ? size : latent_factors_inmem[start].pvec.size();
 
     if (R_output_format)
       mm_write_mtx_crd_size(outf, end-start, actual_Size, (end-start)*actual_Size);
@@ -290,12 +300,13 @@ int convert_matrixmarket4(std::string base_filename, bool add_time_edges = false
   uint I, J;
   double val, time;
   bool active_edge = true;
+  mm_entry_reader reader(f, nz, 4, base_filename);
+  const double * entry;
 
     for (size_t i=0; i<nz; i++)
     {
-      int rc = fscanf(f, "%d %d %lg %lg\n", &I, &J, &time, &val);
-      if (rc != 4)
-        logstream(LOG_FATAL)<<"Error when reading input file - line " << i << std::endl;
+      reader.next(entry);
+      I = (uint)entry[0]; J = (uint)entry[1]; time = entry[2]; val = entry[3];
       if (time < 0)
         logstream(LOG_FATAL)<<"Time (third columns) should be >= 0 " << std::endl;
       I-=input_file_offset;  /* adjust from 1-based to 0-based */
@@ -403,24 +414,21 @@ int convert_matrixmarket_and_item_similarity(std::string base_filename, std::str
   double val = 1.0;
   int zero_entries = 0;
   unsigned int actual_edges = 0;
+  const double * entry;
     logstream(LOG_INFO) << "Starting to read matrix-market input. Matrix dimensions: "
       << M << " x " << N << ", non-zeros: " << nz << std::endl;
 
+    assert(tokens_per_row == 2 || tokens_per_row == 3);
+    mm_entry_reader reader(f, nz, tokens_per_row, base_filename);
     for (size_t i=0; i<nz; i++){
+      reader.next(entry);
+      I = (uint)entry[0]; J = (uint)entry[1];
       if (tokens_per_row == 3){
-        int rc = fscanf(f, "%u %u %lg\n", &I, &J, &val);
-        if (rc != 3)
-          logstream(LOG_FATAL)<<"Error when reading input file in line: " << i << std::endl;
+        val = entry[2];
         if (val == 0 && ! allow_zeros)
           logstream(LOG_FATAL)<<"Zero weight encountered at input file line: " << i << " . Run with --allow_zeros=1 to ignore zero weights." << std::endl;
         else if (val == 0) { zero_entries++; continue; }
       }
-      else if (tokens_per_row == 2){
-        int rc = fscanf(f, "%u %u\n", &I, &J);
-        if (rc != 2)
-          logstream(LOG_FATAL)<<"Error when reading input file: " << i << std::endl;
-      }
-      else assert(false);
 
       I-=input_file_offset;  /* adjust from 1-based to 0-based */
       J-=input_file_offset;
@@ -440,18 +448,12 @@ int convert_matrixmarket_and_item_similarity(std::string base_filename, std::str
 
     logstream(LOG_DEBUG)<<"Finished loading " << actual_edges << " ratings from file: " << base_filename << std::endl;
 
+    mm_entry_reader sim_reader(fsim, nz_sim, tokens_per_row, similarity_file);
     for (size_t i=0; i<nz_sim; i++){
-      if (tokens_per_row == 3){
-        int rc = fscanf(fsim, "%u %u %lg\n", &I, &J, &val);
-        if (rc != 3)
-          logstream(LOG_FATAL)<<"Error when reading input file: " << similarity_file << " line: " << i << std::endl;
-      }
-      else if (tokens_per_row == 2){
-        int rc = fscanf(fsim, "%u %u\n", &I, &J);
-        if (rc != 2)
-          logstream(LOG_FATAL)<<"Error when reading input file: " << i << std::endl;
-      }
-      else assert(false);
+      sim_reader.next(entry);
+      I = (uint)entry[0]; J = (uint)entry[1];
+      if (tokens_per_row == 3)
+        val = entry[2];
 
       I-=input_file_offset;  /* adjust from 1-based to 0-based */
       J-=input_file_offset;
@@ -531,13 +533,16 @@ int convert_matrixmarket(std::string base_filename, size_t nodes = 0, size_t edg
   double val = 1.0;
   bool active_edge = true;
   int zero_entries = 0;
+  const double * entry;
+  assert(tokens_per_row == 2 || tokens_per_row == 3);
+  mm_entry_reader reader(f, nz, tokens_per_row, base_filename);
 
   for (size_t i=0; i<nz; i++)
     {
+      reader.next(entry);
+      I = (uint)entry[0]; J = (uint)entry[1];
       if (tokens_per_row == 3){
-        int rc = fscanf(f, "%u %u %lg\n", &I, &J, &val);
-        if (rc != 3)
-          logstream(LOG_FATAL)<<"Error when reading input file: " << i << std::endl;
+        val = entry[2];
         if (val == 0 && ! allow_zeros)
           logstream(LOG_FATAL)<<"Encountered zero edge [ " << I << " " <<J << " 0] in line: " << i << " . Run with --allow_zeros=1 to ignore zero weights." << std::endl;
         else if (val == 0){
@@ -545,12 +550,6 @@ int convert_matrixmarket(std::string base_filename, size_t nodes = 0, size_t edg
            continue;
         }
       }
-      else if (tokens_per_row == 2){
-        int rc = fscanf(f, "%u %u\n", &I, &J);
-        if (rc != 2)
-          logstream(LOG_FATAL)<<"Error when reading input file: " << i << std::endl;
-      }
-      else assert(false);
 
       if (I ==987654321 || J== 987654321) //hack - to be removed later
         continue;
@@ -617,6 +616,18 @@ void load_matrix_market_vector(const std::string & filename,
   uint M, N;
   size_t i,nz;
 
+  if (binary_factors){
+    factor_file * ff = new factor_file();
+    if (ff->open_file(binary_factor_filename(filename), true, true)){
+      if (ff->cols() != 1)
+        logstream(LOG_FATAL)<<"Binary factor file " << binary_factor_filename(filename) << " holds a matrix, expected a vector" << std::endl;
+      logstream(LOG_INFO)<<"Succesfully read a binary vector of size: " << ff->rows() << std::endl;
+      load_binary_factors(ff, offset, type, latent_factors_inmem, binary_factor_filename(filename));
+      return;
+    }
+    delete ff;
+  }
+
   logstream(LOG_INFO) <<"Going to read matrix market vector from input file: " << filename << std::endl;
 
   FILE * f = open_file(filename.c_str(), "r", optional_field);
@@ -655,22 +666,19 @@ void load_matrix_market_vector(const std::string & filename,
 
   uint row,col;
   double val;
+  const double * entry;
+  mm_entry_reader reader(f, nz, mm_is_sparse(matcode) ? 3 : 1, filename);
 
   for (i=0; i<nz; i++)
   {
+    reader.next(entry);
     if (mm_is_sparse(matcode)){
-      int rc = fscanf(f, "%u %u %lg\n", &row, &col, &val);
-      if (rc != 3){
-        logstream(LOG_FATAL) << "Failed reading input file: " << filename << "Problm at data row " << i << " (not including header and comment lines)" << std::endl;
-      }
-      row--;  /* adjust from 1-based to 0-based */
-      col--;
+      row = (uint)entry[0] - 1;  /* adjust from 1-based to 0-based */
+      col = (uint)entry[1] - 1;
+      val = entry[2];
     }
     else {
-      int rc = fscanf(f, "%lg\n", &val);
-      if (rc != 1){
-        logstream(LOG_FATAL) << "Failed reading input file: " << filename << "Problm at data row " << i << " (not including header and comment lines)" << std::endl;
-      }
+      val = entry[0];
       row = i;
       col = 0;
     }
@@ -695,6 +703,19 @@ vec load_matrix_market_vector(const std::string & filename,  bool optional_field
   uint M, N;
   size_t i,nz;
 
+  if (binary_factors){
+    factor_file ff;
+    if (ff.open_file(binary_factor_filename(filename), true)){
+      if (ff.cols() != 1)
+        logstream(LOG_FATAL)<<"Binary factor file " << binary_factor_filename(filename) << " holds a matrix, expected a vector" << std::endl;
+      vec ret(ff.rows());
+      for (uint i=0; i< ff.rows(); i++)
+        ret[i] = ff.row(i)[0];
+      logstream(LOG_INFO)<<"Succesfully read a binary vector of size: " << ff.rows() << std::endl;
+      return ret;
+    }
+  }
+
   logstream(LOG_INFO) <<"Going to read matrix market vector from input file: " << filename << std::endl;
 
   FILE * f = open_file(filename.c_str(), "r", optional_field);
@@ -733,22 +754,19 @@ vec load_matrix_market_vector(const std::string & filename,  bool optional_field
   vec ret = zeros(M);
   uint row,col;
   double val;
+  const double * entry;
+  mm_entry_reader reader(f, nz, mm_is_sparse(matcode) ? 3 : 1, filename);
 
   for (i=0; i<nz; i++)
   {
+    reader.next(entry);
     if (mm_is_sparse(matcode)){
-      int rc = fscanf(f, "%u %u %lg\n", &row, &col, &val);
-      if (rc != 3){
-        logstream(LOG_FATAL) << "Failed reading input file: " << filename << "Problm at data row " << i << " (not including header and comment lines)" << std::endl;
-      }
-      row--;  /* adjust from 1-based to 0-based */
-      col--;
+      row = (uint)entry[0] - 1;  /* adjust from 1-based to 0-based */
+      col = (uint)entry[1] - 1;
+      val = entry[2];
     }
     else {
-      int rc = fscanf(f, "%lg\n", &val);
-      if (rc != 1){
-        logstream(LOG_FATAL) << "Failed reading input file: " << filename << "Problm at data row " << i << " (not including header and comment lines)" << std::endl;
-      }
+      val = entry[0];
       row = i;
       col = 0;
     }
@@ -838,6 +856,18 @@ inline void write_output_vector(const std::string & datafile, const vec& output,
 
 /** load a matrix market file into a matrix */
 void load_matrix_market_matrix(const std::string & filename, int offset, int D){
+  if (binary_factors){
+    factor_file * ff = new factor_file();
+    if (ff->open_file(binary_factor_filename(filename), true, true)){
+      if (D != ff->cols())
+        logstream(LOG_FATAL)<<"Wrong matrix size detected, command line argument should be --D=" << D << " instead of : " << ff->cols() << std::endl;
+      logstream(LOG_INFO) << "Factors from file: loaded binary matrix of size " << ff->rows() << " x " << ff->cols() << " from file: " << binary_factor_filename(filename) << std::endl;
+      load_binary_factors(ff, offset, 0, latent_factors_inmem, binary_factor_filename(filename));
+      return;
+    }
+    delete ff;
+  }
+
   MM_typecode matcode;                        
   uint i,I,J;
   double val;
@@ -863,21 +893,21 @@ void load_matrix_market_matrix(const std::string & filename, int offset, int D){
   if (D != (int)cols)
     logstream(LOG_FATAL)<<"Wrong matrix size detected, command line argument should be --D=" << D << " instead of : " << cols << std::endl;
 
+  const double * entry;
+  mm_entry_reader reader(f, nnz, mm_is_sparse(matcode) ? 3 : 1, filename);
   for (i=0; i<nnz; i++){
+    reader.next(entry);
     if (mm_is_sparse(matcode)){
-      rc = fscanf(f, "%u %u %lg\n", &I, &J, &val);
-      if (rc != 3)
-        logstream(LOG_FATAL)<<"Error reading input line " << i << std::endl;
-      I--; J--;
+      I = (uint)entry[0] - 1;
+      J = (uint)entry[1] - 1;
+      val = entry[2];
       assert(I >= 0 && I < rows);
       assert(J >= 0 && J < cols);
       //set_val(a, I, J, val);
       latent_factors_inmem[I+offset].set_val(J,val);
     }
     else {
-      rc = fscanf(f, "%lg", &val);
-      if (rc != 1)
-        logstream(LOG_FATAL)<<"Error reading nnz " << i << std::endl;
+      val = entry[0];
       I = i / cols;
       J = i % cols;
       latent_factors_inmem[I+offset].set_val(J, val);
@@ -34,6 +34,11 @@
  * For Probablistic item similarity see: Oliver Jojic, Manu Shukla, and Niranjan Bhosarekar. 2011. A probabilistic definition of item 
    similarity. In Proceedings of the fifth ACM conference on Recommender systems (RecSys '11). ACM, New York, NY, USA, 229-236.
 
+ *
+ * With --lsh_bands=B (and --lsh_rows=R, default 4) the first pass over the graph also
+ * computes MinHash signatures of the items, and each item is compared only to the pivots
+ * which are LSH candidates of it (see minhash.hpp), instead of all pivots sharing a user with it.
+ * Candidate buckets with more than --lsh_max_bucket items (default 1000, 0 = no limit) are skipped.
  *
  * Acknowledgements: thanks to Clive Cox, Rummble Labs,  for implementing Asym. Cosince metric and contributing the code.
  */
@@ -46,6 +51,7 @@
 #include "common.hpp"
 #include "timer.hpp"
 #include "eigen_wrapper.hpp"
+#include "minhash.hpp"
 #include "engine/dynamic_graphs/graphchi_dynamicgraph_engine.hpp"
 #include <libgen.h>
 
@@ -69,6 +75,7 @@ int grabbed_edges = 0;
 int distance_metric;
 float asym_cosine_alpha = 0.5;
 double prob_sim_normalization_constant = 0;
+minhash_lsh lsh;
 
 int debug = 0;
 
@@ -322,6 +329,12 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
      * 2) Find which subset of items needs to compared to the users
      */
     if (gcontext.iteration % 2 == 0) {
+      //in the zero iteration, compute the MinHash signature of each item
+      if (gcontext.iteration == 0 && lsh.enabled() && is_item(v.id())){
+        for(int i=0; i<v.num_edges(); i++)
+          lsh.add(v.id() - M, v.edge(i)->vertex_id());
+      }
+
       if (adjcontainer->is_pivot(v.id()) && is_item(v.id())){
         adjcontainer->load_edges_into_memory(v);         
         if (debug)
@@ -377,9 +390,19 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
       }
       std::vector<index_val> heap;
 
-      
+      const uint32_t * cand = NULL, * cand_end = NULL;
+      if (lsh.enabled()){
+        lsh.candidates(v.id() - M, &cand, &cand_end);
+        cand = std::lower_bound(cand, cand_end, (uint32_t)(adjcontainer->pivot_st - M));
+      }
 
       for (vid_t i=adjcontainer->pivot_st; i< adjcontainer->pivot_en; i++){
+        //with LSH, compare only to the candidate pivots
+        if (lsh.enabled()){
+          if (cand == cand_end || *cand + M >= adjcontainer->pivot_en)
+            break;
+          i = *cand++ + M;
+        }
         //if using a symmetric distance function, compare only to pivots which are smaller than this item id
         if (((distance_metric != ASYM_COSINE && distance_metric != PROB) && i >= v.id()) || (!relevant_items[i-M])){
           if (debug) 
@@ -436,6 +459,10 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
       grabbed_edges = 0;
       adjcontainer->clear();
     } else { //iteration % 2 == 1
+      if (gcontext.iteration == 1 && lsh.enabled()){
+        size_t pairs = lsh.build_candidates();
+        logstream(LOG_INFO)<< std::setw(10) << mytimer.current_time() << ")  LSH candidate item pairs: " << pairs << " (skipped " << lsh.skipped_buckets << " large buckets)" << std::endl;
+      }
       for (vid_t i=M; i < M+N; i++){
         gcontext.scheduler->add_task(i); 
       }
@@ -524,6 +551,10 @@ int main(int argc, const char ** argv) {
   if (distance_metric == PROB)
     prob_sim_normalization_constant = (double)L / (double)(M*N-L);
 
+  int lsh_bands            = get_option_int("lsh_bands", 0);
+  if (lsh_bands > 0)
+    lsh.init(N, lsh_bands, get_option_int("lsh_rows", 4), get_option_int("lsh_max_bucket", 1000), get_option_int("lsh_seed", 1));
+
 
   /* Run */
   ItemDistanceProgram program;
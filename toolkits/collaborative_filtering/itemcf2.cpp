@@ -53,6 +53,12 @@ Slope One
 See "A prorammers guide to data mining" page 18:
 http://guidetodatamining.com/guide/ch3/DataMining-ch3.pdf
 
+LSH candidate pairs
+
+With --lsh_bands=B (and --lsh_rows=R, default 4) MinHash signatures of the items are computed
+in the first pass, and each item is compared only to the pivots which are LSH candidates of it
+(see minhash.hpp). Candidates are pairs with a high Jaccard index of their user sets.
+
 */
 #define GRAPHCHI_DISABLE_COMPRESSION
 
@@ -64,6 +70,7 @@ http://guidetodatamining.com/guide/ch3/DataMining-ch3.pdf
 #include <iostream>
 #include "eigen_wrapper.hpp"
 #include "distance.hpp"
+#include "minhash.hpp"
 #include "util.hpp"
 #include "timer.hpp"
 #include "common.hpp"
@@ -92,6 +99,7 @@ timer mytimer;
 bool * relevant_items  = NULL;
 vec mean;
 vec stddev;
+minhash_lsh lsh;
 int grabbed_edges = 0;
 int distance_metric;
 int debug;
@@ -332,6 +340,8 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
           graphchi_edge<float> * e = v.edge(i);
           vid_t user = e->vertexid;
           mean[user] += e->get_data() / (float)N;
+          if (lsh.enabled())
+            lsh.add(v.id() - M, user);
         }
       }
     }
@@ -394,7 +404,19 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
       }
       std::vector<index_val> heap;
 
+      const uint32_t * cand = NULL, * cand_end = NULL;
+      if (lsh.enabled()){
+        lsh.candidates(v.id() - M, &cand, &cand_end);
+        cand = std::lower_bound(cand, cand_end, (uint32_t)(adjcontainer->pivot_st - M));
+      }
+
       for (vid_t i=adjcontainer->pivot_st; i< adjcontainer->pivot_en; i++){
+        //with LSH, compare only to the candidate pivots
+        if (lsh.enabled()){
+          if (cand == cand_end || *cand + M >= adjcontainer->pivot_en)
+            break;
+          i = *cand++ + M;
+        }
         //since metric is symmetric, compare only to pivots which are smaller than this item id
         if (i >= v.id() || (!relevant_items[i-M]))
           continue;
@@ -446,6 +468,10 @@ struct ItemDistanceProgram : public GraphChiProgram<VertexDataType, EdgeDataType
       grabbed_edges = 0;
       adjcontainer->clear();
     } else { //iteration % 2 == 1
+      if (gcontext.iteration == 1 && lsh.enabled()){
+        size_t pairs = lsh.build_candidates();
+        logstream(LOG_INFO)<< std::setw(10) << mytimer.current_time() << ")  LSH candidate item pairs: " << pairs << " (skipped " << lsh.skipped_buckets << " large buckets)" << std::endl;
+      }
       for (vid_t i=M; i < M+N; i++){
         gcontext.scheduler->add_task(i); 
       }
@@ -539,6 +565,10 @@ int main(int argc, const char ** argv) {
   mean = vec::Zero(M);
   stddev = vec::Zero(N); 
 
+  int lsh_bands            = get_option_int("lsh_bands", 0);
+  if (lsh_bands > 0)
+    lsh.init(N, lsh_bands, get_option_int("lsh_rows", 4), get_option_int("lsh_max_bucket", 1000), get_option_int("lsh_seed", 1));
+
   /* Run */
   ItemDistanceProgram program;
   graphchi_engine<VertexDataType, EdgeDataType> engine(training, 1, true, m); 
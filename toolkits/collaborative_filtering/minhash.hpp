@@ -0,0 +1,168 @@
+#ifndef _MINHASH_HPP__
+#define _MINHASH_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * MinHash signatures and LSH banding for generating candidate item pairs.
+ * Each item gets bands * rows min-hash values over the set of users who rated it.
+ * Two items become a candidate pair if all rows of at least one band agree, which
+ * happens with probability 1 - (1 - J^rows)^bands for items with Jaccard index J.
+ * Exact similarity then needs to be computed only for the candidate pairs instead of
+ * all item pairs.
+ *
+ * See: Leskovec, Rajaraman and Ullman, Mining of Massive Datasets, chapter 3.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <stdint.h>
+#include <omp.h>
+#include "graphchi_basic_includes.hpp"
+
+inline uint64_t minhash_mix(uint64_t x){
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+class minhash_lsh {
+  int bands, rows, nhashes;
+  uint64_t seed;
+  std::vector<uint32_t> signatures; // nhashes per item, item i at offset i * nhashes
+  std::vector<size_t> cand_offsets; // candidates of item i are cand_items[cand_offsets[i]..cand_offsets[i+1])
+  std::vector<uint32_t> cand_items;
+
+  public:
+  int max_bucket;
+  size_t skipped_buckets;
+
+  minhash_lsh() : bands(0), rows(0), nhashes(0), seed(0), max_bucket(0), skipped_buckets(0) { }
+
+  void init(uint nitems, int _bands, int _rows, int _max_bucket, uint64_t _seed){
+    bands = _bands; rows = _rows; nhashes = bands * rows;
+    max_bucket = _max_bucket;
+    seed = _seed;
+    signatures.assign((size_t)nitems * nhashes, UINT_MAX);
+    cand_offsets.clear();
+    cand_items.clear();
+  }
+
+  bool enabled(){ return nhashes > 0; }
+
+  /**
+   * Fold a user into the signature of an item. The k-th hash function is
+   * h1 + k * h2 (Kirsch and Mitzenmacher), so one 64 bit hash per user suffices.
+   * Different items may be updated in parallel.
+   */
+  inline void add(uint item, graphchi::vid_t user){
+    uint64_t h = minhash_mix(user ^ minhash_mix(seed));
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    uint32_t * sig = &signatures[(size_t)item * nhashes];
+    for (int k=0; k< nhashes; k++){
+      uint32_t val = h1 + (uint32_t)k * h2;
+      if (val < sig[k])
+        sig[k] = val;
+    }
+  }
+
+  /**
+   * Hash the items into buckets band by band, and collect all item pairs sharing a
+   * bucket as candidates. Buckets larger than max_bucket (if positive) are skipped, since
+   * they are typically formed by items with very few users and would cost a
+   * quadratic number of pairs. Items with no users are never candidates.
+   */
+  size_t build_candidates(){
+    uint nitems = nhashes > 0 ? signatures.size() / nhashes : 0;
+    std::vector<std::vector<std::pair<uint32_t,uint32_t> > > thread_pairs(omp_get_max_threads());
+    skipped_buckets = 0;
+    size_t skipped = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+:skipped)
+    for (int b=0; b< bands; b++){
+      std::vector<std::pair<uint64_t,uint32_t> > keys;
+      keys.reserve(nitems);
+      for (uint i=0; i< nitems; i++){
+        const uint32_t * sig = &signatures[(size_t)i * nhashes + (size_t)b * rows];
+        if (sig[0] == UINT_MAX)
+          continue;
+        uint64_t key = b;
+        for (int r=0; r< rows; r++)
+          key = minhash_mix(key ^ sig[r]);
+        keys.push_back(std::make_pair(key, i));
+      }
+      std::sort(keys.begin(), keys.end());
+      std::vector<std::pair<uint32_t,uint32_t> > & pairs = thread_pairs[omp_get_thread_num()];
+      for (size_t st=0; st < keys.size(); ){
+        size_t en = st + 1;
+        while (en < keys.size() && keys[en].first == keys[st].first)
+          en++;
+        if (max_bucket > 0 && (int)(en - st) > max_bucket)
+          skipped++;
+        else {
+          for (size_t x=st; x< en; x++)
+            for (size_t y=st; y< en; y++)
+              if (x != y)
+                pairs.push_back(std::make_pair(keys[x].second, keys[y].second));
+        }
+        st = en;
+      }
+    }
+    skipped_buckets = skipped;
+
+    std::vector<std::pair<uint32_t,uint32_t> > all;
+    for (uint t=0; t< thread_pairs.size(); t++){
+      all.insert(all.end(), thread_pairs[t].begin(), thread_pairs[t].end());
+      std::vector<std::pair<uint32_t,uint32_t> >().swap(thread_pairs[t]);
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+
+    cand_offsets.assign(nitems + 1, 0);
+    cand_items.resize(all.size());
+    for (size_t j=0; j< all.size(); j++){
+      cand_offsets[all[j].first + 1]++;
+      cand_items[j] = all[j].second;
+    }
+    for (uint i=0; i< nitems; i++)
+      cand_offsets[i+1] += cand_offsets[i];
+
+    //signatures are no longer needed
+    std::vector<uint32_t>().swap(signatures);
+    return all.size() / 2;
+  }
+
+  /**
+   * Sorted candidates of an item: [*begin, *end).
+   */
+  inline void candidates(uint item, const uint32_t ** begin, const uint32_t ** end){
+    if (cand_items.empty()){
+      *begin = *end = NULL;
+      return;
+    }
+    *begin = &cand_items[0] + cand_offsets[item];
+    *end = &cand_items[0] + cand_offsets[item + 1];
+  }
+};
+
+#endif //_MINHASH_HPP__
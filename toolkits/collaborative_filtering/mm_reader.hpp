@@ -0,0 +1,192 @@
+#ifndef _MM_READER_HPP__
+#define _MM_READER_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Parallel reader for the body of Matrix Market (and the other CF text) files.
+ *
+ * The entries are read in batches of MM_READ_BATCH bytes. Each batch is cut at line ends into
+ * one piece per thread, and the pieces are parsed in parallel into arrays of numbers.
+ * next() then hands out the entries in file order, so the caller (for example the loop that
+ * feeds the sharder, which is not thread safe) keeps its sequential logic, its line numbers
+ * and its error messages, while the number parsing, which dominates the loading time, runs on
+ * all threads. Integers are parsed directly; other numbers go through strtod().
+ */
+
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "common.hpp"
+
+#ifndef MM_READ_BATCH
+#define MM_READ_BATCH (64*1024*1024)
+#endif
+
+class mm_entry_reader {
+  int fd;
+  off_t offset;          // file position of the next batch
+  off_t file_size;
+  size_t nz;
+  int tokens;            // numbers per entry
+  std::string filename;
+  std::vector<char> buf;
+  size_t buffered;       // bytes in buf carried over from the previous batch
+  bool eof;
+
+  struct piece {
+    std::vector<double> values;
+    size_t entries;
+    bool bad;            // parsing stopped at entry number 'entries'
+  };
+  std::vector<piece> pieces;
+  size_t cur_piece, cur_entry;
+  size_t read_entries;   // entries handed out so far
+
+  static inline bool is_space(char c){
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  static inline bool parse_number(const char * & p, const char * end, double & out){
+    const char * start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')){
+      neg = *p == '-';
+      p++;
+    }
+    const char * digits = p;
+    unsigned long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - digits < 18)
+      v = v * 10 + (*p++ - '0');
+    if (p > digits && (p == end || is_space(*p))){
+      out = neg ? -(double)v : (double)v;
+      return true;
+    }
+    char * endp;
+    out = strtod(start, &endp);
+    p = endp;
+    return endp > start && endp <= end && (p == end || is_space(*p));
+  }
+
+  static void parse_piece(const char * p, const char * end, int tokens, piece & out){
+    out.values.clear();
+    out.entries = 0;
+    out.bad = false;
+    while (true){
+      while (p < end && is_space(*p))
+        p++;
+      if (p == end)
+        return;
+      for (int t=0; t< tokens; t++){
+        while (p < end && is_space(*p))
+          p++;
+        double val;
+        if (p == end || !parse_number(p, end, val)){
+          out.values.resize(out.entries * tokens);
+          out.bad = true;
+          return;
+        }
+        out.values.push_back(val);
+      }
+      out.entries++;
+    }
+  }
+
+  /* read and parse the next batch, returns false at the end of the file */
+  bool fill(){
+    if (eof && buffered == 0)
+      return false;
+    while (!eof){
+      size_t want = std::max((off_t)1, std::min((off_t)MM_READ_BATCH, file_size - offset));
+      if (buf.size() < buffered + want + 1)
+        buf.resize(buffered + want + 1);
+      ssize_t rc = pread(fd, &buf[buffered], want, offset);
+      if (rc < 0)
+        logstream(LOG_FATAL)<<"Failed to read input file: " << filename << std::endl;
+      offset += rc;
+      buffered += rc;
+      eof = rc == 0;
+      if (eof || memchr(&buf[buffered - rc], '\n', rc) != NULL)
+        break;
+    }
+    size_t len = buffered;
+    if (!eof){
+      while (buf[len - 1] != '\n')
+        len--;
+    }
+    buf[buffered] = '\0';
+
+    int nthreads = std::max(1, omp_get_max_threads());
+    std::vector<size_t> cuts(nthreads + 1, len);
+    cuts[0] = 0;
+    for (int t=1; t< nthreads; t++){
+      size_t c = std::max(cuts[t-1], len * t / nthreads);
+      while (c < len && c > 0 && buf[c - 1] != '\n')
+        c++;
+      cuts[t] = c;
+    }
+    pieces.resize(nthreads);
+#pragma omp parallel for
+    for (int t=0; t< nthreads; t++)
+      parse_piece(&buf[0] + cuts[t], &buf[0] + cuts[t+1], tokens, pieces[t]);
+
+    memmove(&buf[0], &buf[len], buffered - len);
+    buffered -= len;
+    cur_piece = cur_entry = 0;
+    return true;
+  }
+
+  public:
+  /**
+   * Reader for nz entries of tokens numbers each, starting at the current position of f.
+   */
+  mm_entry_reader(FILE * f, size_t nz, int tokens, const std::string & filename) :
+    fd(fileno(f)), offset(ftell(f)), nz(nz), tokens(tokens), filename(filename),
+    buffered(0), eof(false), cur_piece(0), cur_entry(0), read_entries(0) {
+    assert(tokens > 0);
+    struct stat st;
+    file_size = fstat(fd, &st) == 0 ? st.st_size : offset;
+  }
+
+  /**
+   * Point vals to the numbers of the next entry. Fails if the file holds fewer than nz
+   * valid entries.
+   */
+  void next(const double * & vals){
+    if (read_entries >= nz)
+      logstream(LOG_FATAL)<<"Reading more than the " << nz << " entries of file: " << filename << std::endl;
+    while (cur_piece >= pieces.size() || cur_entry == pieces[cur_piece].entries){
+      if (cur_piece < pieces.size() && pieces[cur_piece].bad)
+        logstream(LOG_FATAL)<<"Error when reading input file: " << filename << " in data line " << read_entries << " (not including header and comment lines)" << std::endl;
+      if (cur_piece + 1 < pieces.size())
+        cur_piece++, cur_entry = 0;
+      else if (!fill())
+        logstream(LOG_FATAL)<<"Input file: " << filename << " ended after " << read_entries << " entries, expected " << nz << std::endl;
+    }
+    vals = &pieces[cur_piece].values[cur_entry * tokens];
+    cur_entry++;
+    read_entries++;
+  }
+};
+
+#endif //_MM_READER_HPP__
@@ -32,13 +32,13 @@
 
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
+#include "factor_store.hpp"
 
 const double epsilon = 1e-16;
 struct vertex_data {
-  vec pvec;
+  vec_view pvec;
 
-  vertex_data() {
-   pvec = zeros(D); 
+  vertex_data() : pvec(NULL, 0) {
   }
   void set_val(int index, float val){
     pvec[index] = val;
@@ -56,6 +56,7 @@ typedef float EdgeDataType;  // Edges store the "rating" of user->movie pair
 graphchi_engine<VertexDataType, EdgeDataType> * pengine = NULL; 
 graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine = NULL; 
 std::vector<vertex_data> latent_factors_inmem;
+factor_store latent_factors_store;
 vec sum_of_item_latent_features, sum_of_user_latent_feautres;
 int iter;
 
@@ -212,7 +213,7 @@ int main(int argc, const char ** argv) {
 
   /* Preprocess data if needed, or discover preprocess files */
   int nshards = convert_matrixmarket<float>(training, 0, 0, 3, TRAINING, false);
-  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_inmem, !load_factors_from_file);
+  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_store, latent_factors_inmem, !load_factors_from_file);
   if (validation != ""){
     int vshards = convert_matrixmarket<EdgeDataType>(validation, 0, 0, 3, VALIDATION, false);
     if (vshards != -1)
@@ -0,0 +1,167 @@
+#ifndef _NORMAL_EQUATIONS_HPP__
+#define _NORMAL_EQUATIONS_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Assembly and solution of the ALS normal equations (XtX + lambda*I) x = Xty of one node.
+ *
+ * Instead of one rank-1 update of XtX per edge, the neighbor factors are gathered into the
+ * columns of a buffer of --als_batch (default 64) columns, and each full buffer is added to
+ * XtX with one blocked symmetric rank-k update (syrk) and to Xty with one matrix-vector product.
+ * Every thread reuses its own buffers, so no matrices are allocated per node. The solve
+ * uses the fixed size LDLT of fixed_kernels.hpp when D is one of its widths.
+ *
+ * With --als_cg_degree=d, nodes with more than d edges are solved instead with
+ * --als_cg_iters (default 3) conjugate gradient steps, warm started from the current factors.
+ * XtX is then never formed: each step multiplies with the gathered factors, which costs
+ * O(edges * D) instead of O(edges * D^2).
+ */
+
+#include <vector>
+#include <cmath>
+#include <omp.h>
+#include "eigen_wrapper.hpp"
+#include "common.hpp"
+
+int als_batch = 64;
+int als_cg_degree = 0;
+int als_cg_iters = 3;
+
+class normal_equations {
+  mat X;    // gathered (weighted) neighbor factors, one per column
+  vec y;    // matching (weighted) observations
+  int n;
+  bool use_cg;
+
+  public:
+  mat XtX;  // upper triangle only
+  vec Xty;
+
+  normal_equations() : n(0), use_cg(false) { }
+
+  /**
+   * Start the equations of a node with num_edges edges.
+   */
+  void reset(int num_edges, bool allow_cg = true){
+    use_cg = allow_cg && als_cg_degree > 0 && num_edges > als_cg_degree;
+    int cols = use_cg ? num_edges : als_batch;
+    if (X.rows() != D || X.cols() < cols){
+      X.resize(D, cols);
+      y.resize(cols);
+    }
+    if (XtX.rows() != D){
+      XtX.resize(D, D);
+      Xty.resize(D);
+    }
+    if (!use_cg){
+      XtX.setZero();
+      Xty.setZero();
+    }
+    n = 0;
+  }
+
+  /**
+   * Add an edge: XtX += weight * x * x', Xty += weight * obs * x.
+   */
+  template<typename V>
+  inline void add(const MatrixBase<V> & x, double obs, double weight = 1.0){
+    if (weight < 0){ //cannot be expressed as a rank-k update of the form X*X'
+      assert(!use_cg);
+      X.col(n) = x; //scratch column, not counted in n
+      rank1_update(XtX, weight, X.col(n));
+      axpy(obs * weight, X.col(n), Xty);
+      return;
+    }
+    double s = weight == 1.0 ? 1.0 : sqrt(weight);
+    X.col(n) = x * s;
+    y[n] = obs * s;
+    if (++n == X.cols() && !use_cg)
+      flush();
+  }
+
+  void flush(){
+    if (n == 0)
+      return;
+    XtX.selfadjointView<Eigen::Upper>().rankUpdate(X.leftCols(n));
+    Xty.noalias() += X.leftCols(n) * y.head(n);
+    n = 0;
+  }
+
+  /**
+   * The full symmetric matrix XtX + regularization*I (not available in conjugate gradient mode).
+   */
+  mat system(double regularization){
+    assert(!use_cg);
+    flush();
+    for (int i=0; i < D; i++)
+      XtX(i,i) += regularization;
+    return XtX.selfadjointView<Eigen::Upper>();
+  }
+
+  /**
+   * Solve (XtX + regularization*I) result = Xty. In conjugate gradient mode result holds the
+   * starting point on entry.
+   */
+  template<typename V>
+  void solve(double regularization, V & result){
+    if (!use_cg){
+      flush();
+      for (int i=0; i < D; i++)
+        XtX(i,i) += regularization;
+      sym_solve_in_place(XtX, Xty);
+      result = Xty;
+      return;
+    }
+
+    vec x = result;
+    vec r = X.leftCols(n) * y.head(n) - X.leftCols(n) * (X.leftCols(n).transpose() * x) - regularization * x;
+    vec p = r;
+    double rr = r.squaredNorm();
+    for (int it=0; it < als_cg_iters && rr > 1e-20; it++){
+      vec Ap = X.leftCols(n) * (X.leftCols(n).transpose() * p) + regularization * p;
+      double alpha = rr / p.dot(Ap);
+      x += alpha * p;
+      r -= alpha * Ap;
+      double rr_new = r.squaredNorm();
+      p = r + (rr_new / rr) * p;
+      rr = rr_new;
+    }
+    result = x;
+  }
+};
+
+std::vector<normal_equations> normal_equations_per_thread;
+
+void init_normal_equations(){
+  als_batch     = get_option_int("als_batch", als_batch);
+  als_cg_degree = get_option_int("als_cg_degree", als_cg_degree);
+  als_cg_iters  = get_option_int("als_cg_iters", als_cg_iters);
+  if (als_batch <= 0)
+    logstream(LOG_FATAL)<<"--als_batch should be positive" << std::endl;
+  //the engine runs the updates with --execthreads threads, which may exceed the number of cores
+  int threads = std::max(number_of_omp_threads(), omp_get_max_threads());
+  normal_equations_per_thread.resize(std::max(threads, (int)get_option_int("execthreads", threads)));
+}
+
+inline normal_equations & thread_normal_equations(){
+  return normal_equations_per_thread[omp_get_thread_num()];
+}
+
+#endif //_NORMAL_EQUATIONS_HPP__
@@ -318,8 +318,8 @@ struct PMFVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
       const edge_data & edge = vertex.edge(e)->get_data();
       float observation = edge.weight;                
       vertex_data & nbr_latent = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-      Xty += nbr_latent.pvec * observation;
-      XtX.triangularView<Eigen::Upper>() += nbr_latent.pvec * nbr_latent.pvec.transpose();
+      axpy(observation, nbr_latent.pvec, Xty);
+      rank1_update(XtX, 1.0, nbr_latent.pvec);
       if (compute_rmse) {
         double prediction;
         rmse_vec[omp_get_thread_num()] += pmf_predict(vdata, nbr_latent, observation, prediction, (void*)&edge.avgprd);
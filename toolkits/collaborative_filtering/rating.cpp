@@ -32,6 +32,7 @@
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
 #include "timer.hpp"
+#include "topk_recommender.hpp"
 
 int debug;
 int num_ratings;
@@ -42,6 +43,7 @@ int algo = 0;
 uint users_without_ratings = 0;
 vec singular_values;
 mutex mymutex;
+std::vector<std::vector<uint> > rated_items; //sorted rated items of each user, relative to start_user
 
 enum {
   ALS = 0, SPARSE_ALS = 1, SGD = 2, NMF = 3, WALS = 4, SVD = 5, CLIMF = 6
@@ -222,36 +224,24 @@ struct RatingVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeD
        mymutex.unlock();
     }
 
+    //all items are scored later in blocks of users, see compute_topk()
+    if (knn_sample_percent == 1.0){
+      std::vector<uint> & rated = rated_items[vertex.id() - std::max(start_user, 0)];
+      for(int e=0; e < vertex.num_edges(); e++) {
+        //no need to calculate this rating since it is given in the training data reference
+        assert(vertex.edge(e)->vertex_id() - M >= 0 && vertex.edge(e)->vertex_id() - M < N);
+        rated.push_back(vertex.edge(e)->vertex_id() - M);
+      }
+      std::sort(rated.begin(), rated.end());
+      return;
+    }
+
     vec distances = zeros(howmany);
     ivec indices = ivec::Zero(howmany);
     for (int i=0; i< howmany; i++){
       indices[i]= -1;
     }
-    std::vector<bool> curratings;
-    curratings.resize(N);
-    for(int e=0; e < vertex.num_edges(); e++) {
-      //no need to calculate this rating since it is given in the training data reference
-      assert(vertex.edge(e)->vertex_id() - M >= 0 && vertex.edge(e)->vertex_id() - M < N);
-      curratings[vertex.edge(e)->vertex_id() - M] = true;
-    }
-    if (knn_sample_percent == 1.0){
-      for (uint i=M; i< M+N; i++){
-        if (curratings[i-M])
-          continue;
-        vertex_data & other = latent_factors_inmem[i];
-        double dist;
-        if (algo != SVD && algo != CLIMF)
-           als_predict(vdata, other, 0, dist); 
-        else if (algo == SVD)
-           svd_predict(vdata, other, 0, dist);
-        else if (algo == CLIMF)
-           climf_predict(vdata, other, 0, dist);
-        else assert(false);
-        indices[i-M] = i-M;
-        distances[i-M] = dist + 1e-10;
-      }
-    }
-    else for (int i=0; i<howmany; i++){
+    for (int i=0; i<howmany; i++){
       int random_other = ::randi(M, M+N-1);
       vertex_data & other = latent_factors_inmem[random_other];
       double dist;
@@ -280,6 +270,55 @@ struct RatingVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeD
 
 };
 
+/**
+ * Top num_ratings unrated items of every user. The predictions of all supported algorithms
+ * are monotone in the inner product of the user vector (scaled by the singular values for SVD)
+ * and the item vector, so the items are ranked by inner product and only the selected ones
+ * are passed through the prediction function.
+ */
+struct topk_users {
+  int startv;
+  void query(int u, vec & q){
+    if (algo == SVD)
+      q = latent_factors_inmem[startv + u].pvec.cwiseProduct(singular_values);
+    else q = latent_factors_inmem[startv + u].pvec;
+  }
+  const std::vector<uint> & rated(int u){
+    return rated_items[u];
+  }
+  void result(int u, const std::vector<score_id> & top){
+    vertex_data & vdata = latent_factors_inmem[startv + u];
+    vdata.ids = ivec::Ones(num_ratings) * -1;
+    vdata.ratings = zeros(num_ratings);
+    for (uint j=0; j< top.size(); j++){
+      vertex_data & other = latent_factors_inmem[M + top[j].second];
+      double dist;
+      if (algo == SVD)
+        svd_predict(vdata, other, 0, dist);
+      else if (algo == CLIMF)
+        climf_predict(vdata, other, 0, dist);
+      else als_predict(vdata, other, 0, dist);
+      vdata.ids[j] = top[j].second;
+      vdata.ratings[j] = dist;
+    }
+    if (debug && top.size() > 0)
+      printf("Closest is: %d with distance %g\n", (int)vdata.ids[0], vdata.ratings[0]);
+  }
+};
+
+void compute_topk(){
+  int startv = std::max(0, start_user);
+  int endv = std::min(M, (uint)end_user);
+  mat items(D, N);
+  for (uint i=0; i< N; i++)
+    items.col(i) = latent_factors_inmem[M + i].pvec;
+
+  topk_users users;
+  users.startv = startv;
+  recommend_topk(users, endv - startv, items, num_ratings);
+  printf("Computed recommendations for %d users at time: %g\n", endv - startv, mytimer.current_time());
+}
+
 struct  MMOutputter_ratings{
   MMOutputter_ratings(std::string fname, uint start, uint end, std::string comment)  {
     assert(start < end);
@@ -388,6 +427,8 @@ int main(int argc, const char ** argv) {
     num_ratings = N;
   }
   srand(time(NULL));
+  if (knn_sample_percent == 1.0)
+    rated_items.resize(std::min(M, (uint)end_user) - std::max(0, start_user));
 
   /* Run */
   if (tokens_per_row == 3){
@@ -402,6 +443,9 @@ int main(int argc, const char ** argv) {
     set_engine_flags(engine);
     engine.run(program, 1);
   }
+  if (knn_sample_percent == 1.0)
+    compute_topk();
+
   /* Output latent factor matrices in matrix-market format */
   output_knn_result(training);
 
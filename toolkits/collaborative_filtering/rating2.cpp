@@ -33,6 +33,7 @@
 #include "common.hpp"
 #include "eigen_wrapper.hpp"
 #include "timer.hpp"
+#include "topk_recommender.hpp"
 
 int debug;
 int num_ratings;
@@ -43,6 +44,8 @@ int algo = 0;
 uint users_without_ratings = 0;
 uint users_no_ratings = 0;
 mutex mymutex;
+bool use_topk = false; //score all items in blocks of users, see compute_topk()
+std::vector<std::vector<uint> > rated_items; //sorted rated items of each user, relative to start_user
 
 int    rbm_bins         = 6;
 double rbm_scaling      = 1;
@@ -330,6 +333,17 @@ struct RatingVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeD
        mymutex.unlock();
     }
 
+    if (use_topk){
+      std::vector<uint> & rated = rated_items[vertex.id() - std::max(start_user, 0)];
+      for(int e=0; e < vertex.num_edges(); e++) {
+        //no need to calculate this rating since it is given in the training data reference
+        assert(vertex.edge(e)->vertex_id() - M >= 0 && vertex.edge(e)->vertex_id() - M < N);
+        rated.push_back(vertex.edge(e)->vertex_id() - M);
+      }
+      std::sort(rated.begin(), rated.end());
+      return;
+    }
+
     vec distances = zeros(howmany);
     ivec indices = ivec::Zero(howmany);
     for (int i=0; i< howmany; i++){
@@ -390,6 +404,57 @@ struct RatingVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeD
 
 };
 
+/**
+ * Top num_ratings unrated items of every user for SVD++ and bias-SGD. Up to the user bias and
+ * the global mean, which do not change the order of the items of a user, the prediction is the
+ * inner product of [p_u (+ y_u for SVD++), 1] and [q_i, b_i]. The RBM prediction is not of this
+ * form and is computed item by item in the update function.
+ */
+struct topk_users {
+  int startv;
+  void query(int u, vec & q){
+    vertex_data & user = latent_factors_inmem[startv + u];
+    if (algo == SVDPP)
+      q.head(D) = user.pvec + user.weight;
+    else q.head(D) = user.pvec;
+    q[D] = 1;
+  }
+  const std::vector<uint> & rated(int u){
+    return rated_items[u];
+  }
+  void result(int u, const std::vector<score_id> & top){
+    vertex_data & vdata = latent_factors_inmem[startv + u];
+    vdata.ids = ivec::Ones(num_ratings) * -1;
+    vdata.ratings = zeros(num_ratings);
+    for (uint j=0; j< top.size(); j++){
+      vertex_data & other = latent_factors_inmem[M + top[j].second];
+      double dist;
+      if (algo == SVDPP)
+        svdpp_predict(vdata, other, 0, dist);
+      else biassgd_predict(vdata, other, 0, dist);
+      vdata.ids[j] = top[j].second;
+      vdata.ratings[j] = dist;
+    }
+    if (debug && top.size() > 0)
+      printf("Closest is: %d with distance %g\n", (int)vdata.ids[0], vdata.ratings[0]);
+  }
+};
+
+void compute_topk(){
+  int startv = std::max(0, start_user);
+  int endv = std::min(M, (uint)end_user);
+  mat items(D+1, N);
+  for (uint i=0; i< N; i++){
+    items.col(i).head(D) = latent_factors_inmem[M + i].pvec;
+    items(D, i) = latent_factors_inmem[M + i].bias;
+  }
+
+  topk_users users;
+  users.startv = startv;
+  recommend_topk(users, endv - startv, items, num_ratings);
+  printf("Computed recommendations for %d users at time: %g\n", endv - startv, mytimer.current_time());
+}
+
 struct  MMOutputter_ratings{
   MMOutputter_ratings(std::string fname, uint start, uint end, std::string comment)  {
     assert(start < end);
@@ -513,6 +578,9 @@ int main(int argc, const char ** argv) {
     num_ratings = N;
   }
   srand(time(NULL));
+  use_topk = knn_sample_percent == 1.0 && algo != RBM;
+  if (use_topk)
+    rated_items.resize(std::min(M, (uint)end_user) - std::max(0, start_user));
 
   /* Run */
   if (tokens_per_row == 3){
@@ -527,6 +595,9 @@ int main(int argc, const char ** argv) {
     set_engine_flags(engine);
     engine.run(program, 1);
   }
+  if (use_topk)
+    compute_topk();
+
   /* Output latent factor matrices in matrix-market format */
   output_knn_result(training);
 
@@ -30,6 +30,7 @@
 #include "timer.hpp"
 #include "eigen_wrapper.hpp"
 #include "common.hpp"
+#include "mm_reader.hpp"
 void read_matrix_market_banner_and_size(FILE * pfile, MM_typecode & matcode, uint & M, uint & N, size_t & nz, const std::string & filename);
 FILE * open_file(const char * filename, const char * mode, bool optional);
 
@@ -124,15 +125,14 @@ void test_predictions(float (*prediction_func)(const vertex_data & user, const v
     mm_write_mtx_crd_size(fout ,M,N,test_ratings); 
   }
 
+  mm_entry_reader reader(f, nz, 3, test);
+  const double * entry;
   for (uint i=0; i<nz; i++)
   {
-    int I, J;
-    double val;
-    int rc = fscanf(f, "%d %d %lg\n", &I, &J, &val);
-    if (rc != 3)
-      logstream(LOG_FATAL)<<"Error when reading input test file, on data line " << i+2 << std::endl;
-    I--;  /* adjust from 1-based to 0-based */
-    J--;
+    reader.next(entry);
+    int I = (int)entry[0] - 1;  /* adjust from 1-based to 0-based */
+    int J = (int)entry[1] - 1;
+    double val = entry[2];
 
     if (I < 0 || (uint)I >= M)
        logstream(LOG_FATAL)<<"Bad input " << I+1<< " in test file in line " << i+2<< " . First column should be in the range 1 to " << M << std::endl;
@@ -182,18 +182,16 @@ void test_predictions3(float (*prediction_func)(const vertex_data & user, const
   mm_write_banner(fout, matcode);
   mm_write_mtx_crd_size(fout ,M,N,nz); 
 
+  mm_entry_reader reader(f, nz, 4, test);
+  const double * entry;
   for (uint i=0; i<nz; i++)
   {
-    int I, J;
-    double val;
-    int time;
-    int rc = fscanf(f, "%d %d %d %lg\n", &I, &J, &time, &val);
-    if (rc != 4)
-      logstream(LOG_FATAL)<<"Error when reading input file: " << i << std::endl;
+    reader.next(entry);
+    int I = (int)entry[0] - 1;  /* adjust from 1-based to 0-based */
+    int J = (int)entry[1] - 1;
+    int time = (int)entry[2];
     if (time - input_file_offset < 0)
       logstream(LOG_FATAL)<<"Error: we assume time values >= " << input_file_offset << std::endl;
-    I--;  /* adjust from 1-based to 0-based */
-    J--;
     double prediction;
     (*prediction_func)(latent_factors_inmem[I], latent_factors_inmem[J+M], 1, prediction, (void*)&latent_factors_inmem[time+M+N-input_file_offset]);
     fprintf(fout, "%d %d %12.8lg\n", I+1, J+1, prediction);
@@ -232,16 +230,19 @@ void validation_rmse(float (*prediction_func)(const vertex_data & user, const ve
   dvalidation_rmse = 0;   
   int I, J;
   double val, time = 1.0;
+  mm_entry_reader reader(f, nz, tokens_per_row, validation);
+  const double * entry;
 
   for (size_t i=0; i<nz; i++)
   {
-    int rc;
+    reader.next(entry);
+    I = (int)entry[0]; J = (int)entry[1];
     if (tokens_per_row == 3)
-      rc = fscanf(f, "%d %d %lg\n", &I, &J, &val);
-    else rc = fscanf(f, "%d %d %lg %lg\n", &I, &J, &time, &val);
-
-    if (rc != tokens_per_row)
-      logstream(LOG_FATAL)<<"Error when reading input file on line: " << i << " . should have" << tokens_per_row << std::endl;
+      val = entry[2];
+    else {
+      time = entry[2];
+      val = entry[3];
+    }
     if (val < minval || val > maxval)
       logstream(LOG_FATAL)<<"Value is out of range: " << val << " should be: " << minval << " to " << maxval << std::endl;
     I--;  /* adjust from 1-based to 0-based */
@@ -288,15 +289,15 @@ void validation_rmse3(float (*prediction_func)(const vertex_data & user, const v
   dvalidation_rmse = 0;   
   int I, J;
   double val, time = 1.0;
+  mm_entry_reader reader(f, nz, 4, validation);
+  const double * entry;
 
   for (size_t i=0; i<nz; i++)
   {
-    int rc;
-    rc = fscanf(f, "%d %d %lg %lg\n", &I, &J, &time, &val);
-    time -= time_offset;
-
-    if (rc != 4)
-      logstream(LOG_FATAL)<<"Error when reading input file on line: " << i << " . should have 4 columns " << std::endl;
+    reader.next(entry);
+    I = (int)entry[0]; J = (int)entry[1];
+    time = entry[2] - time_offset;
+    val = entry[3];
     if (val < minval || val > maxval)
       logstream(LOG_FATAL)<<"Value is out of range: " << val << " should be: " << minval << " to " << maxval << std::endl;
     if ((uint)time > K)
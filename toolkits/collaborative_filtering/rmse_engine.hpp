@@ -24,6 +24,8 @@
  * File for aggregating and siplaying error mesasures and algorithm progress
  */
 
+#include "validation_cache.hpp"
+
 float (*pprediction_func)(const vertex_data&, const vertex_data&, const float, double &, void *) = NULL;
 vec validation_rmse_vec;
 vec users_vec;
@@ -32,6 +34,29 @@ bool user_nodes = true;
 int num_threads = 1;
 bool converged_engine = false;
 int cur_iteration = 0;
+validation_cache<EdgeDataType> validation_edges;
+
+/**
+ * Average precision of the top ap_number predictions of a single user
+ */
+double average_precision(const vec & ratings, const vec & real_vals){
+  int real_click_count = 0;
+  for (int j=0; j< real_vals.size(); j++)
+    if (real_vals[j] > 0)
+      real_click_count++;
+  int count = 0;
+  double ap = 0;
+  ivec pos = sort_index(ratings);
+  for (int j=0; j< std::min(ap_number, (int)ratings.size()); j++){
+    if (real_vals[pos[ratings.size() - j - 1]] > 0)
+      ap += (++count * 1.0/(j+1));    
+  }
+  if (real_click_count > 0 )
+    ap /= real_click_count;
+  else ap = 0;
+  return ap;
+}
+
 /**
  * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type> 
  * class. The main logic is usually in the update function.
@@ -52,30 +77,15 @@ struct ValidationAPProgram : public GraphChiProgram<VertexDataType, EdgeDataType
     vec real_vals = zeros(vertex.num_outedges());
     if (ratings.size() > 0){
       users_vec[omp_get_thread_num()]++;
-      int j=0;
-      int real_click_count = 0;
       for(int e=0; e < vertex.num_outedges(); e++) {
         const EdgeDataType & observation = vertex.edge(e)->get_data();                
         vertex_data & pdata = latent_factors_inmem[vertex.edge(e)->vertex_id()];
         double prediction;
         (*pprediction_func)(vdata, pdata, observation, prediction, NULL);
-        ratings[j] = prediction;
-        real_vals[j] = observation;
-        if (observation > 0)
-          real_click_count++;
-        j++;
-      }
-      int count = 0;
-      double ap = 0;
-      ivec pos = sort_index(ratings);
-      for (int j=0; j< std::min(ap_number, (int)ratings.size()); j++){
-        if (real_vals[pos[ratings.size() - j - 1]] > 0)
-          ap += (++count * 1.0/(j+1));    
+        ratings[e] = prediction;
+        real_vals[e] = observation;
       }
-      if (real_click_count > 0 )
-        ap /= real_click_count;
-      else ap = 0;
-      sum_ap_vec[omp_get_thread_num()] += ap;
+      sum_ap_vec[omp_get_thread_num()] += average_precision(ratings, real_vals);
     }
   }
   void before_iteration(int iteration, graphchi_context & gcontext){
@@ -161,6 +171,55 @@ void init_validation_rmse_engine(graphchi_engine<VertexDataType,EdgeDataType> *&
   pprediction_func = prediction_func;
 }
 
+/**
+ * Validation over the in memory validation ratings, reported by the same
+ * before_iteration() and after_iteration() functions as the validation programs.
+ */
+void run_cached_validation(graphchi_context & context){
+  int ngroups = validation_edges.groups();
+  if (calc_ap){
+    ValidationAPProgram program;
+    program.before_iteration(context.iteration, context);
+    double users = 0, sum_ap = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:users,sum_ap)
+    for (int g=0; g< ngroups; g++){
+      size_t st = validation_edges.starts[g], cnt = validation_edges.starts[g+1] - st;
+      vertex_data & vdata = latent_factors_inmem[validation_edges.entries[st].node];
+      vec ratings = zeros(cnt);
+      vec real_vals = zeros(cnt);
+      for (size_t e=0; e< cnt; e++){
+        const validation_cache<EdgeDataType>::entry & ent = validation_edges.entries[st + e];
+        double prediction;
+        (*pprediction_func)(vdata, latent_factors_inmem[ent.nbr], ent.obs, prediction, NULL);
+        ratings[e] = prediction;
+        real_vals[e] = ent.obs;
+      }
+      users++;
+      sum_ap += average_precision(ratings, real_vals);
+    }
+    users_vec[0] += users;
+    sum_ap_vec[0] += sum_ap;
+    program.after_iteration(context.iteration, context);
+  }
+  else {
+    ValidationRMSEProgram program;
+    program.before_iteration(context.iteration, context);
+    double err = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:err)
+    for (int g=0; g< ngroups; g++){
+      size_t st = validation_edges.starts[g], en = validation_edges.starts[g+1];
+      vertex_data & vdata = latent_factors_inmem[validation_edges.entries[st].node];
+      for (size_t e=st; e< en; e++){
+        const validation_cache<EdgeDataType>::entry & ent = validation_edges.entries[e];
+        double prediction;
+        err += (*pprediction_func)(vdata, latent_factors_inmem[ent.nbr], ent.obs, prediction, NULL);
+      }
+    }
+    validation_rmse_vec[0] += err;
+    program.after_iteration(context.iteration, context);
+  }
+}
+
 template<typename VertexDataType, typename EdgeDataType>
 void run_validation(graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine, graphchi_context & context){
   //no validation data, no need to run validation engine calculations
@@ -169,7 +228,10 @@ void run_validation(graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_
     std::cout << std::endl;
     return;
   }
-  if (calc_ap){ //AP
+  if (validation_edges.load(*pvalidation_engine, user_nodes)){
+    run_cached_validation(context);
+  }
+  else if (calc_ap){ //AP
     ValidationAPProgram program;
     pvalidation_engine->run(program, 1);
   }
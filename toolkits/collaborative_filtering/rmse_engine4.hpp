@@ -24,6 +24,8 @@
  * File for aggregating and siplaying error mesasures and algorithm progress
  */
 
+#include "validation_cache.hpp"
+
 float (*pprediction_func)(const vertex_data&, const vertex_data&, const float, double &, void *) = NULL;
 vec validation_rmse_vec;
 bool user_nodes = true;
@@ -34,6 +36,7 @@ int matlab_time_offset = 0;
 int num_threads = 1;
 bool converged_engine = false;
 int cur_iteration = 0;
+validation_cache<EdgeDataType> validation_edges;
 /**
  * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type> 
  * class. The main logic is usually in the update function.
@@ -102,6 +105,37 @@ void init_validation_rmse_engine(graphchi_engine<VertexDataType,EdgeDataType> *&
 
 
 
+/**
+ * Validation over the in memory validation ratings, see validation_cache.hpp
+ */
+void run_cached_validation4(graphchi_context & context){
+  ValidationRMSEProgram4 program;
+  program.before_iteration(context.iteration, context);
+  int ngroups = validation_edges.groups();
+  double err = 0;
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:err)
+  for (int g=0; g< ngroups; g++){
+    size_t st = validation_edges.starts[g], en = validation_edges.starts[g+1];
+    vertex_data & vdata = latent_factors_inmem[validation_edges.entries[st].node];
+    for (size_t e=st; e< en; e++){
+      const validation_cache<EdgeDataType>::entry & ent = validation_edges.entries[e];
+      uint time = (uint)ent.obs.time;
+      vertex_data * time_node = NULL;
+      if (time_nodes){
+        assert(time >= time_nodes_offset && time < time_nodes_offset+K);
+        time_node = &latent_factors_inmem[time];
+      }
+      double prediction;
+      double rmse = (*pprediction_func)(vdata, latent_factors_inmem[ent.nbr], ent.obs.weight, prediction, (void*)time_node);
+      if (time_weighting)
+        rmse *= ent.obs.time;
+      err += rmse;
+    }
+  }
+  validation_rmse_vec[0] += err;
+  program.after_iteration(context.iteration, context);
+}
+
 template<typename VertexDataType, typename EdgeDataType>
 void run_validation4(graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine, graphchi_context & context){
    //no validation data, no need to run validation engine calculations
@@ -110,8 +144,12 @@ void run_validation4(graphchi_engine<VertexDataType, EdgeDataType> * pvalidation
      std::cout << std::endl;
      return;
    }
-   ValidationRMSEProgram4 program;
-   pvalidation_engine->run(program, 1);
+   if (validation_edges.load(*pvalidation_engine, user_nodes))
+     run_cached_validation4(context);
+   else {
+     ValidationRMSEProgram4 program;
+     pvalidation_engine->run(program, 1);
+   }
    if (converged_engine)
      context.set_last_iteration(cur_iteration);
 }
@@ -27,6 +27,50 @@ else
   echo "FAIL TEST 2 (Weighted Alternating least squares)"| tee -a $stdoutfname
 fi
 
+echo "---------DSGD-------------" | tee -a $stdoutfname
+# more execution threads than cores
+./sgd --training=unittest/dsgd.unittest --dsgd=1 --execthreads=16 --max_iter=3 --quiet=1 --clean_cache=1 >> $stdoutfname 2>& 1
+if [ $? -eq 0 ]; then
+  echo "PASS TEST 3 (Stratified SGD with --execthreads=16)"| tee -a $stdoutfname
+else
+  somefailed=1
+  echo "FAIL TEST 3 (Stratified SGD with --execthreads=16)"| tee -a $stdoutfname
+fi
+! ./sgd --training=unittest/dsgd.unittest --dsgd=1 --dsgd_blocks=0 --max_iter=3 --quiet=1 --clean_cache=1 >> $stdoutfname 2>& 1
+if [ $? -eq 0 ]; then
+  echo "PASS TEST 4 (Stratified SGD rejects --dsgd_blocks=0)"| tee -a $stdoutfname
+else
+  somefailed=1
+  echo "FAIL TEST 4 (Stratified SGD rejects --dsgd_blocks=0)"| tee -a $stdoutfname
+fi
+
+echo "---------BINARY FACTORS-------------" | tee -a $stdoutfname
+# factors loaded from the binary files and saved again without training must not change
+./sgd --training=unittest/dsgd.unittest --binary_factors=1 --max_iter=3 --quiet=1 --clean_cache=1 >> $stdoutfname 2>& 1 &&
+  cp unittest/dsgd.unittest_U.bin unittest/dsgd.unittest_U.bin.orig &&
+  cp unittest/dsgd.unittest_V.bin unittest/dsgd.unittest_V.bin.orig &&
+  ./sgd --training=unittest/dsgd.unittest --binary_factors=1 --load_factors_from_file=1 --max_iter=0 --quiet=1 >> $stdoutfname 2>& 1 &&
+  cmp unittest/dsgd.unittest_U.bin unittest/dsgd.unittest_U.bin.orig &&
+  cmp unittest/dsgd.unittest_V.bin unittest/dsgd.unittest_V.bin.orig
+if [ $? -eq 0 ]; then
+  echo "PASS TEST 5 (Binary factor file round trip)"| tee -a $stdoutfname
+else
+  somefailed=1
+  echo "FAIL TEST 5 (Binary factor file round trip)"| tee -a $stdoutfname
+fi
+
+echo "---------VALIDATION CACHE-------------" | tee -a $stdoutfname
+# nested parallelism gives the update threads ids up to --execthreads
+cp unittest/dsgd.unittest unittest/dsgd.unittest_validation
+OMP_MAX_ACTIVE_LEVELS=2 ./sgd --training=unittest/dsgd.unittest --validation=unittest/dsgd.unittest_validation --execthreads=16 --max_iter=3 --quiet=1 --clean_cache=1 >> $stdoutfname 2>& 1
+if [ $? -eq 0 ]; then
+  echo "PASS TEST 6 (Cached validation with --execthreads=16)"| tee -a $stdoutfname
+else
+  somefailed=1
+  echo "FAIL TEST 6 (Cached validation with --execthreads=16)"| tee -a $stdoutfname
+fi
+rm -fR unittest/dsgd.unittest.* unittest/dsgd.unittest_*
+
 if [ $somefailed == 1 ]; then
   echo "**** FAILURE LOG **************" >> $stdoutfname
   echo `date` >> $stdoutfname
@@ -33,16 +33,16 @@
 
 #include "eigen_wrapper.hpp"
 #include "common.hpp"
+#include "factor_store.hpp"
 
 double sgd_lambda = 1e-3; //sgd regularization
 double sgd_gamma = 1e-3;  //sgd step size
 double sgd_step_dec = 0.9; //sgd step decrement
 
 struct vertex_data {
-  vec pvec; //storing the feature vector
+  vec_view pvec; //storing the feature vector
 
-  vertex_data() {
-    pvec = zeros(D);
+  vertex_data() : pvec(NULL, 0) {
   }
   void set_val(int index, float val){
     pvec[index] = val;
@@ -65,10 +65,12 @@ typedef float EdgeDataType;  // Edges store the "rating" of user->movie pair
 graphchi_engine<VertexDataType, EdgeDataType> * pengine = NULL; 
 graphchi_engine<VertexDataType, EdgeDataType> * pvalidation_engine = NULL; 
 std::vector<vertex_data> latent_factors_inmem;
+factor_store latent_factors_store;
 
 #include "rmse.hpp"
 #include "rmse_engine.hpp"
 #include "io.hpp"
+#include "dsgd.hpp"
 
 /** compute a missing value based on SGD algorithm */
 float sgd_predict(const vertex_data& user, 
@@ -90,6 +92,22 @@ float sgd_predict(const vertex_data& user,
 
 }
 
+/** SGD step on a single rating, returns the squared error */
+double sgd_update(vertex_data & user, vertex_data & movie, float observation){
+  double estScore;
+  double sqerr = sgd_predict(user, movie, observation, estScore);
+  double err = observation - estScore;
+  if (std::isnan(err) || std::isinf(err))
+    logstream(LOG_FATAL)<<"SGD got into numerical error. Please tune step size using --sgd_gamma and sgd_lambda" << std::endl;
+  //NOTE: in the vertex-centric mode the following code is not thread safe, since potentially several
+  //user nodes may updates this item gradient vector concurrently. However in practice it
+  //did not matter in terms of accuracy on a multicore machine.
+  //Use --dsgd=1 for conflict free parallel updates.
+  axpby(sgd_gamma*err, user.pvec, 1 - sgd_gamma*sgd_lambda, movie.pvec);
+  axpby(sgd_gamma*err, movie.pvec, 1 - sgd_gamma*sgd_lambda, user.pvec);
+  return sqerr;
+}
+
 
 /**
  * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type> 
@@ -110,8 +128,8 @@ struct SGDVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
    * Called after an iteration has finished.
    */
   void after_iteration(int iteration, graphchi_context &gcontext) {
-    sgd_gamma *= sgd_step_dec;
     training_rmse(iteration, gcontext);
+    sgd_gamma = next_step_size(iteration, sgd_gamma, sgd_step_dec);
     run_validation(pvalidation_engine, gcontext);
   }
 
@@ -126,21 +144,7 @@ struct SGDVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
       for(int e=0; e < vertex.num_edges(); e++) {
         float observation = vertex.edge(e)->get_data();                
         vertex_data & movie = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-        double estScore;
-        rmse_vec[omp_get_thread_num()] += sgd_predict(user, movie, observation, estScore);
-        double err = observation - estScore;
-        if (std::isnan(err) || std::isinf(err))
-          logstream(LOG_FATAL)<<"SGD got into numerical error. Please tune step size using --sgd_gamma and sgd_lambda" << std::endl;
-        //NOTE: the following code is not thread safe, since potentially several
-        //user nodes may updates this item gradient vector concurrently. However in practice it
-        //did not matter in terms of accuracy on a multicore machine.
-        //if you like to defend the code, you can define a global variable
-        //mutex mymutex;
-        //
-        //and then do: mymutex.lock()
-        movie.pvec += sgd_gamma*(err*user.pvec - sgd_lambda*movie.pvec);
-        //and here add: mymutex.unlock();
-        user.pvec += sgd_gamma*(err*movie.pvec - sgd_lambda*user.pvec);
+        rmse_vec[omp_get_thread_num()] += sgd_update(user, movie, observation);
       }
     }
 
@@ -180,10 +184,11 @@ int main(int argc, const char ** argv) {
 
   parse_command_line_args();
   parse_implicit_command_line();
+  parse_step_schedule(sgd_gamma);
 
   /* Preprocess data if needed, or discover preprocess files */
   int nshards = convert_matrixmarket<EdgeDataType>(training, 0, 0, 3, TRAINING, false);
-  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_inmem, !load_factors_from_file);
+  init_feature_vectors<std::vector<vertex_data> >(M+N, latent_factors_store, latent_factors_inmem, !load_factors_from_file);
   if (validation != ""){
     int vshards = convert_matrixmarket<EdgeDataType>(validation, 0, 0, 3, VALIDATION, false);
     init_validation_rmse_engine<VertexDataType, EdgeDataType>(pvalidation_engine, vshards, &sgd_predict);
@@ -202,7 +207,9 @@ int main(int argc, const char ** argv) {
   graphchi_engine<VertexDataType, EdgeDataType> engine(training, nshards, false, m); 
   set_engine_flags(engine);
   pengine = &engine;
-  engine.run(program, niters);
+  if (get_option_int("dsgd", 0))
+    run_dsgd(engine, program, &sgd_update, niters);
+  else engine.run(program, niters);
 
   /* Output latent factor matrices in matrix-market format */
   output_sgd_result(training);
@@ -32,6 +32,7 @@
 #include "cosamp.hpp"
 #include "eigen_wrapper.hpp"
 #include "common.hpp"
+#include "normal_equations.hpp"
 
 double lambda = 0.065;
 
@@ -109,16 +110,18 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
    */
   void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
     vertex_data & vdata = latent_factors_inmem[vertex.id()];
-    mat XtX = mat::Zero(D, D); 
-    vec Xty = vec::Zero(D);
+    bool isuser = vertex.id() < (uint)M;
+    bool sparse = algorithm == SPARSE_BOTH_FACTORS || (algorithm == SPARSE_USR_FACTOR && isuser) || 
+        (algorithm == SPARSE_ITM_FACTOR && !isuser);
+    normal_equations & eq = thread_normal_equations();
+    eq.reset(vertex.num_edges(), !sparse);
 
     bool compute_rmse = (vertex.num_outedges() > 0);
     // Compute XtX and Xty (NOTE: unweighted)
     for(int e=0; e < vertex.num_edges(); e++) {
       float observation = vertex.edge(e)->get_data();                
       vertex_data & nbr_latent = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-      Xty += nbr_latent.pvec * observation;
-      XtX += nbr_latent.pvec * nbr_latent.pvec.transpose();
+      eq.add(nbr_latent.pvec, observation);
       if (compute_rmse) {
         double prediction;
         rmse_vec[omp_get_thread_num()] += sparse_als_predict(vdata, nbr_latent, observation, prediction);
@@ -128,19 +131,17 @@ struct ALSVerticesInMemProgram : public GraphChiProgram<VertexDataType, EdgeData
     double regularization = lambda;
     if (regnormal)
       regularization *= vertex.num_edges();
-    for(int i=0; i < D; i++) XtX(i,i) += regularization;
 
 
-    bool isuser = vertex.id() < (uint)M;
-    if (algorithm == SPARSE_BOTH_FACTORS || (algorithm == SPARSE_USR_FACTOR && isuser) || 
-        (algorithm == SPARSE_ITM_FACTOR && !isuser)){ 
+    if (sparse){ 
       double sparsity_level = 1.0;
       if (isuser)
         sparsity_level -= user_sparsity;
       else sparsity_level -= movie_sparsity;
-      vdata.pvec = CoSaMP(XtX, Xty, (int)ceil(sparsity_level*(double)D), 10, 1e-4, D); 
+      mat XtX = eq.system(regularization);
+      vdata.pvec = CoSaMP(XtX, eq.Xty, (int)ceil(sparsity_level*(double)D), 10, 1e-4, D); 
     }
-    else vdata.pvec = XtX.selfadjointView<Eigen::Upper>().ldlt().solve(Xty);
+    else eq.solve(regularization, vdata.pvec);
   }
 
  /**
@@ -189,6 +190,7 @@ int main(int argc, const char ** argv) {
 
   parse_command_line_args();
   parse_implicit_command_line(); 
+  init_normal_equations();
 
   if (user_sparsity < 0.5 || user_sparsity >= 1)
     logstream(LOG_FATAL)<<"Sparsity level should be [0.5,1). Please run again using --user_sparsity=XX in this range" << std::endl;
@@ -0,0 +1,241 @@
+#ifndef _TOPK_RECOMMENDER_HPP__
+#define _TOPK_RECOMMENDER_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Top K items by inner product score q_u * v_i for many users (maximum inner product search).
+ * Any model whose prediction is a monotone function of such an inner product can be served
+ * this way; biases are handled by appending them to the query and item vectors.
+ *
+ * Exact search scores a block of --topk_user_block users against a chunk of items with one
+ * matrix-matrix product, and keeps the best K unrated items of each user in a min-heap.
+ * The items a user rated are skipped by walking the sorted list of rated items along the
+ * item ids, so no per user bitmap of N items is needed.
+ *
+ * With --mips_clusters=C the items are clustered with k-means and each user scores the
+ * clusters in the order of the bound q*c + |q|*r (c the centroid, r the cluster radius),
+ * which no item of the cluster can exceed. A cluster is skipped when its bound cannot enter
+ * the top K, and at most --mips_probe clusters (default 8) are scanned, which makes the search
+ * sub-linear but approximate. With mips_probe >= C the result is exact.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <omp.h>
+#include "eigen_wrapper.hpp"
+#include "common.hpp"
+
+typedef std::pair<double,int> score_id;
+
+class topk_recommender {
+  mat V;                          // item vectors, one per column
+  int nclusters;
+  int nprobe;
+  mat centroids;                  // one per column
+  vec radius;
+  std::vector<int> cluster_start; // items of cluster c are Vc.cols(cluster_start[c] .. cluster_start[c+1])
+  std::vector<int> item_of;       // item id of each column of Vc
+  mat Vc;                         // item vectors ordered by cluster
+
+  /* Offer a candidate to a min-heap of at most K entries */
+  static inline void offer(std::vector<score_id> & heap, int K, double score, int id){
+    if ((int)heap.size() < K){
+      heap.push_back(score_id(score, id));
+      std::push_heap(heap.begin(), heap.end(), std::greater<score_id>());
+    }
+    else if (score > heap.front().first){
+      std::pop_heap(heap.begin(), heap.end(), std::greater<score_id>());
+      heap.back() = score_id(score, id);
+      std::push_heap(heap.begin(), heap.end(), std::greater<score_id>());
+    }
+  }
+
+  /* Best first order of a heap */
+  static void finish(std::vector<score_id> & heap){
+    std::sort_heap(heap.begin(), heap.end(), std::greater<score_id>());
+  }
+
+  void query_index(const vec & q, const std::vector<uint> & rated, int K, std::vector<score_id> & heap){
+    double qnorm = q.norm();
+    vec bounds = centroids.transpose() * q + qnorm * radius;
+    std::vector<score_id> order(nclusters);
+    for (int c=0; c< nclusters; c++)
+      order[c] = score_id(bounds[c], c);
+    int probe = std::min(nprobe, nclusters);
+    std::partial_sort(order.begin(), order.begin() + probe, order.end(), std::greater<score_id>());
+    for (int k=0; k< probe; k++){
+      if ((int)heap.size() == K && order[k].first <= heap.front().first)
+        break;
+      int c = order[k].second;
+      int st = cluster_start[c], cnt = cluster_start[c+1] - st;
+      if (cnt == 0)
+        continue;
+      vec scores = Vc.middleCols(st, cnt).transpose() * q;
+      for (int j=0; j< cnt; j++){
+        if (std::binary_search(rated.begin(), rated.end(), (uint)item_of[st + j]))
+          continue;
+        offer(heap, K, scores[j], item_of[st + j]);
+      }
+    }
+  }
+
+  public:
+  topk_recommender() : nclusters(0), nprobe(0) { }
+
+  /**
+   * Item vectors, one per column. The matrix is taken over (items is left empty).
+   */
+  void set_items(mat & items){
+    V.swap(items);
+  }
+
+  /**
+   * Cluster the items into C clusters with a few rounds of k-means.
+   */
+  void build_index(int C, int probe, int rounds = 5){
+    int N = V.cols();
+    nclusters = std::max(1, std::min(C, N));
+    nprobe = probe;
+    centroids.resize(V.rows(), nclusters);
+    for (int c=0; c< nclusters; c++)
+      centroids.col(c) = V.col((int)(((long)c * N) / nclusters));
+
+    std::vector<int> assign(N, 0);
+    for (int round=0; round <= rounds; round++){
+      vec cnorm = centroids.colwise().squaredNorm().transpose();
+#pragma omp parallel for
+      for (int i=0; i< N; i++){
+        vec d = cnorm - 2 * centroids.transpose() * V.col(i);
+        int best;
+        d.minCoeff(&best);
+        assign[i] = best;
+      }
+      if (round == rounds)
+        break;
+      mat sum = mat::Zero(V.rows(), nclusters);
+      std::vector<int> cnt(nclusters, 0);
+      for (int i=0; i< N; i++){
+        sum.col(assign[i]) += V.col(i);
+        cnt[assign[i]]++;
+      }
+      for (int c=0; c< nclusters; c++)
+        if (cnt[c] > 0)
+          centroids.col(c) = sum.col(c) / cnt[c];
+    }
+
+    cluster_start.assign(nclusters + 1, 0);
+    for (int i=0; i< N; i++)
+      cluster_start[assign[i] + 1]++;
+    for (int c=0; c< nclusters; c++)
+      cluster_start[c+1] += cluster_start[c];
+    std::vector<int> pos(cluster_start.begin(), cluster_start.end() - 1);
+    item_of.resize(N);
+    Vc.resize(V.rows(), N);
+    radius = vec::Zero(nclusters);
+    for (int i=0; i< N; i++){
+      int j = pos[assign[i]]++;
+      item_of[j] = i;
+      Vc.col(j) = V.col(i);
+      radius[assign[i]] = std::max(radius[assign[i]], (V.col(i) - centroids.col(assign[i])).norm());
+    }
+    mat().swap(V);
+    logstream(LOG_INFO)<<"MIPS index with " << nclusters << " clusters, probing " << nprobe << std::endl;
+  }
+
+  /**
+   * Top K unrated items of users 0 .. nusers-1. The users are served through Users:
+   * users.query(u, q) writes the query vector of user u to q, users.rated(u) is the sorted
+   * list of items user u rated, and users.result(u, top) receives the top K of user u, best
+   * first (called concurrently for different users). The query vectors and the heaps are
+   * built one block of users at a time, so they are never held for all users at once.
+   */
+  template<typename Users>
+  void recommend(Users & users, int nusers, int K, int user_block = 256, int item_chunk = 4096){
+    int dim = nclusters > 0 ? Vc.rows() : V.rows();
+    int nblocks = (nusers + user_block - 1) / user_block;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int b=0; b< nblocks; b++){
+      int ust = b * user_block, ucnt = std::min(user_block, nusers - ust);
+      vec q(dim);
+      std::vector<score_id> heap;
+      if (nclusters > 0){
+        for (int u=ust; u< ust + ucnt; u++){
+          heap.clear();
+          users.query(u, q);
+          query_index(q, users.rated(u), K, heap);
+          finish(heap);
+          users.result(u, heap);
+        }
+        continue;
+      }
+
+      mat Q(dim, ucnt);
+      for (int u=0; u< ucnt; u++){
+        users.query(ust + u, q);
+        Q.col(u) = q;
+      }
+      int N = V.cols();
+      std::vector<std::vector<score_id> > heaps(ucnt);
+      std::vector<size_t> skip(ucnt, 0); // position in the rated list of each user
+      for (int ist=0; ist< N; ist+= item_chunk){
+        int icnt = std::min(item_chunk, N - ist);
+        mat S = V.middleCols(ist, icnt).transpose() * Q; // icnt x ucnt
+        for (int u=0; u< ucnt; u++){
+          const std::vector<uint> & r = users.rated(ust + u);
+          std::vector<score_id> & h = heaps[u];
+          size_t & s = skip[u];
+          for (int i=0; i< icnt; i++){
+            while (s < r.size() && r[s] < (uint)(ist + i))
+              s++;
+            if (s < r.size() && r[s] == (uint)(ist + i))
+              continue;
+            offer(h, K, S(i, u), ist + i);
+          }
+        }
+      }
+      for (int u=0; u< ucnt; u++){
+        finish(heaps[u]);
+        users.result(ust + u, heaps[u]);
+      }
+    }
+  }
+};
+
+/**
+ * Top K of each user with the options --mips_clusters, --mips_probe and --topk_user_block.
+ * See topk_recommender::recommend() for Users.
+ */
+template<typename Users>
+void recommend_topk(Users & users, int nusers, mat & items, int K){
+  topk_recommender topk;
+  topk.set_items(items);
+  int clusters = get_option_int("mips_clusters", 0);
+  if (clusters > 0)
+    topk.build_index(clusters, get_option_int("mips_probe", 8));
+  int user_block = get_option_int("topk_user_block", 256);
+  if (user_block <= 0)
+    logstream(LOG_FATAL)<<"--topk_user_block should be positive" << std::endl;
+  topk.recommend(users, nusers, K, user_block);
+}
+
+#endif //_TOPK_RECOMMENDER_HPP__
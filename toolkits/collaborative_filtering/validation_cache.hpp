@@ -0,0 +1,126 @@
+#ifndef _VALIDATION_CACHE_HPP__
+#define _VALIDATION_CACHE_HPP__
+/**
+ * @file
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * Copyright [2012] [Carnegie Mellon University]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * In memory copy of the validation ratings.
+ *
+ * The first validation reads the edges once from the validation shards into an array of
+ * (node, neighbor, observation) entries, sorted by node and then neighbor so that the
+ * factors of a node are reused across its entries and the neighbor factors are read in
+ * increasing order. Later validations compute the error directly over this array in parallel,
+ * instead of running a graphchi engine over the validation shards in every iteration.
+ * The cache is used only if the validation set fits in --validation_cache_mb megabytes
+ * (default 1024, 0 disables it); otherwise validation stays disk based.
+ *
+ * Must be included after the VertexDataType typedef of the application.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+#include "common.hpp"
+
+template<typename EdgeDataType>
+class validation_cache {
+  public:
+  struct entry {
+    uint node;
+    uint nbr;
+    EdgeDataType obs;
+    entry(){}
+    entry(uint node, uint nbr, const EdgeDataType & obs) : node(node), nbr(nbr), obs(obs) { }
+    bool operator<(const entry & o) const {
+      return node < o.node || (node == o.node && nbr < o.nbr);
+    }
+  };
+
+  std::vector<entry> entries;
+  std::vector<size_t> starts;   // entries of node group g are [starts[g], starts[g+1])
+
+  private:
+  std::vector<std::vector<entry> > thread_entries;
+  bool tried;
+  bool ready;
+
+  struct CollectProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+    validation_cache * cache;
+    bool user_nodes;
+    void before_iteration(int iteration, graphchi_context &gcontext) {
+      //one buffer per execution thread, --execthreads may exceed the number of cores
+      cache->thread_entries.resize(gcontext.execthreads);
+    }
+    void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+      if (user_nodes && vertex.id() >= M)
+        return;
+      else if (!user_nodes && vertex.id() < M)
+        return;
+      std::vector<entry> & out = cache->thread_entries[omp_get_thread_num()];
+      for(int e=0; e < vertex.num_outedges(); e++)
+        out.push_back(entry(vertex.id(), vertex.edge(e)->vertex_id(), vertex.edge(e)->get_data()));
+    }
+  };
+
+  public:
+  validation_cache() : tried(false), ready(false) { }
+
+  inline bool loaded(){ return ready; }
+  inline size_t groups(){ return starts.size() - 1; }
+
+  /**
+   * Load the validation edges at the first call, if they fit in the budget. Returns true if
+   * the cache can be used.
+   */
+  template<typename Engine>
+  bool load(Engine & engine, bool user_nodes){
+    if (tried)
+      return ready;
+    tried = true;
+    double budget = get_option_int("validation_cache_mb", 1024) * 1024.0 * 1024.0;
+    if ((double)Le * sizeof(entry) > budget){
+      logstream(LOG_INFO)<<"Validation set of " << Le << " ratings does not fit in --validation_cache_mb, using disk based validation" << std::endl;
+      return false;
+    }
+
+    CollectProgram program;
+    program.cache = this;
+    program.user_nodes = user_nodes;
+    engine.run(program, 1);
+
+    size_t total = 0;
+    for (uint t=0; t< thread_entries.size(); t++)
+      total += thread_entries[t].size();
+    entries.reserve(total);
+    for (uint t=0; t< thread_entries.size(); t++){
+      entries.insert(entries.end(), thread_entries[t].begin(), thread_entries[t].end());
+      std::vector<entry>().swap(thread_entries[t]);
+    }
+    std::sort(entries.begin(), entries.end());
+    for (size_t i=0; i< entries.size(); i++)
+      if (i == 0 || entries[i].node != entries[i-1].node)
+        starts.push_back(i);
+    starts.push_back(entries.size());
+    logstream(LOG_INFO)<<"Cached " << entries.size() << " validation ratings in memory" << std::endl;
+    ready = true;
+    return true;
+  }
+};
+
+#endif //_VALIDATION_CACHE_HPP__
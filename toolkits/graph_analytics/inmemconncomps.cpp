@@ -33,6 +33,12 @@
  *
  * Version of connected components that keeps the vertex values
  * in memory.
+ *
+ * By default (algorithm=unionfind) uses a lock-free concurrent union-find,
+ * which needs only one pass over the in-edges of each shard, with all
+ * execution threads. Label propagation (algorithm=labelprop) needs up to
+ * diameter-many passes, and is used only if asked for or if the union-find
+ * parent array does not fit in memory (option unionfind_maxmem_mb).
  * @author Aapo Kyrola
  * 
  * Danny B: added output of each vertex label
@@ -44,6 +50,7 @@
 
 #include "graphchi_basic_includes.hpp"
 #include "label_analysis.hpp"
+#include "util/concurrent_union_find.hpp"
 #include "../collaborative_filtering/eigen_wrapper.hpp"
 #include "../collaborative_filtering/timer.hpp"
 using namespace graphchi;
@@ -60,6 +67,7 @@ vid_t * vertex_values;
 vid_t * edge_count;
 vid_t * out_degree;
 mutex mymutex;
+concurrent_union_find * uf = NULL;
 
 size_t changes = 0;
 timer mytimer;
@@ -128,6 +136,29 @@ struct ConnectedComponentsProgram : public GraphChiProgram<VertexDataType, EdgeD
 
 };
 
+/**
+ * Unites each vertex with its in-neighbors. Every edge is the in-edge of
+ * exactly one vertex, so one pass with out-edges disabled covers the graph.
+ */
+struct UnionFindProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
+
+  void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
+    for(int i=0; i < vertex.num_inedges(); i++) {
+      uf->unite(vertex.id(), vertex.inedge(i)->vertex_id());
+    }
+  }
+
+  void before_iteration(int iteration, graphchi_context &ctx) {
+    uf = new concurrent_union_find(ctx.nvertices);
+  }
+
+  void after_iteration(int iteration, graphchi_context &ctx) {
+    uf->compress();
+    logstream(LOG_DEBUG)<<mytimer.current_time() << " union-find components: " << uf->num_components() << std::endl;
+    ctx.set_last_iteration(iteration);
+  }
+};
+
 /**
  * GraphChi programs need to subclass GraphChiProgram<vertex-type, edge-type>
  * class. The main logic is usually in the update function.
@@ -176,6 +207,7 @@ int main(int argc, const char ** argv) {
   std::string filename = get_option_string("file");  // Base filename
   int niters           = get_option_int("niters", 100); // Number of iterations (max)
   int output_labels    = get_option_int("output_labels", 0); //output node labels to file?
+  std::string algorithm = get_option_string("algorithm", "unionfind"); // unionfind or labelprop
   bool scheduler       = false;    // Always run with scheduler
 
   /* Process input file - if not already preprocessed */
@@ -184,7 +216,6 @@ int main(int argc, const char ** argv) {
   mytimer.start();
 
   /* Run */
-  ConnectedComponentsProgram program;
   graphchi_engine<VertexDataType, EdgeDataType> engine(filename, nshards, scheduler, m);
   engine.set_disable_vertexdata_storage();  
   engine.set_enable_deterministic_parallelism(false);
@@ -192,7 +223,24 @@ int main(int argc, const char ** argv) {
   engine.set_modifies_outedges(false);
   engine.set_maxwindow(engine.num_vertices());
 
-  engine.run(program, niters);
+  size_t maxmem = (size_t) get_option_long("unionfind_maxmem_mb", 0) * 1024 * 1024;
+  if (algorithm == "unionfind" && !concurrent_union_find::fits_in_memory(engine.num_vertices(), maxmem)) {
+    logstream(LOG_WARNING) << "Union-find parent array does not fit in memory, using label propagation." << std::endl;
+    algorithm = "labelprop";
+  }
+
+  if (algorithm == "unionfind") {
+    UnionFindProgram program;
+    engine.set_disable_outedges(true);
+    engine.set_only_adjacency(true);
+    engine.run(program, 1);
+    engine.set_disable_outedges(false);
+    engine.set_only_adjacency(false);
+    vertex_values = uf->labels();
+  } else {
+    ConnectedComponentsProgram program;
+    engine.run(program, niters);
+  }
 
   mytimer.start();
 
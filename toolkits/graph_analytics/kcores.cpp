@@ -22,9 +22,20 @@
 
 
 
+/**
+ * K-core decomposition by degree buckets. The current degrees of the vertices are
+ * kept in memory; each pass peels all vertices whose degree is at most the current
+ * core level k and decrements the degrees of their neighbors. When no vertex is left
+ * in the bucket, k jumps directly to the smallest remaining degree, so empty levels
+ * cost no passes. Once the edges of the residual graph fit in inmem_maxmem_mb, they
+ * are read into memory in one pass and the rest is peeled in memory with a bin-sort
+ * bucket queue (Batagelj & Zaversnik).
+ */
+
 #include <cmath>
 #include <cstdio>
 #include <limits>
+#include <vector>
 #include <iostream>
 #include "graphchi_basic_includes.hpp"
 #include "api/chifilenames.hpp"
@@ -36,26 +47,24 @@
 
 using namespace graphchi;
 
-int square = 0;
+int square_matrix = 0;
 
 bool debug = false;
-int max_iter = 50;
-ivec active_nodes_num;
-ivec active_links_num;
-int iiter = 0; //current iteration
+std::vector<int> removed_nodes_num;  // Vertices peeled at each core level
+std::vector<int> removed_links_num;  // Links removed at each core level
 uint nodes = 0;
 uint orig_edges = 0;
-uint num_active = 0;
-uint links = 0;
+size_t num_active = 0;    // Vertices not yet peeled
+size_t active_links = 0;  // Links between them
 mutex mymutex;
 timer mytimer;
 
 
 struct vertex_data {
   bool active;
+  bool peel;    // peeled on the current pass
   int kcore, degree;
-  vec pvec; //to remove
-  vertex_data() : active(true), kcore(-1), degree(0)  {}
+  vertex_data() : active(true), peel(false), kcore(-1), degree(0)  {}
   void set_val(int index, double val){}
   float get_val(int index){ return 0;}
 }; // end of vertex_data
@@ -78,66 +87,202 @@ std::vector<vertex_data> latent_factors_inmem;
 
 #include "../collaborative_filtering/io.hpp"
 
+enum kcores_phase { PEEL, LOAD_RESIDUAL, FINISHED };
+
 struct KcoresProgram : public GraphChiProgram<VertexDataType, EdgeDataType> {
 
+  int level;              // current core level k
+  kcores_phase phase;
+  size_t inmem_maxbytes;
+  std::vector<std::vector<vid_t> > residual;   // adjacency of the residual graph (in-memory finish)
+  int passes;
+
+  KcoresProgram(size_t inmem_maxbytes) : level(1), phase(PEEL), inmem_maxbytes(inmem_maxbytes), passes(0) {}
+
+  void record(int k, int nodes, size_t links){
+    if ((int)removed_nodes_num.size() <= k){
+      removed_nodes_num.resize(k+1, 0);
+      removed_links_num.resize(k+1, 0);
+    }
+    removed_nodes_num[k] += nodes;
+    removed_links_num[k] += (int)links;
+  }
+
   /**
    *  Vertex update function.
    */
   void update(graphchi_vertex<VertexDataType, EdgeDataType> &vertex, graphchi_context &gcontext) {
- 
-   vertex_data & vdata = latent_factors_inmem[vertex.id()];
-    if (debug && iiter > 99 && vertex.id() % 1000 == 0)
-      std::cout<<"Entering node: " << vertex.id() << std::endl;
-
+    vid_t id = vertex.id();
+    vertex_data & vdata = latent_factors_inmem[id];
+
+    if (gcontext.iteration == 0){
+      /* Every edge counts, in both directions (as in the original pass-per-level version) */
+      vdata.degree = vertex.num_edges();
+      size_t links = 0;
+      for(int e=0; e < vertex.num_outedges(); e++)
+        links += (vertex.outedge(e)->vertex_id() != id);
+      __sync_add_and_fetch(&active_links, links);
+      return;
+    }
     if (!vdata.active)
       return;
 
-    int cur_iter = iiter;
-    int cur_links = 0;
-    int increasing_links = 0;
-    
+    if (phase == LOAD_RESIDUAL){
+      std::vector<vid_t> & adj = residual[id];  // only this update writes it
+      for(int e=0; e < vertex.num_edges(); e++){
+        vid_t other = vertex.edge(e)->vertex_id();
+        if (latent_factors_inmem[other].active)
+          adj.push_back(other);
+      }
+      return;
+    }
+
+    if (!vdata.peel)
+      return;
+    if (debug && id % 1000 == 0)
+      std::cout<<"Peeling node: " << id << " at level " << level << std::endl;
+
+    /* Remove the links to vertices that stay (or are peeled on this pass and have larger id) */
+    size_t links = 0;
     for(int e=0; e < vertex.num_edges(); e++) {
-      const vertex_data & other = latent_factors_inmem[vertex.edge(e)->vertex_id()];
-        if (other.active){
-          if (debug && iiter > 99)
-             std::cout<<"neighbor: "<<vertex.edge(e)->vertex_id()<<" active"<<std::endl;
-      	  cur_links++;
-          if (vertex.edge(e)->vertex_id() > vertex.id())
-          increasing_links++;
-        }
+      vid_t other = vertex.edge(e)->vertex_id();
+      vertex_data & odata = latent_factors_inmem[other];
+      if (!odata.active || other == id)
+        continue;
+      if (!odata.peel){
+        __sync_sub_and_fetch(&odata.degree, 1);
+        links++;
+      }
+      else if (other > id)
+        links++;
     }
+    vdata.kcore = level;
+    __sync_sub_and_fetch(&active_links, links);
+    mymutex.lock();
+    record(level, 1, links);
+    mymutex.unlock();
+  }
 
-    if (cur_links <= cur_iter){
-        vdata.active = false;
-        vdata.kcore = cur_iter;
+  /* In-memory bucket queue peeling of the residual graph; core levels start from the current level */
+  void peel_residual(){
+    int n = (int)latent_factors_inmem.size();
+    int maxdeg = 0;
+    for (int i=0; i< n; i++)
+      if (latent_factors_inmem[i].active)
+        maxdeg = std::max(maxdeg, (int)residual[i].size());
+
+    std::vector<int> deg(n, 0), bin(maxdeg+2, 0), pos(n, 0), vert;
+    for (int i=0; i< n; i++){
+      if (!latent_factors_inmem[i].active)
+        continue;
+      deg[i] = (int)residual[i].size();
+      bin[deg[i]]++;
     }
-    else {
-      if (debug && iiter > 99)
-        std::cout<<vertex.id()<<": cur links: " << cur_links << std::endl;
-      mymutex.lock();
-      links += increasing_links;
-      mymutex.unlock();
+    int start = 0;
+    for (int d=0; d <= maxdeg; d++){
+      int num = bin[d];
+      bin[d] = start;
+      start += num;
     }
-
-    if (vdata.active){
-      mymutex.lock();
-      num_active++;
-      mymutex.unlock();
+    vert.resize(start);
+    for (int i=0; i< n; i++){
+      if (!latent_factors_inmem[i].active)
+        continue;
+      pos[i] = bin[deg[i]];
+      vert[pos[i]] = i;
+      bin[deg[i]]++;
     }
+    for (int d=maxdeg; d > 0; d--)
+      bin[d] = bin[d-1];
+    bin[0] = 0;
+
+    for (int i=0; i < (int)vert.size(); i++){
+      int v = vert[i];
+      level = std::max(level, deg[v]);
+      size_t links = 0;
+      for (uint j=0; j < residual[v].size(); j++){
+        int u = residual[v][j];
+        if (!latent_factors_inmem[u].active || u == v)
+          continue;
+        links++;
+        if (deg[u] > deg[v]){
+          /* Move u one bucket down: swap with the first vertex of its bucket */
+          int du = deg[u], pu = pos[u], pw = bin[du], w = vert[pw];
+          if (u != w){
+            pos[u] = pw; vert[pu] = w;
+            pos[w] = pu; vert[pw] = u;
+          }
+          bin[du]++;
+          deg[u]--;
+        }
+      }
+      latent_factors_inmem[v].active = false;
+      latent_factors_inmem[v].kcore = level;
+      active_links -= links;
+      record(level, 1, links);
+    }
+    num_active = 0;
+    std::vector<std::vector<vid_t> >().swap(residual);
   }
 
   void after_iteration(int iteration, graphchi_context &gcontext) {
-   active_nodes_num[iiter] = num_active;
-   if (num_active == 0)
-	links = 0;
-   printf("Number of active nodes in round %d is %di, links: %d\n", iiter, num_active, links);
-   active_links_num[iiter] = links;
-
+    for (uint i=0; i< latent_factors_inmem.size(); i++){
+      vertex_data & vdata = latent_factors_inmem[i];
+      if (vdata.peel){
+        vdata.peel = false;
+        vdata.active = false;
+        num_active--;
+      }
+    }
+    if (phase == LOAD_RESIDUAL){
+      peel_residual();
+      phase = FINISHED;
+    }
+    printf("Pass %d: core level %d, active nodes: %ld, links: %ld\n", passes, level, (long)num_active, (long)active_links);
+    passes++;
   }
   
+  /**
+   * Schedules the vertices of the lowest non-empty bucket (degree at most the current
+   * level, which jumps to the smallest remaining degree when the bucket is empty).
+   */
   void before_iteration(int iteration, graphchi_context &gcontext) {
-    num_active = 0;
-    links = 0;
+    int n = (int)latent_factors_inmem.size();
+    if (iteration == 0){
+      num_active = n;
+      active_links = 0;
+      level = 1;
+      phase = PEEL;
+      return; // all vertices are run on the first iteration
+    }
+    if (phase == FINISHED || num_active == 0)
+      return; // no tasks, engine will stop
+
+    if (active_links * 2 * sizeof(vid_t) + num_active * sizeof(std::vector<vid_t>) <= inmem_maxbytes){
+      logstream(LOG_INFO)<<"Residual graph fits in memory: " << num_active << " nodes, " << active_links << " links" << std::endl;
+      phase = LOAD_RESIDUAL;
+      residual.assign(n, std::vector<vid_t>());
+      for (int i=0; i< n; i++)
+        if (latent_factors_inmem[i].active)
+          gcontext.scheduler->add_task(i);
+      return;
+    }
+
+    int mindeg = std::numeric_limits<int>::max();
+    for (int i=0; i< n; i++)
+      if (latent_factors_inmem[i].active)
+        mindeg = std::min(mindeg, latent_factors_inmem[i].degree);
+    if (mindeg > level){
+      level = mindeg;
+      logstream(LOG_INFO)<<mytimer.current_time() << ") Going to run k-cores level " << level << std::endl;
+    }
+    for (int i=0; i< n; i++){
+      vertex_data & vdata = latent_factors_inmem[i];
+      if (vdata.active && vdata.degree <= level){
+        vdata.peel = true;
+        gcontext.scheduler->add_task(i);
+      }
+    }
   }
 }; // end of  aggregator
 
@@ -165,7 +310,7 @@ int main(int argc,  const char *argv[]) {
   std::string datafile;
   int unittest = 0;
 
-  int max_iter    = get_option_int("max_iter", 15000);  // Number of iterations
+  int max_iter    = get_option_int("max_iter", 100000);  // Upper bound for the number of passes
   maxval        = get_option_float("maxval", 1e100);
   minval        = get_option_float("minval", -1e100);
   bool quiet    = get_option_int("quiet", 0);
@@ -174,14 +319,10 @@ int main(int argc,  const char *argv[]) {
   debug         = get_option_int("debug", 0);
   unittest      = get_option_int("unittest", 0); 
   datafile      = get_option_string("training");
-  square        = get_option_int("square", 0);
+  square_matrix = get_option_int("square", 0);
   nodes = get_option_int("nodes", nodes);
   orig_edges = get_option_int("orig_edges", orig_edges);
-
-  active_nodes_num = ivec(max_iter+1);
-  active_links_num = ivec(max_iter+1);
-
-
+  double inmem_maxmem_mb = get_option_float("inmem_maxmem_mb", 512); // in-memory finish (0 = off)
 
   //unit testing
   if (unittest == 1){
@@ -193,55 +334,37 @@ int main(int argc,  const char *argv[]) {
 
   int nshards = 0;
   if (tokens_per_row == 4 )
-    convert_matrixmarket4<edge_data>(datafile, false, square);
+    convert_matrixmarket4<edge_data>(datafile, false, square_matrix);
   else if (tokens_per_row == 3 || tokens_per_row == 2) 
-    convert_matrixmarket<edge_data>(datafile, NULL, nodes, orig_edges, tokens_per_row);
+    convert_matrixmarket<edge_data>(datafile, nodes, orig_edges, tokens_per_row);
   else logstream(LOG_FATAL)<<"Please use --tokens_per_row=3 or --tokens_per_row=4" << std::endl;
 
-  latent_factors_inmem.resize(square? std::max(M,N) : M+N);
+  latent_factors_inmem.resize(square_matrix? std::max(M,N) : M+N);
 
-  KcoresProgram program;
-  graphchi_engine<VertexDataType, EdgeDataType> engine(datafile, nshards, false, m); 
- set_engine_flags(engine);
+  KcoresProgram program((size_t)(inmem_maxmem_mb * 1024 * 1024));
+  graphchi_engine<VertexDataType, EdgeDataType> engine(datafile, nshards, true, m); 
+  set_engine_flags(engine);
   engine.set_maxwindow(nodes+1);
-  int pass = 0;
-  for (iiter=1; iiter< max_iter+1; iiter++){
-    logstream(LOG_INFO)<<mytimer.current_time() << ") Going to run k-cores iteration " << iiter << std::endl;
-    while(true){
-      int prev_nodes = active_nodes_num[iiter];
-     /* Run */
-           engine.run(program, 1);
-      pass++;
-      int cur_nodes = active_nodes_num[iiter];
-      if (prev_nodes == cur_nodes)
-        break; 
-    }
-    if (active_nodes_num[iiter] == 0){
-      max_iter = iiter;
-      break;
-    }
-  }
+  engine.run(program, max_iter);
  
+  int max_core = (int)removed_nodes_num.size() - 1;
   std::cout << "KCORES finished in " << mytimer.current_time() << std::endl;
-  std::cout << "Number of updates: " << pass*(M+N) << " pass: " << pass << std::endl;
-  imat retmat = imat(max_iter+1, 4);
+  std::cout << "Number of passes: " << program.passes << ", max core: " << max_core << std::endl;
+  imat retmat = imat(max_core+1, 4);
   memset((int*)data(retmat),0,sizeof(int)*retmat.size());
 
-
-  active_nodes_num[0] = (square? std::max(M,N) : M+N);
-  active_links_num[0] = L;
   assert(L>0);
 
   std::cout<<"     Core Removed Total    Removed"<<std::endl;
   std::cout<<"     Num  Nodes   Removed  Links" <<std::endl;
-  for (int i=0; i <= max_iter; i++){
+  int total_nodes = 0, total_links = 0;
+  for (int i=0; i <= max_core; i++){
+    total_nodes += removed_nodes_num[i];
+    total_links += removed_links_num[i];
     set_val(retmat, i, 0, i);
-    if (i >= 1){
-      set_val(retmat, i, 1, active_nodes_num[i-1]-active_nodes_num[i]);
-      set_val(retmat, i, 2, active_nodes_num[0]-active_nodes_num[i]);
-      assert(active_nodes_num[i] >= 0);
-      set_val(retmat, i, 3, L - active_links_num[i]);
-    }
+    set_val(retmat, i, 1, removed_nodes_num[i]);
+    set_val(retmat, i, 2, total_nodes);
+    set_val(retmat, i, 3, total_links);
   } 
   //write_output_matrix(datafile + ".kcores.out", format, retmat);
   std::cout<<retmat<<std::endl;
@@ -256,5 +379,3 @@ int main(int argc,  const char *argv[]) {
 
    return EXIT_SUCCESS;
 }
-
-